@@ -11,14 +11,29 @@ static char module_docstring[] =
 "This module provides a fast C implementation of Dijkstra's path-finding algorithm.";
 static char dijkstra_docstring[] =
 "This function accepts a list of connections with ends specified as integer identifications with a float cost. "
-"It assembles them into a network and finds the path of minimum cost from the specified start to the specified end.";
+"It assembles them into a network and finds the path of minimum cost from the specified start to the specified end. "
+"If a list of (lat, lon) tuples indexed by node id is also given, and costs are at least the distance in kilometres, "
+"the search is directed towards the end with the A* algorithm.";
+
+static char distance_table_docstring[] =
+"This function accepts a list of connections as for Dijkstra, a list of source ids, a list of target ids, and a bool "
+"for two-way connections. It returns a list with a row for each source, holding the cost from it to each target, "
+"or infinity where there is no path. The rows are worked out on all processors at once.";
+static char shortest_path_tree_docstring[] =
+"This function accepts a list of connections as for Dijkstra, a source id, a bool for two-way connections, and "
+"optionally a cost cutoff. It returns a list of the cost from the source to each node and a list of the node before "
+"each on its path, with infinity and -1 for nodes that cannot be reached within the cutoff.";
 
 // Method declarations
 static PyObject * dijkstra_Dijkstra(PyObject * self, PyObject * args);
+static PyObject * dijkstra_DistanceTable(PyObject * self, PyObject * args);
+static PyObject * dijkstra_ShortestPathTree(PyObject * self, PyObject * args);
 
 // Method table
 static PyMethodDef module_methods[] = {
 	{"Dijkstra", dijkstra_Dijkstra, METH_VARARGS, dijkstra_docstring},
+	{"DistanceTable", dijkstra_DistanceTable, METH_VARARGS, distance_table_docstring},
+	{"ShortestPathTree", dijkstra_ShortestPathTree, METH_VARARGS, shortest_path_tree_docstring},
 	{NULL, NULL, 0, NULL}
 };
 
@@ -28,35 +43,23 @@ PyMODINIT_FUNC init_dijkstra(void) {
 	if (m == NULL) return;
 }
 
-// Method definitions
-static PyObject * dijkstra_Dijkstra(PyObject * self, PyObject * args) {
-	
-	// Parse arguments
-	PyObject * arg_list = NULL;
-	unsigned int start;
-	unsigned int end;
-	PyObject * arg_twoway;
-
-	if (!PyArg_ParseTuple(args, "OIIO!", &arg_list, &start, &end, &PyBool_Type, &arg_twoway)) {
-		PyErr_SetString(PyExc_TypeError, "Parameters must be a list of (int, int, float) tuples, two ints, and a bool");
-		return NULL;
-	}
-
+// Builds an array of connections from a list of (int, int, float) tuples,
+// doubling them if twoway is true. Returns NULL with the Python error set if
+// the list is malformed.
+static Connection * dijkstra_ParseConnections(PyObject * arg_list, PyObject * arg_twoway, Py_ssize_t * out_len) {
 	PyObject * sequence = PySequence_Fast(arg_list, "Expected a sequence");
+	if (!sequence) return NULL;
 	Py_ssize_t len = PySequence_Size(sequence);
 
 	// Build array from list
 	Connection * cons = (Connection *)malloc(len * sizeof(Connection));
 	for (int i = 0; i < len; i++) {
-		PyObject * list_item = PySequence_Fast_GET_ITEM(arg_list, i);
+		PyObject * list_item = PySequence_Fast_GET_ITEM(sequence, i);
 		// Check for tuple type
-		if (!PyTuple_Check(list_item)) {
-			PyErr_SetString(PyExc_TypeError, "Connection must be an int-int-float tuple");
-			return NULL;
-		}
-		// Extract data from tuple
 		Connection * con = cons + i;
-		if (!PyArg_ParseTuple(list_item, "IIf", &con->start, &con->end, &con->cost)) {
+		if (!PyTuple_Check(list_item) || !PyArg_ParseTuple(list_item, "IIf", &con->start, &con->end, &con->cost)) {
+			Py_DECREF(sequence);
+			free(cons);
 			PyErr_SetString(PyExc_TypeError, "Connection must be an int-int-float tuple");
 			return NULL;
 		}
@@ -64,16 +67,103 @@ static PyObject * dijkstra_Dijkstra(PyObject * self, PyObject * args) {
 	Py_DECREF(sequence);
 
 	// Add two-way connections
-	int twoway = PyObject_IsTrue(arg_twoway);
-	if (twoway) {
+	if (PyObject_IsTrue(arg_twoway)) {
 		Connection * temp = Connection_TwoWay(cons, len);
 		free(cons);
 		cons = temp;
 		len = len * 2;
 	}
+	*out_len = len;
+	return cons;
+}
+
+// Builds an array of node ids from a list of ints. Returns NULL with the
+// Python error set if the list is malformed.
+static unsigned int * dijkstra_ParseIds(PyObject * arg_list, Py_ssize_t * out_len) {
+	PyObject * sequence = PySequence_Fast(arg_list, "Expected a sequence");
+	if (!sequence) return NULL;
+	Py_ssize_t len = PySequence_Size(sequence);
+	unsigned int * ids = (unsigned int *)malloc((len ? len : 1) * sizeof(unsigned int));
+	for (Py_ssize_t i = 0; i < len; i++) {
+		long id = PyInt_AsLong(PySequence_Fast_GET_ITEM(sequence, i));
+		if (id < 0 || PyErr_Occurred()) {
+			Py_DECREF(sequence);
+			free(ids);
+			PyErr_SetString(PyExc_TypeError, "Node ids must be non-negative ints");
+			return NULL;
+		}
+		ids[i] = (unsigned int)id;
+	}
+	Py_DECREF(sequence);
+	*out_len = len;
+	return ids;
+}
+
+// Method definitions
+static PyObject * dijkstra_Dijkstra(PyObject * self, PyObject * args) {
+	
+	// Parse arguments
+	PyObject * arg_list = NULL;
+	unsigned int start;
+	unsigned int end;
+	PyObject * arg_twoway;
+	PyObject * arg_coordinates = NULL;
+
+	if (!PyArg_ParseTuple(args, "OIIO!|O", &arg_list, &start, &end, &PyBool_Type, &arg_twoway, &arg_coordinates)) {
+		PyErr_SetString(PyExc_TypeError, "Parameters must be a list of (int, int, float) tuples, two ints, a bool, and optionally a list of (float, float) tuples");
+		return NULL;
+	}
+
+	Py_ssize_t len;
+	Connection * cons = dijkstra_ParseConnections(arg_list, arg_twoway, &len);
+	if (!cons) return NULL;
 
 	// Run the Dijktra algorithm
-	DijkstraOutput results = Dijkstra_ShortestPath(cons, len, start, end);
+	DijkstraOutput results;
+	if (arg_coordinates && arg_coordinates != Py_None) {
+		// Run A* from the coordinates of the nodes, parsed before the graph
+		// is built so that a bad sequence has nothing to free but cons
+		PyObject * coordinates = PySequence_Fast(arg_coordinates, "Expected a sequence");
+		if (!coordinates) {
+			free(cons);
+			return NULL;
+		}
+		Py_ssize_t n_coordinates = PySequence_Size(coordinates);
+		double * lats = (double *)malloc((n_coordinates ? n_coordinates : 1) * sizeof(double));
+		double * lons = (double *)malloc((n_coordinates ? n_coordinates : 1) * sizeof(double));
+		for (Py_ssize_t i = 0; i < n_coordinates; i++) {
+			if (!PyArg_ParseTuple(PySequence_Fast_GET_ITEM(coordinates, i), "dd", lats + i, lons + i)) {
+				Py_DECREF(coordinates);
+				free(cons);
+				free(lats);
+				free(lons);
+				PyErr_SetString(PyExc_TypeError, "Coordinate must be a float-float tuple");
+				return NULL;
+			}
+		}
+		Py_DECREF(coordinates);
+
+		Graph graph = Graph_BuildParallel(cons, len, 1, 0);
+		free(cons);
+		if (!graph.error && n_coordinates != graph.n_nodes) {
+			Graph_Free(&graph);
+			free(lats);
+			free(lons);
+			PyErr_SetString(PyExc_ValueError, "There must be a coordinate for every node");
+			return NULL;
+		}
+		Graph_SetCoordinates(&graph, lats, lons, 1.0f);
+		DijkstraOptions options = DijkstraOptions_Init();
+		options.astar = 1;
+		results = Dijkstra_QueryWithOptions(&graph, start, end, &options);
+		Graph_Free(&graph);
+		free(lats);
+		free(lons);
+	}
+	else {
+		results = Dijkstra_ShortestPath(cons, len, start, end);
+		free(cons);
+	}
 
 	// Check for Dijkstra errors
 	switch (results.error) {
@@ -112,4 +202,132 @@ static PyObject * dijkstra_Dijkstra(PyObject * self, PyObject * args) {
 	}
 	PyObject * py_output = Py_BuildValue("(Of)", output_list, results.total_cost);
 	return py_output;
-}
\ No newline at end of file
+}
+
+static PyObject * dijkstra_DistanceTable(PyObject * self, PyObject * args) {
+
+	// Parse arguments
+	PyObject * arg_list = NULL;
+	PyObject * arg_sources = NULL;
+	PyObject * arg_targets = NULL;
+	PyObject * arg_twoway;
+
+	if (!PyArg_ParseTuple(args, "OOOO!", &arg_list, &arg_sources, &arg_targets, &PyBool_Type, &arg_twoway)) {
+		PyErr_SetString(PyExc_TypeError, "Parameters must be a list of (int, int, float) tuples, two lists of ints, and a bool");
+		return NULL;
+	}
+
+	Py_ssize_t len, n_sources, n_targets;
+	Connection * cons = dijkstra_ParseConnections(arg_list, arg_twoway, &len);
+	if (!cons) return NULL;
+	unsigned int * sources = dijkstra_ParseIds(arg_sources, &n_sources);
+	unsigned int * targets = sources ? dijkstra_ParseIds(arg_targets, &n_targets) : NULL;
+	if (!targets) {
+		free(cons);
+		free(sources);
+		return NULL;
+	}
+
+	// Work out the table on every processor
+	Graph graph = Graph_BuildParallel(cons, len, 0, 0);
+	float * table = (float *)malloc((n_sources && n_targets ? n_sources * n_targets : 1) * sizeof(float));
+	int error = Dijkstra_DistanceTable(&graph, sources, n_sources, targets, n_targets, table);
+	Graph_Free(&graph);
+	free(cons);
+	free(sources);
+	free(targets);
+
+	switch (error) {
+	case DIJKSTRA_SUCCESS:
+		break;
+	case DIJKSTRA_ERROR_NO_CONNECTIONS:
+		free(table);
+		PyErr_SetString(PyExc_ValueError, "No connections given");
+		return NULL;
+	case DIJKSTRA_ERROR_NEGATIVE_COSTS:
+		free(table);
+		PyErr_SetString(PyExc_ValueError, "There cannot be negative costs");
+		return NULL;
+	case DIJKSTRA_ERROR_MISSING_NODE_IDS:
+		free(table);
+		PyErr_SetString(PyExc_ValueError, "Node id numbers must be consecutive");
+		return NULL;
+	case DIJKSTRA_ERROR_INVALID_START:
+		free(table);
+		PyErr_SetString(PyExc_ValueError, "A source node is not included in the data");
+		return NULL;
+	case DIJKSTRA_ERROR_INVALID_END:
+		free(table);
+		PyErr_SetString(PyExc_ValueError, "A target node is not included in the data");
+		return NULL;
+	}
+
+	// Assemble output
+	PyObject * output_list = PyList_New(n_sources);
+	for (Py_ssize_t i = 0; i < n_sources; i++) {
+		PyObject * row = PyList_New(n_targets);
+		for (Py_ssize_t j = 0; j < n_targets; j++) PyList_SetItem(row, j, PyFloat_FromDouble(table[i * n_targets + j]));
+		PyList_SetItem(output_list, i, row);
+	}
+	free(table);
+	return output_list;
+}
+
+static PyObject * dijkstra_ShortestPathTree(PyObject * self, PyObject * args) {
+
+	// Parse arguments
+	PyObject * arg_list = NULL;
+	unsigned int source;
+	PyObject * arg_twoway;
+	float cutoff = INFINITY;
+
+	if (!PyArg_ParseTuple(args, "OIO!|f", &arg_list, &source, &PyBool_Type, &arg_twoway, &cutoff)) {
+		PyErr_SetString(PyExc_TypeError, "Parameters must be a list of (int, int, float) tuples, an int, a bool, and optionally a float");
+		return NULL;
+	}
+
+	Py_ssize_t len;
+	Connection * cons = dijkstra_ParseConnections(arg_list, arg_twoway, &len);
+	if (!cons) return NULL;
+
+	Graph graph = Graph_BuildParallel(cons, len, 1, 0);
+	free(cons);
+	float * dist = (float *)malloc((graph.n_nodes ? graph.n_nodes : 1) * sizeof(float));
+	unsigned int * parent = (unsigned int *)malloc((graph.n_nodes ? graph.n_nodes : 1) * sizeof(unsigned int));
+	int error = Dijkstra_ShortestPathTree(&graph, source, cutoff, dist, parent);
+	unsigned int n_nodes = graph.n_nodes;
+	Graph_Free(&graph);
+
+	switch (error) {
+	case DIJKSTRA_SUCCESS:
+		break;
+	case DIJKSTRA_ERROR_NO_CONNECTIONS:
+		PyErr_SetString(PyExc_ValueError, "No connections given");
+		break;
+	case DIJKSTRA_ERROR_NEGATIVE_COSTS:
+		PyErr_SetString(PyExc_ValueError, "There cannot be negative costs");
+		break;
+	case DIJKSTRA_ERROR_MISSING_NODE_IDS:
+		PyErr_SetString(PyExc_ValueError, "Node id numbers must be consecutive");
+		break;
+	case DIJKSTRA_ERROR_INVALID_START:
+		PyErr_SetString(PyExc_ValueError, "Source node is not included in the data");
+		break;
+	}
+	if (error != DIJKSTRA_SUCCESS) {
+		free(dist);
+		free(parent);
+		return NULL;
+	}
+
+	// Assemble output
+	PyObject * dist_list = PyList_New(n_nodes);
+	PyObject * parent_list = PyList_New(n_nodes);
+	for (unsigned int i = 0; i < n_nodes; i++) {
+		PyList_SetItem(dist_list, i, PyFloat_FromDouble(dist[i]));
+		PyList_SetItem(parent_list, i, PyInt_FromLong(parent[i] == DIJKSTRA_NO_PARENT ? -1 : (long)parent[i]));
+	}
+	free(dist);
+	free(parent);
+	return Py_BuildValue("(NN)", dist_list, parent_list);
+}
@@ -0,0 +1,121 @@
+/******************************************************************************
+ * Implementation of the Bucket Queue.
+ */
+
+#include <memory.h>
+#include <stdlib.h>
+
+#include "bucketqueue.h"
+
+static inline void BucketQueue_Link(BucketQueue * const queue, const unsigned int id, const unsigned long long priority) {
+	unsigned int * head = queue->heads + priority % queue->n_buckets;
+	queue->priorities[id] = priority;
+	queue->prev[id] = BUCKET_NONE;
+	queue->next[id] = *head;
+	if (*head != BUCKET_NONE) queue->prev[*head] = id;
+	*head = id;
+}
+
+static inline void BucketQueue_Unlink(BucketQueue * const queue, const unsigned int id) {
+	unsigned int next = queue->next[id];
+	unsigned int prev = queue->prev[id];
+	if (prev != BUCKET_NONE) queue->next[prev] = next;
+	else queue->heads[queue->priorities[id] % queue->n_buckets] = next;
+	if (next != BUCKET_NONE) queue->prev[next] = prev;
+	queue->priorities[id] = BUCKET_NO_PRIORITY;
+}
+
+/******************************************************************************
+ * Initialization
+ */
+BucketQueue BucketQueue_New(const unsigned int n_keys, const unsigned int max_step) {
+	BucketQueue queue;
+	memset(&queue, 0, sizeof(BucketQueue));
+	queue.n_keys = n_keys;
+	queue.n_buckets = max_step + 1;
+	queue.heads = (unsigned int *)malloc(queue.n_buckets * sizeof(unsigned int));
+	queue.next = (unsigned int *)malloc(n_keys * sizeof(unsigned int));
+	queue.prev = (unsigned int *)malloc(n_keys * sizeof(unsigned int));
+	queue.priorities = (unsigned long long *)malloc(n_keys * sizeof(unsigned long long));
+	memset(queue.heads, 0xff, queue.n_buckets * sizeof(unsigned int));
+	memset(queue.priorities, 0xff, n_keys * sizeof(unsigned long long));
+	return queue;
+}
+
+/******************************************************************************
+ * Memory Free
+ */
+void BucketQueue_Free(BucketQueue * const queue) {
+	free(queue->heads);
+	free(queue->next);
+	free(queue->prev);
+	free(queue->priorities);
+	memset(queue, 0, sizeof(BucketQueue));
+}
+
+// Only the ids still linked need resetting. They lie in the buckets from last
+// onward, so the walk stops once it has found all n_data of them.
+void BucketQueue_Clear(BucketQueue * const queue) {
+	unsigned int bucket = (unsigned int)(queue->last % queue->n_buckets);
+	while (queue->n_data > 0) {
+		unsigned int id = queue->heads[bucket];
+		while (id != BUCKET_NONE) {
+			queue->priorities[id] = BUCKET_NO_PRIORITY;
+			id = queue->next[id];
+			queue->n_data--;
+		}
+		queue->heads[bucket] = BUCKET_NONE;
+		if (++bucket == queue->n_buckets) bucket = 0;
+	}
+	queue->last = 0;
+}
+
+/******************************************************************************
+ * Push and Decrease
+ */
+PQError BucketQueue_Push(BucketQueue * const queue, const unsigned int id, const unsigned long long priority) {
+	if (id >= queue->n_keys) return PQ_ERROR_KEY_OUT_OF_RANGE;
+	if (queue->priorities[id] != BUCKET_NO_PRIORITY) return PQ_ERROR_KEY_ALREADY_EXISTS;
+	if (priority < queue->last) return PQ_ERROR_NOT_MONOTONE;
+	if (priority - queue->last >= queue->n_buckets) return PQ_ERROR_KEY_OUT_OF_RANGE;
+
+	BucketQueue_Link(queue, id, priority);
+	queue->n_data++;
+	return PQ_SUCCESS;
+}
+
+PQError BucketQueue_Decrease(BucketQueue * const queue, const unsigned int id, const unsigned long long priority) {
+	if (id >= queue->n_keys || queue->priorities[id] == BUCKET_NO_PRIORITY) return PQ_ERROR_KEY_DOES_NOT_EXIST;
+	if (priority < queue->last) return PQ_ERROR_NOT_MONOTONE;
+	if (priority >= queue->priorities[id]) return PQ_SUCCESS;
+
+	BucketQueue_Unlink(queue, id);
+	BucketQueue_Link(queue, id, priority);
+	return PQ_SUCCESS;
+}
+
+/******************************************************************************
+ * Pop Next
+ */
+PQError BucketQueue_PopMin(BucketQueue * const queue, unsigned int * const out_id, unsigned long long * const out_priority) {
+	if (queue->n_data == 0) return PQ_ERROR_EMPTY_QUEUE;
+
+	// Every queued priority is within n_buckets of last, so this terminates
+	while (queue->heads[queue->last % queue->n_buckets] == BUCKET_NONE) queue->last++;
+
+	unsigned int id = queue->heads[queue->last % queue->n_buckets];
+	BucketQueue_Unlink(queue, id);
+	queue->n_data--;
+
+	*out_id = id;
+	*out_priority = queue->last;
+	return PQ_SUCCESS;
+}
+
+/******************************************************************************
+ * Memory Heap Footprint
+ */
+size_t BucketQueue_Allocation(const BucketQueue * const queue) {
+	return sizeof(BucketQueue) + queue->n_buckets * sizeof(unsigned int)
+		+ 2 * queue->n_keys * sizeof(unsigned int) + queue->n_keys * sizeof(unsigned long long);
+}
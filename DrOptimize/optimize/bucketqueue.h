@@ -0,0 +1,45 @@
+/******************************************************************************
+ * Header file for the Bucket Queue.
+ */
+
+#pragma once
+
+#include "priorityqueue.h"
+
+/******************************************************************************
+ * BucketQueue is Dial's circular bucket queue over the dense ids
+ * [0, n_keys) with integer priorities. It is monotone: once a priority has
+ * been popped, every queued priority lies in [last, last + max_step], where
+ * max_step is the largest increment the caller will ever add to a popped
+ * priority. With max_step + 1 buckets indexed modulo their count, every
+ * queued priority therefore has its own bucket.
+ *
+ * Each bucket is a doubly-linked list threaded through the next and prev
+ * arrays, so push, decrease and unlink are O(1). PopMin advances a cursor
+ * over empty buckets, which costs O(max_step) amortized over a whole search.
+ */
+
+#define BUCKET_NONE 0xffffffffu
+
+// Priorities are 64-bit so that a search's distances, which grow with the
+// length of the path, never wrap; this marks an id that is not queued
+#define BUCKET_NO_PRIORITY 0xffffffffffffffffull
+
+typedef struct BucketQueue {
+	unsigned int * heads;
+	unsigned int * next;
+	unsigned int * prev;
+	unsigned long long * priorities;
+	unsigned int n_buckets;
+	unsigned int n_keys;
+	unsigned long long last;
+	unsigned int n_data;
+} BucketQueue;
+
+BucketQueue BucketQueue_New(const unsigned int n_keys, const unsigned int max_step);
+void BucketQueue_Free(BucketQueue * const);
+void BucketQueue_Clear(BucketQueue * const);
+PQError BucketQueue_Push(BucketQueue * const, const unsigned int id, const unsigned long long priority);
+PQError BucketQueue_Decrease(BucketQueue * const, const unsigned int id, const unsigned long long priority);
+PQError BucketQueue_PopMin(BucketQueue * const, unsigned int * const out_id, unsigned long long * const out_priority);
+size_t BucketQueue_Allocation(const BucketQueue * const);
@@ -0,0 +1,824 @@
+/******************************************************************************
+ * Contraction Hierarchies. Preprocessing contracts the nodes in rounds:
+ *	 1.	Every remaining node has a priority from its edge difference: the
+ *		shortcuts contracting it would add, counted twice, less the edges it
+ *		would remove. Twice that, plus the neighbours already contracted,
+ *		spreads contraction out evenly while keeping the shortcuts few.
+ *		Counting shortcuts only needs a rough witness search, cut off after
+ *		HIERARCHY_SIMULATION_SETTLES nodes.
+ *	 2.	The nodes whose priority is lower than that of all their neighbours
+ *		form an independent set, and are contracted together. Each thread
+ *		takes some of them and runs a witness search from every in-neighbour
+ *		to find which paths through the node have no other path as short;
+ *		those need shortcuts. Witness searches do not pass through any node
+ *		of the set.
+ *	 3.	The shortcuts are added and the contracted nodes removed on one
+ *		thread, in a fixed order, and the priorities of their neighbours
+ *		are brought up to date.
+ * Witness searches for contraction are cut off after HIERARCHY_WITNESS_SETTLES
+ * nodes, which can only add shortcuts that were not needed.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ch.h"
+#include "lazyheap.h"
+#include "thread.h"
+
+#define HIERARCHY_MAX_THREADS 64
+#define HIERARCHY_WITNESS_SETTLES 500
+#define HIERARCHY_SIMULATION_SETTLES 50
+// Nodes a thread claims at a time
+#define HIERARCHY_CHUNK 16
+
+#define HIERARCHY_REMAINING 0
+#define HIERARCHY_CONTRACTING 1
+#define HIERARCHY_CONTRACTED 2
+
+/******************************************************************************
+ * Adjacency of the graph being contracted. Arcs only ever join remaining
+ * nodes, and edge is the id of the HierarchyEdge they stand for.
+ */
+typedef struct HierarchyArc {
+	unsigned int node;
+	float cost;
+	unsigned int edge;
+} HierarchyArc;
+
+typedef struct HierarchyArcs {
+	HierarchyArc * arcs;
+	unsigned int n_arcs;
+	unsigned int capacity;
+} HierarchyArcs;
+
+static void HierarchyArcs_Append(HierarchyArcs * const arcs, const unsigned int node, const float cost, const unsigned int edge) {
+	if (arcs->n_arcs == arcs->capacity) {
+		arcs->capacity = arcs->capacity ? arcs->capacity * 2 : 4;
+		arcs->arcs = (HierarchyArc *)realloc(arcs->arcs, arcs->capacity * sizeof(HierarchyArc));
+	}
+	HierarchyArc * arc = arcs->arcs + arcs->n_arcs++;
+	arc->node = node;
+	arc->cost = cost;
+	arc->edge = edge;
+}
+
+static HierarchyArc * HierarchyArcs_Find(const HierarchyArcs * const arcs, const unsigned int node) {
+	for (unsigned int i = 0; i < arcs->n_arcs; i++) {
+		if (arcs->arcs[i].node == node) return arcs->arcs + i;
+	}
+	return NULL;
+}
+
+static void HierarchyArcs_Remove(HierarchyArcs * const arcs, const unsigned int node) {
+	HierarchyArc * arc = HierarchyArcs_Find(arcs, node);
+	if (arc) *arc = arcs->arcs[--arcs->n_arcs];
+}
+
+/******************************************************************************
+ * Witness searches. A search only reaches a few hundred nodes, so its costs
+ * live in a small hash table, cleared by moving to a new epoch, and its queue
+ * is a LazyHeap, whose memory does not grow with the graph either.
+ */
+typedef struct HierarchySlot {
+	unsigned int node;
+	unsigned int epoch;
+	float cost;
+} HierarchySlot;
+
+typedef struct HierarchyWitness {
+	HierarchySlot * slots;
+	unsigned int n_slots;
+	unsigned int n_used;
+	unsigned int epoch;
+	LazyHeap queue;
+
+	// Shortcuts found by this thread in the current round
+	HierarchyEdge * shortcuts;
+	unsigned int n_shortcuts;
+	unsigned int capacity;
+} HierarchyWitness;
+
+static inline HierarchySlot * HierarchyWitness_Slot(const HierarchyWitness * const witness, const unsigned int node) {
+	unsigned int mask = witness->n_slots - 1;
+	unsigned int i = (node * 2654435761u) & mask;
+	while (witness->slots[i].epoch == witness->epoch && witness->slots[i].node != node) i = (i + 1) & mask;
+	return witness->slots + i;
+}
+
+static float HierarchyWitness_Cost(const HierarchyWitness * const witness, const unsigned int node) {
+	const HierarchySlot * slot = HierarchyWitness_Slot(witness, node);
+	return slot->epoch == witness->epoch ? slot->cost : INFINITY;
+}
+
+static int HierarchyWitness_IsStale(const void * context, const unsigned int id, const float priority) {
+	return priority > HierarchyWitness_Cost((const HierarchyWitness *)context, id);
+}
+
+// Lowers the cost of node, returning whether it went down
+static int HierarchyWitness_Lower(HierarchyWitness * const witness, const unsigned int node, const float cost) {
+	HierarchySlot * slot = HierarchyWitness_Slot(witness, node);
+	if (slot->epoch == witness->epoch) {
+		if (cost >= slot->cost) return 0;
+		slot->cost = cost;
+		return 1;
+	}
+
+	// Keep the table at most half full
+	if (2 * (witness->n_used + 1) > witness->n_slots) {
+		HierarchySlot * old = witness->slots;
+		unsigned int n_old = witness->n_slots;
+		witness->n_slots *= 2;
+		witness->slots = (HierarchySlot *)calloc(witness->n_slots, sizeof(HierarchySlot));
+		for (unsigned int i = 0; i < n_old; i++) {
+			if (old[i].epoch == witness->epoch) *HierarchyWitness_Slot(witness, old[i].node) = old[i];
+		}
+		free(old);
+		slot = HierarchyWitness_Slot(witness, node);
+	}
+	slot->node = node;
+	slot->epoch = witness->epoch;
+	slot->cost = cost;
+	witness->n_used++;
+	return 1;
+}
+
+static void HierarchyWitness_Init(HierarchyWitness * const witness) {
+	memset(witness, 0, sizeof(HierarchyWitness));
+	witness->n_slots = 1024;
+	witness->slots = (HierarchySlot *)calloc(witness->n_slots, sizeof(HierarchySlot));
+	witness->queue = LazyHeap_New(HierarchyWitness_IsStale, witness);
+}
+
+static void HierarchyWitness_Free(HierarchyWitness * const witness) {
+	free(witness->slots);
+	free(witness->shortcuts);
+	LazyHeap_Free(&witness->queue);
+}
+
+/******************************************************************************
+ * Preprocessing state
+ */
+typedef struct HierarchyBuild {
+	unsigned int n_nodes;
+	HierarchyArcs * out;
+	HierarchyArcs * in;
+	unsigned char * states;
+	int * priorities;
+	unsigned int * n_deleted;
+
+	HierarchyEdge * edges;
+	unsigned int n_edges;
+	unsigned int capacity;
+
+	// Nodes for the current phase, claimed HIERARCHY_CHUNK at a time
+	unsigned int * work;
+	unsigned int n_work;
+	unsigned int next_work;
+	// Where each contracted node's shortcuts went: the thread, the first in
+	// its buffer and how many
+	unsigned int * shortcut_threads;
+	unsigned int * shortcut_firsts;
+	unsigned int * shortcut_counts;
+
+	unsigned int n_threads;
+	HierarchyWitness witnesses[HIERARCHY_MAX_THREADS];
+} HierarchyBuild;
+
+typedef void (*HierarchyPhase)(HierarchyBuild * const, const unsigned int thread);
+
+typedef struct HierarchyWorker {
+	Thread thread;
+	HierarchyBuild * build;
+	HierarchyPhase phase;
+	unsigned int index;
+} HierarchyWorker;
+
+static void * HierarchyWorker_Run(void * argument) {
+	HierarchyWorker * worker = (HierarchyWorker *)argument;
+	worker->phase(worker->build, worker->index);
+	return NULL;
+}
+
+// Runs phase over the work list on every thread, the calling thread being
+// thread 0
+static void HierarchyBuild_Run(HierarchyBuild * const build, const HierarchyPhase phase) {
+	HierarchyWorker workers[HIERARCHY_MAX_THREADS];
+	build->next_work = 0;
+	for (unsigned int i = 1; i < build->n_threads; i++) {
+		workers[i].build = build;
+		workers[i].phase = phase;
+		workers[i].index = i;
+		Thread_Start(&workers[i].thread, HierarchyWorker_Run, workers + i);
+	}
+	phase(build, 0);
+	for (unsigned int i = 1; i < build->n_threads; i++) Thread_Join(&workers[i].thread);
+}
+
+// Claims the next chunk of the work list, returning 0 once it is used up
+static int HierarchyBuild_Claim(HierarchyBuild * const build, unsigned int * const begin, unsigned int * const end) {
+	*begin = __atomic_fetch_add(&build->next_work, HIERARCHY_CHUNK, __ATOMIC_RELAXED);
+	if (*begin >= build->n_work) return 0;
+	*end = *begin + HIERARCHY_CHUNK < build->n_work ? *begin + HIERARCHY_CHUNK : build->n_work;
+	return 1;
+}
+
+// Costs from source over the remaining nodes other than via, as far as limit
+// or max_settles nodes
+static void HierarchyBuild_Witness(const HierarchyBuild * const build, HierarchyWitness * const witness,
+	const unsigned int source, const unsigned int via, const float limit, const unsigned int max_settles) {
+	// Stale slots only need clearing when the epoch wraps around
+	if (++witness->epoch == 0) {
+		memset(witness->slots, 0, witness->n_slots * sizeof(HierarchySlot));
+		witness->epoch = 1;
+	}
+	witness->n_used = 0;
+	LazyHeap_Clear(&witness->queue);
+	HierarchyWitness_Lower(witness, source, 0);
+	LazyHeap_Push(&witness->queue, source, 0);
+
+	unsigned int node;
+	float cost;
+	unsigned int n_settled = 0;
+	while (LazyHeap_PopMin(&witness->queue, &node, &cost) == PQ_SUCCESS) {
+		if (cost > limit || ++n_settled > max_settles) break;
+		const HierarchyArcs * arcs = build->out + node;
+		for (unsigned int i = 0; i < arcs->n_arcs; i++) {
+			const HierarchyArc * arc = arcs->arcs + i;
+			if (arc->node == via || build->states[arc->node] != HIERARCHY_REMAINING) continue;
+			if (HierarchyWitness_Lower(witness, arc->node, cost + arc->cost)) LazyHeap_Push(&witness->queue, arc->node, cost + arc->cost);
+		}
+	}
+}
+
+// Appends the shortcuts that contracting node needs to the witness's buffer
+// and returns how many there are
+static unsigned int HierarchyBuild_Shortcuts(const HierarchyBuild * const build, HierarchyWitness * const witness,
+	const unsigned int node, const unsigned int max_settles) {
+	const HierarchyArcs * ins = build->in + node;
+	const HierarchyArcs * outs = build->out + node;
+	float max_out = 0;
+	for (unsigned int j = 0; j < outs->n_arcs; j++) {
+		if (outs->arcs[j].cost > max_out) max_out = outs->arcs[j].cost;
+	}
+
+	unsigned int n_shortcuts = 0;
+	for (unsigned int i = 0; i < ins->n_arcs; i++) {
+		const HierarchyArc * in = ins->arcs + i;
+		HierarchyBuild_Witness(build, witness, in->node, node, in->cost + max_out, max_settles);
+		for (unsigned int j = 0; j < outs->n_arcs; j++) {
+			const HierarchyArc * out = outs->arcs + j;
+			if (out->node == in->node || HierarchyWitness_Cost(witness, out->node) <= in->cost + out->cost) continue;
+
+			if (witness->n_shortcuts == witness->capacity) {
+				witness->capacity = witness->capacity ? witness->capacity * 2 : 256;
+				witness->shortcuts = (HierarchyEdge *)realloc(witness->shortcuts, witness->capacity * sizeof(HierarchyEdge));
+			}
+			HierarchyEdge * shortcut = witness->shortcuts + witness->n_shortcuts++;
+			shortcut->from = in->node;
+			shortcut->to = out->node;
+			shortcut->cost = in->cost + out->cost;
+			shortcut->children[0] = in->edge;
+			shortcut->children[1] = out->edge;
+			n_shortcuts++;
+		}
+	}
+	return n_shortcuts;
+}
+
+/******************************************************************************
+ * Phases
+ */
+static void HierarchyBuild_Prioritize(HierarchyBuild * const build, const unsigned int thread) {
+	HierarchyWitness * witness = build->witnesses + thread;
+	unsigned int begin, end;
+	while (HierarchyBuild_Claim(build, &begin, &end)) {
+		for (unsigned int i = begin; i < end; i++) {
+			unsigned int node = build->work[i];
+			// Only count the shortcuts
+			unsigned int n_shortcuts = HierarchyBuild_Shortcuts(build, witness, node, HIERARCHY_SIMULATION_SETTLES);
+			witness->n_shortcuts -= n_shortcuts;
+			int difference = 2 * (int)n_shortcuts - (int)(build->in[node].n_arcs + build->out[node].n_arcs);
+			build->priorities[node] = 2 * difference + (int)build->n_deleted[node];
+		}
+	}
+}
+
+static void HierarchyBuild_Contract(HierarchyBuild * const build, const unsigned int thread) {
+	HierarchyWitness * witness = build->witnesses + thread;
+	unsigned int begin, end;
+	while (HierarchyBuild_Claim(build, &begin, &end)) {
+		for (unsigned int i = begin; i < end; i++) {
+			build->shortcut_threads[i] = thread;
+			build->shortcut_firsts[i] = witness->n_shortcuts;
+			build->shortcut_counts[i] = HierarchyBuild_Shortcuts(build, witness, build->work[i], HIERARCHY_WITNESS_SETTLES);
+		}
+	}
+}
+
+/******************************************************************************
+ * Construction
+ */
+
+// Ties in priority are broken by a scramble of the ids, which is one to one
+static inline int HierarchyBuild_Before(const HierarchyBuild * const build, const unsigned int a, const unsigned int b) {
+	if (build->priorities[a] != build->priorities[b]) return build->priorities[a] < build->priorities[b];
+	return a * 2654435761u < b * 2654435761u;
+}
+
+static int HierarchyBuild_IsLocalMinimum(const HierarchyBuild * const build, const unsigned int node) {
+	for (unsigned int i = 0; i < build->out[node].n_arcs; i++) {
+		if (!HierarchyBuild_Before(build, node, build->out[node].arcs[i].node)) return 0;
+	}
+	for (unsigned int i = 0; i < build->in[node].n_arcs; i++) {
+		if (!HierarchyBuild_Before(build, node, build->in[node].arcs[i].node)) return 0;
+	}
+	return 1;
+}
+
+static unsigned int HierarchyBuild_AddEdge(HierarchyBuild * const build, const HierarchyEdge * const edge) {
+	if (build->n_edges == build->capacity) {
+		build->capacity = build->capacity ? build->capacity * 2 : 1024;
+		build->edges = (HierarchyEdge *)realloc(build->edges, build->capacity * sizeof(HierarchyEdge));
+	}
+	build->edges[build->n_edges] = *edge;
+	return build->n_edges++;
+}
+
+// A shortcut replaces an arc that costs more, and is dropped for one that
+// costs no more; another node of the same round may have added either
+static void HierarchyBuild_AddShortcut(HierarchyBuild * const build, const HierarchyEdge * const shortcut) {
+	HierarchyArc * out = HierarchyArcs_Find(build->out + shortcut->from, shortcut->to);
+	if (out && out->cost <= shortcut->cost) return;
+	unsigned int id = HierarchyBuild_AddEdge(build, shortcut);
+	if (out) {
+		HierarchyArc * in = HierarchyArcs_Find(build->in + shortcut->to, shortcut->from);
+		out->cost = in->cost = shortcut->cost;
+		out->edge = in->edge = id;
+	}
+	else {
+		HierarchyArcs_Append(build->out + shortcut->from, shortcut->to, shortcut->cost, id);
+		HierarchyArcs_Append(build->in + shortcut->to, shortcut->from, shortcut->cost, id);
+	}
+}
+
+static unsigned int Hierarchy_ThreadCount(unsigned int n_threads) {
+	if (n_threads == 0) n_threads = Thread_CountProcessors();
+	if (n_threads > HIERARCHY_MAX_THREADS) n_threads = HIERARCHY_MAX_THREADS;
+	return n_threads;
+}
+
+// Lays the edge ids recorded per node out as CSR arrays
+static void Hierarchy_Pack(const unsigned int n_nodes, const unsigned int * const firsts, const unsigned int * const counts,
+	const unsigned int * const ids, unsigned int ** const out_offsets, unsigned int ** const out_ids) {
+	unsigned int * offsets = (unsigned int *)malloc((n_nodes + 1) * sizeof(unsigned int));
+	offsets[0] = 0;
+	for (unsigned int i = 0; i < n_nodes; i++) offsets[i + 1] = offsets[i] + counts[i];
+	unsigned int * packed = (unsigned int *)malloc((offsets[n_nodes] ? offsets[n_nodes] : 1) * sizeof(unsigned int));
+	for (unsigned int i = 0; i < n_nodes; i++) memcpy(packed + offsets[i], ids + firsts[i], counts[i] * sizeof(unsigned int));
+	*out_offsets = offsets;
+	*out_ids = packed;
+}
+
+/******************************************************************************
+ * Contracts every node of graph, using n_threads threads (0 for one per
+ * processor) for the witness searches.
+ */
+Hierarchy Hierarchy_Build(const Graph * const graph, const unsigned int n_threads) {
+	Hierarchy hierarchy;
+	memset(&hierarchy, 0, sizeof(Hierarchy));
+	if (graph->error) {
+		hierarchy.error = graph->error;
+		return hierarchy;
+	}
+	unsigned int n_nodes = graph->n_nodes;
+
+	HierarchyBuild build;
+	memset(&build, 0, sizeof(HierarchyBuild));
+	build.n_nodes = n_nodes;
+	build.n_threads = Hierarchy_ThreadCount(n_threads);
+	build.out = (HierarchyArcs *)calloc(n_nodes, sizeof(HierarchyArcs));
+	build.in = (HierarchyArcs *)calloc(n_nodes, sizeof(HierarchyArcs));
+	build.states = (unsigned char *)calloc(n_nodes, 1);
+	build.priorities = (int *)malloc(n_nodes * sizeof(int));
+	build.n_deleted = (unsigned int *)calloc(n_nodes, sizeof(unsigned int));
+	build.work = (unsigned int *)malloc(n_nodes * sizeof(unsigned int));
+	build.shortcut_threads = (unsigned int *)malloc(n_nodes * sizeof(unsigned int));
+	build.shortcut_firsts = (unsigned int *)malloc(n_nodes * sizeof(unsigned int));
+	build.shortcut_counts = (unsigned int *)malloc(n_nodes * sizeof(unsigned int));
+	for (unsigned int i = 0; i < build.n_threads; i++) HierarchyWitness_Init(build.witnesses + i);
+
+	// Original edges, keeping the cheapest of parallel connections
+	unsigned int * last_edges = (unsigned int *)malloc(n_nodes * sizeof(unsigned int));
+	memset(last_edges, 0xff, n_nodes * sizeof(unsigned int));
+	for (unsigned int node = 0; node < n_nodes; node++) {
+		for (unsigned int i = graph->offsets[node]; i < graph->offsets[node + 1]; i++) {
+			unsigned int to = graph->edges[i].node;
+			float cost = graph->edges[i].cost;
+			if (to == node) continue;
+			unsigned int last = last_edges[to];
+			if (last != HIERARCHY_NO_EDGE && build.edges[last].from == node) {
+				if (cost < build.edges[last].cost) build.edges[last].cost = cost;
+				continue;
+			}
+			HierarchyEdge edge = { node, to, cost, { HIERARCHY_NO_EDGE, HIERARCHY_NO_EDGE } };
+			last_edges[to] = HierarchyBuild_AddEdge(&build, &edge);
+		}
+	}
+	free(last_edges);
+	for (unsigned int i = 0; i < build.n_edges; i++) {
+		const HierarchyEdge * edge = build.edges + i;
+		HierarchyArcs_Append(build.out + edge->from, edge->to, edge->cost, i);
+		HierarchyArcs_Append(build.in + edge->to, edge->from, edge->cost, i);
+	}
+	unsigned int n_original = build.n_edges;
+
+	// The edges each node keeps once contracted: up is ordered by node, then
+	// edge, and down is after up in the same array
+	unsigned int * firsts[2], * counts[2];
+	unsigned int * kept = NULL;
+	unsigned int n_kept = 0, kept_capacity = 0;
+	for (int d = 0; d < 2; d++) {
+		firsts[d] = (unsigned int *)malloc(n_nodes * sizeof(unsigned int));
+		counts[d] = (unsigned int *)malloc(n_nodes * sizeof(unsigned int));
+	}
+	hierarchy.ranks = (unsigned int *)malloc(n_nodes * sizeof(unsigned int));
+
+	// Every node starts out remaining
+	unsigned int * remaining = (unsigned int *)malloc(n_nodes * sizeof(unsigned int));
+	unsigned int * touched = (unsigned int *)malloc(n_nodes * sizeof(unsigned int));
+	unsigned int n_remaining = n_nodes;
+	for (unsigned int i = 0; i < n_nodes; i++) remaining[i] = build.work[i] = i;
+	build.n_work = n_nodes;
+	HierarchyBuild_Run(&build, HierarchyBuild_Prioritize);
+
+	unsigned int rank = 0;
+	while (n_remaining) {
+		// Contract an independent set of local minima
+		build.n_work = 0;
+		for (unsigned int i = 0; i < n_remaining; i++) {
+			if (HierarchyBuild_IsLocalMinimum(&build, remaining[i])) build.work[build.n_work++] = remaining[i];
+		}
+		for (unsigned int i = 0; i < build.n_work; i++) build.states[build.work[i]] = HIERARCHY_CONTRACTING;
+		for (unsigned int i = 0; i < build.n_threads; i++) build.witnesses[i].n_shortcuts = 0;
+		HierarchyBuild_Run(&build, HierarchyBuild_Contract);
+
+		unsigned int n_touched = 0;
+		for (unsigned int i = 0; i < build.n_work; i++) {
+			unsigned int node = build.work[i];
+			hierarchy.ranks[node] = rank++;
+
+			// Its remaining edges lead up the hierarchy
+			HierarchyArcs * arcs[2] = { build.out + node, build.in + node };
+			for (int d = 0; d < 2; d++) {
+				if (n_kept + arcs[d]->n_arcs > kept_capacity) {
+					kept_capacity = 2 * (n_kept + arcs[d]->n_arcs);
+					kept = (unsigned int *)realloc(kept, kept_capacity * sizeof(unsigned int));
+				}
+				firsts[d][node] = n_kept;
+				counts[d][node] = arcs[d]->n_arcs;
+				for (unsigned int j = 0; j < arcs[d]->n_arcs; j++) {
+					unsigned int neighbour = arcs[d]->arcs[j].node;
+					kept[n_kept++] = arcs[d]->arcs[j].edge;
+					HierarchyArcs_Remove(d ? build.out + neighbour : build.in + neighbour, node);
+					if (build.states[neighbour] == HIERARCHY_REMAINING) {
+						build.states[neighbour] = HIERARCHY_CONTRACTING;
+						touched[n_touched++] = neighbour;
+					}
+					build.n_deleted[neighbour]++;
+				}
+				free(arcs[d]->arcs);
+				memset(arcs[d], 0, sizeof(HierarchyArcs));
+			}
+			build.states[node] = HIERARCHY_CONTRACTED;
+
+			const HierarchyEdge * shortcuts = build.witnesses[build.shortcut_threads[i]].shortcuts + build.shortcut_firsts[i];
+			for (unsigned int j = 0; j < build.shortcut_counts[i]; j++) HierarchyBuild_AddShortcut(&build, shortcuts + j);
+		}
+
+		// Drop the contracted nodes and update the neighbours' priorities
+		unsigned int n_kept_remaining = 0;
+		for (unsigned int i = 0; i < n_remaining; i++) {
+			if (build.states[remaining[i]] != HIERARCHY_CONTRACTED) remaining[n_kept_remaining++] = remaining[i];
+		}
+		n_remaining = n_kept_remaining;
+		for (unsigned int i = 0; i < n_touched; i++) build.states[touched[i]] = HIERARCHY_REMAINING;
+		memcpy(build.work, touched, n_touched * sizeof(unsigned int));
+		build.n_work = n_touched;
+		HierarchyBuild_Run(&build, HierarchyBuild_Prioritize);
+	}
+
+	hierarchy.n_nodes = n_nodes;
+	hierarchy.n_edges = build.n_edges;
+	hierarchy.n_shortcuts = build.n_edges - n_original;
+	hierarchy.edges = (HierarchyEdge *)realloc(build.edges, (build.n_edges ? build.n_edges : 1) * sizeof(HierarchyEdge));
+	Hierarchy_Pack(n_nodes, firsts[0], counts[0], kept, &hierarchy.up_offsets, &hierarchy.up_edges);
+	Hierarchy_Pack(n_nodes, firsts[1], counts[1], kept, &hierarchy.down_offsets, &hierarchy.down_edges);
+
+	for (int d = 0; d < 2; d++) {
+		free(firsts[d]);
+		free(counts[d]);
+	}
+	free(kept);
+	free(remaining);
+	free(touched);
+	for (unsigned int i = 0; i < build.n_threads; i++) HierarchyWitness_Free(build.witnesses + i);
+	free(build.out);
+	free(build.in);
+	free(build.states);
+	free(build.priorities);
+	free(build.n_deleted);
+	free(build.work);
+	free(build.shortcut_threads);
+	free(build.shortcut_firsts);
+	free(build.shortcut_counts);
+	return hierarchy;
+}
+
+void Hierarchy_Free(Hierarchy * const hierarchy) {
+	free(hierarchy->ranks);
+	free(hierarchy->edges);
+	free(hierarchy->up_offsets);
+	free(hierarchy->up_edges);
+	free(hierarchy->down_offsets);
+	free(hierarchy->down_edges);
+	memset(hierarchy, 0, sizeof(Hierarchy));
+}
+
+size_t Hierarchy_Allocation(const Hierarchy * const hierarchy) {
+	size_t size = sizeof(Hierarchy);
+	if (!hierarchy->ranks) return size;
+	size += hierarchy->n_nodes * sizeof(unsigned int) + hierarchy->n_edges * sizeof(HierarchyEdge);
+	size += 2 * (hierarchy->n_nodes + 1) * sizeof(unsigned int);
+	size += (hierarchy->up_offsets[hierarchy->n_nodes] + hierarchy->down_offsets[hierarchy->n_nodes]) * sizeof(unsigned int);
+	return size;
+}
+
+/******************************************************************************
+ * Files are binary, in the byte order of the machine: the 8 bytes of
+ * HIERARCHY_MAGIC, n_nodes, n_edges and n_shortcuts, then the arrays in the
+ * order of the struct. Both functions return 0 on success and -1 if the file
+ * cannot be opened or is not a valid hierarchy.
+ */
+static const char HIERARCHY_MAGIC[8] = { 'd', 'k', 'c', 'h', 0, 0, 0, 1 };
+
+int Hierarchy_Write(const Hierarchy * const hierarchy, const char * path) {
+	if (hierarchy->error) return -1;
+	FILE * file = fopen(path, "wb");
+	if (!file) return -1;
+	unsigned int n = hierarchy->n_nodes;
+	unsigned int header[3] = { n, hierarchy->n_edges, hierarchy->n_shortcuts };
+	int ok = fwrite(HIERARCHY_MAGIC, 1, 8, file) == 8 && fwrite(header, sizeof(unsigned int), 3, file) == 3
+		&& fwrite(hierarchy->ranks, sizeof(unsigned int), n, file) == n
+		&& fwrite(hierarchy->edges, sizeof(HierarchyEdge), hierarchy->n_edges, file) == hierarchy->n_edges
+		&& fwrite(hierarchy->up_offsets, sizeof(unsigned int), n + 1, file) == n + 1
+		&& fwrite(hierarchy->up_edges, sizeof(unsigned int), hierarchy->up_offsets[n], file) == hierarchy->up_offsets[n]
+		&& fwrite(hierarchy->down_offsets, sizeof(unsigned int), n + 1, file) == n + 1
+		&& fwrite(hierarchy->down_edges, sizeof(unsigned int), hierarchy->down_offsets[n], file) == hierarchy->down_offsets[n];
+	return fclose(file) == 0 && ok ? 0 : -1;
+}
+
+// Reads offsets for n nodes and the edge ids they index, checking both
+static int Hierarchy_ReadLists(FILE * file, const unsigned int n, const unsigned int n_edges,
+	unsigned int ** const out_offsets, unsigned int ** const out_ids) {
+	unsigned int * offsets = (unsigned int *)malloc((n + 1) * sizeof(unsigned int));
+	*out_offsets = offsets;
+	if (fread(offsets, sizeof(unsigned int), n + 1, file) != n + 1 || offsets[0] != 0) return -1;
+	for (unsigned int i = 0; i < n; i++) {
+		if (offsets[i + 1] < offsets[i]) return -1;
+	}
+	unsigned int * ids = (unsigned int *)malloc((offsets[n] ? offsets[n] : 1) * sizeof(unsigned int));
+	*out_ids = ids;
+	if (fread(ids, sizeof(unsigned int), offsets[n], file) != offsets[n]) return -1;
+	for (unsigned int i = 0; i < offsets[n]; i++) {
+		if (ids[i] >= n_edges) return -1;
+	}
+	return 0;
+}
+
+int Hierarchy_Read(Hierarchy * const hierarchy, const char * path) {
+	memset(hierarchy, 0, sizeof(Hierarchy));
+	FILE * file = fopen(path, "rb");
+	if (!file) return -1;
+	char magic[8];
+	unsigned int header[3];
+	int ok = fread(magic, 1, 8, file) == 8 && memcmp(magic, HIERARCHY_MAGIC, 8) == 0
+		&& fread(header, sizeof(unsigned int), 3, file) == 3;
+	if (ok) {
+		unsigned int n = hierarchy->n_nodes = header[0];
+		hierarchy->n_edges = header[1];
+		hierarchy->n_shortcuts = header[2];
+		hierarchy->ranks = (unsigned int *)malloc((n ? n : 1) * sizeof(unsigned int));
+		hierarchy->edges = (HierarchyEdge *)malloc((header[1] ? header[1] : 1) * sizeof(HierarchyEdge));
+		ok = fread(hierarchy->ranks, sizeof(unsigned int), n, file) == n
+			&& fread(hierarchy->edges, sizeof(HierarchyEdge), header[1], file) == header[1];
+		for (unsigned int i = 0; ok && i < header[1]; i++) {
+			const HierarchyEdge * edge = hierarchy->edges + i;
+			ok = edge->from < n && edge->to < n
+				&& (edge->children[0] == HIERARCHY_NO_EDGE ? edge->children[1] == HIERARCHY_NO_EDGE
+					: edge->children[0] < i && edge->children[1] < i);
+		}
+		ok = ok && Hierarchy_ReadLists(file, n, header[1], &hierarchy->up_offsets, &hierarchy->up_edges) == 0
+			&& Hierarchy_ReadLists(file, n, header[1], &hierarchy->down_offsets, &hierarchy->down_edges) == 0;
+	}
+	fclose(file);
+	if (!ok) {
+		Hierarchy_Free(hierarchy);
+		return -1;
+	}
+	return 0;
+}
+
+/******************************************************************************
+ * Queries
+ */
+static int Hierarchy_Compare(float left, float right) {
+	if (left > right) return 1;
+	else if (left < right) return -1;
+	else return 0;
+}
+
+HierarchyWorkspace HierarchyWorkspace_New(void) {
+	HierarchyWorkspace workspace;
+	memset(&workspace, 0, sizeof(HierarchyWorkspace));
+	return workspace;
+}
+
+void HierarchyWorkspace_Free(HierarchyWorkspace * const workspace) {
+	for (int side = 0; side < 2; side++) {
+		free(workspace->costs[side]);
+		free(workspace->parents[side]);
+		free(workspace->stamps[side]);
+		if (workspace->capacity) PriorityQueue_Free(workspace->queues + side);
+	}
+	free(workspace->stack);
+	memset(workspace, 0, sizeof(HierarchyWorkspace));
+}
+
+// Makes room for n_nodes nodes and moves to a new epoch
+static void HierarchyWorkspace_Prepare(HierarchyWorkspace * const workspace, const unsigned int n_nodes) {
+	if (n_nodes > workspace->capacity) {
+		HierarchyWorkspace_Free(workspace);
+		for (int side = 0; side < 2; side++) {
+			workspace->costs[side] = (float *)malloc(n_nodes * sizeof(float));
+			workspace->parents[side] = (unsigned int *)malloc(n_nodes * sizeof(unsigned int));
+			workspace->stamps[side] = (unsigned int *)calloc(n_nodes, sizeof(unsigned int));
+			workspace->queues[side] = PriorityQueue_NewDense(Hierarchy_Compare, NULL, n_nodes, PQ_DEFAULT_ARITY);
+			PriorityQueue_BuildImplicit(workspace->queues + side, INFINITY, NULL, 0);
+		}
+		workspace->capacity = n_nodes;
+	}
+	for (int side = 0; side < 2; side++) PriorityQueue_Clear(workspace->queues + side);
+	if (++workspace->epoch == 0) {
+		for (int side = 0; side < 2; side++) memset(workspace->stamps[side], 0, workspace->capacity * sizeof(unsigned int));
+		workspace->epoch = 1;
+	}
+}
+
+static inline float HierarchyWorkspace_Cost(const HierarchyWorkspace * const workspace, const int side, const unsigned int node) {
+	return workspace->stamps[side][node] == workspace->epoch ? workspace->costs[side][node] : INFINITY;
+}
+
+static void HierarchyWorkspace_Push(HierarchyWorkspace * const workspace, const unsigned int edge) {
+	if (workspace->n_stack == workspace->stack_capacity) {
+		workspace->stack_capacity = workspace->stack_capacity ? workspace->stack_capacity * 2 : 64;
+		workspace->stack = (unsigned int *)realloc(workspace->stack, workspace->stack_capacity * sizeof(unsigned int));
+	}
+	workspace->stack[workspace->n_stack++] = edge;
+}
+
+DijkstraOutput Hierarchy_Query(const Hierarchy * const hierarchy, const unsigned int start, const unsigned int end) {
+	HierarchyWorkspace workspace = HierarchyWorkspace_New();
+	DijkstraOutput output = Hierarchy_QueryWithWorkspace(&workspace, hierarchy, start, end);
+	HierarchyWorkspace_Free(&workspace);
+	return output;
+}
+
+/******************************************************************************
+ * Shortest path from start to end, with the errors of Dijkstra_Query. The
+ * two searches take turns, each stopping once its queue holds nothing below
+ * the best path found. A node is stalled, and not expanded, if it can be
+ * reached more cheaply from a node the same search ranked above it. The
+ * path is unpacked to the original nodes and its cost summed along them.
+ */
+DijkstraOutput Hierarchy_QueryWithWorkspace(HierarchyWorkspace * const workspace, const Hierarchy * const hierarchy,
+	const unsigned int start, const unsigned int end) {
+	DijkstraOutput output;
+	memset(&output, 0, sizeof(DijkstraOutput));
+	output.total_cost = INFINITY;
+	if (hierarchy->error) {
+		output.error = hierarchy->error;
+		return output;
+	}
+	if (start >= hierarchy->n_nodes) {
+		output.error = DIJKSTRA_ERROR_INVALID_START;
+		return output;
+	}
+	else if (end >= hierarchy->n_nodes) {
+		output.error = DIJKSTRA_ERROR_INVALID_END;
+		return output;
+	}
+
+	HierarchyWorkspace_Prepare(workspace, hierarchy->n_nodes);
+	const unsigned int * offsets[2] = { hierarchy->up_offsets, hierarchy->down_offsets };
+	const unsigned int * lists[2] = { hierarchy->up_edges, hierarchy->down_edges };
+	unsigned int roots[2] = { start, end };
+	for (int side = 0; side < 2; side++) {
+		workspace->stamps[side][roots[side]] = workspace->epoch;
+		workspace->costs[side][roots[side]] = 0;
+		workspace->parents[side][roots[side]] = HIERARCHY_NO_EDGE;
+		PriorityQueue_SetPriority(workspace->queues + side, (Data_t)roots[side], 0);
+	}
+
+	float mu = INFINITY;
+	unsigned int meeting = start;
+	int done[2] = { 0, 0 };
+	int side = 0;
+	while (!done[0] || !done[1]) {
+		if (done[side]) side = !side;
+		Data_t data;
+		float cost;
+		if (PriorityQueue_PopMin(workspace->queues + side, &data, &cost) != PQ_SUCCESS || cost >= mu) {
+			done[side] = 1;
+			continue;
+		}
+		unsigned int node = (unsigned int)data;
+		float other = HierarchyWorkspace_Cost(workspace, !side, node);
+		if (cost + other < mu) {
+			mu = cost + other;
+			meeting = node;
+		}
+
+		// Stall on the edges the other way, which come from higher nodes
+		int stalled = 0;
+		for (unsigned int i = offsets[!side][node]; i < offsets[!side][node + 1] && !stalled; i++) {
+			const HierarchyEdge * edge = hierarchy->edges + lists[!side][i];
+			stalled = HierarchyWorkspace_Cost(workspace, side, side ? edge->to : edge->from) + edge->cost < cost;
+		}
+		if (!stalled) {
+			output.n_settled++;
+			for (unsigned int i = offsets[side][node]; i < offsets[side][node + 1]; i++) {
+				unsigned int id = lists[side][i];
+				const HierarchyEdge * edge = hierarchy->edges + id;
+				unsigned int next = side ? edge->from : edge->to;
+				float next_cost = cost + edge->cost;
+				if (next_cost < HierarchyWorkspace_Cost(workspace, side, next)) {
+					workspace->stamps[side][next] = workspace->epoch;
+					workspace->costs[side][next] = next_cost;
+					workspace->parents[side][next] = id;
+					PriorityQueue_SetPriority(workspace->queues + side, (Data_t)next, next_cost);
+				}
+			}
+		}
+		side = !side;
+	}
+
+	if (mu == INFINITY) {
+		output.error = DIJKSTRA_ERROR_START_AND_END_NOT_CONNECTED;
+		return output;
+	}
+
+	// Stack the edges from end back to the meeting node, then from there
+	// back to start, so that they pop in path order
+	workspace->n_stack = 0;
+	for (unsigned int node = meeting; node != end;) {
+		unsigned int id = workspace->parents[1][node];
+		HierarchyWorkspace_Push(workspace, id);
+		node = hierarchy->edges[id].to;
+	}
+	unsigned int n_backward = workspace->n_stack;
+	for (unsigned int i = 0; i < n_backward / 2; i++) {
+		unsigned int swap = workspace->stack[i];
+		workspace->stack[i] = workspace->stack[n_backward - 1 - i];
+		workspace->stack[n_backward - 1 - i] = swap;
+	}
+	for (unsigned int node = meeting; node != start;) {
+		unsigned int id = workspace->parents[0][node];
+		HierarchyWorkspace_Push(workspace, id);
+		node = hierarchy->edges[id].from;
+	}
+
+	// Unpack shortcuts into their children until original edges surface
+	unsigned int capacity = 16;
+	output.path = (unsigned int *)malloc(capacity * sizeof(unsigned int));
+	output.path[0] = start;
+	output.n_elements = 1;
+	output.total_cost = 0;
+	while (workspace->n_stack) {
+		const HierarchyEdge * edge = hierarchy->edges + workspace->stack[--workspace->n_stack];
+		if (edge->children[0] != HIERARCHY_NO_EDGE) {
+			HierarchyWorkspace_Push(workspace, edge->children[1]);
+			HierarchyWorkspace_Push(workspace, edge->children[0]);
+			continue;
+		}
+		if (output.n_elements == capacity) {
+			capacity *= 2;
+			output.path = (unsigned int *)realloc(output.path, capacity * sizeof(unsigned int));
+		}
+		output.path[output.n_elements++] = edge->to;
+		output.total_cost += edge->cost;
+	}
+	return output;
+}
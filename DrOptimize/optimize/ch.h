@@ -0,0 +1,77 @@
+/******************************************************************************
+ * Header file for Contraction Hierarchies.
+ */
+
+#pragma once
+
+#include "dijkstra.h"
+
+/******************************************************************************
+ * A Hierarchy ranks the nodes of a Graph by the order in which they were
+ * contracted. Contracting a node removes it from the graph, adding a shortcut
+ * between two of its neighbours wherever the path through it was the only
+ * shortest one. A query then searches only upwards: forward from start along
+ * edges to higher ranks, and backward from end along edges from higher ranks,
+ * meeting at the highest node of the shortest path.
+ *
+ * Every edge, original or shortcut, is in edges. A shortcut names the two
+ * edges it stands for, so paths unpack back to the original nodes. The edges
+ * a query follows from node i are up_edges[up_offsets[i]] up to
+ * up_edges[up_offsets[i + 1]] going forward, and likewise in down_edges
+ * going backward; both hold ids into edges.
+ *
+ * Parallel connections are merged into the cheapest and loops are dropped.
+ * error is DIJKSTRA_SUCCESS, or the error of the Graph it was built from.
+ */
+#define HIERARCHY_NO_EDGE 0xffffffffu
+
+typedef struct HierarchyEdge {
+	unsigned int from, to;
+	float cost;
+	// HIERARCHY_NO_EDGE for connections of the graph
+	unsigned int children[2];
+} HierarchyEdge;
+
+typedef struct Hierarchy {
+	unsigned int n_nodes;
+	unsigned int n_edges;
+	unsigned int n_shortcuts;
+	unsigned int * ranks;
+	HierarchyEdge * edges;
+	unsigned int * up_offsets;
+	unsigned int * up_edges;
+	unsigned int * down_offsets;
+	unsigned int * down_edges;
+	unsigned int error;
+} Hierarchy;
+
+/******************************************************************************
+ * Query state kept between queries, like a DijkstraWorkspace: the costs and
+ * parents of each direction are only valid where its stamps match epoch. A
+ * workspace serves one query at a time.
+ */
+typedef struct HierarchyWorkspace {
+	float * costs[2];
+	unsigned int * parents[2];
+	unsigned int * stamps[2];
+	unsigned int epoch;
+	unsigned int capacity;
+	PriorityQueue queues[2];
+	// Edges still to unpack
+	unsigned int * stack;
+	unsigned int n_stack;
+	unsigned int stack_capacity;
+} HierarchyWorkspace;
+
+Hierarchy Hierarchy_Build(const Graph * const graph, const unsigned int n_threads);
+void Hierarchy_Free(Hierarchy * const);
+size_t Hierarchy_Allocation(const Hierarchy * const);
+int Hierarchy_Write(const Hierarchy * const, const char * path);
+int Hierarchy_Read(Hierarchy * const, const char * path);
+
+HierarchyWorkspace HierarchyWorkspace_New(void);
+void HierarchyWorkspace_Free(HierarchyWorkspace * const);
+
+DijkstraOutput Hierarchy_Query(const Hierarchy * const hierarchy, const unsigned int start, const unsigned int end);
+DijkstraOutput Hierarchy_QueryWithWorkspace(HierarchyWorkspace * const workspace, const Hierarchy * const hierarchy,
+	const unsigned int start, const unsigned int end);
@@ -0,0 +1,315 @@
+/******************************************************************************
+ * Parallel delta-stepping on the Graph of dijkstra.c. Every thread runs the
+ * same loop, meeting the others at barriers:
+ *	 1.	Light phase: the threads claim chunks of the frontier, the entries of
+ *		the current bucket, and relax the light edges of their nodes. Nodes
+ *		whose cost falls go into buckets private to the thread that lowered
+ *		it. The threads' entries for the current bucket then become the next
+ *		frontier, until there are none.
+ *	 2.	Heavy phase: each thread relaxes the heavy edges of the nodes it
+ *		expanded in the light phase.
+ *	 3.	The next bucket is the lowest any thread has entries in.
+ *
+ * Each node's cost and parent are packed into one 64-bit label, the cost's
+ * bits above the parent's, and lowered with compare-and-swap. Costs are never
+ * negative, so their bits order like the costs, and the swap is an atomic
+ * minimum of the cost that carries the parent along with it.
+ *
+ * A node is expanded whenever its cost is below the cost it was last expanded
+ * at, so duplicate entries left behind when a cost falls again are skipped,
+ * and the result does not depend on how rounding assigns costs to buckets.
+ * Pending costs lie within the largest edge cost of the current bucket, so
+ * each thread's buckets are a ring of max_cost / delta + 3 lists.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "deltastep.h"
+#include "thread.h"
+
+#define DELTASTEP_MAX_THREADS 64
+// Frontier entries a thread claims at a time
+#define DELTASTEP_CHUNK 64
+// Most buckets in a ring, which bounds how small delta can be
+#define DELTASTEP_MAX_BUCKETS (1u << 20)
+// Edges sampled to pick delta, and its multiple of their mean cost
+#define DELTASTEP_SAMPLES 4096
+#define DELTASTEP_MEAN_FACTOR 2.0f
+
+#define DELTASTEP_NO_BUCKET 0xffffffffffffffffull
+
+typedef struct DeltaStepList {
+	unsigned int * nodes;
+	unsigned int n_nodes;
+	unsigned int capacity;
+} DeltaStepList;
+
+static void DeltaStepList_Append(DeltaStepList * const list, const unsigned int node) {
+	if (list->n_nodes == list->capacity) {
+		list->capacity = list->capacity ? list->capacity * 2 : 64;
+		list->nodes = (unsigned int *)realloc(list->nodes, list->capacity * sizeof(unsigned int));
+	}
+	list->nodes[list->n_nodes++] = node;
+}
+
+typedef struct DeltaStepThread {
+	// Ring of buckets, bucket i at i % n_buckets
+	DeltaStepList * buckets;
+	// Nodes expanded in the light phase, for the heavy phase
+	DeltaStepList expanded;
+	// Published to the other threads between barriers
+	unsigned int count;
+	unsigned int offset;
+	unsigned long long next_bucket;
+} DeltaStepThread;
+
+typedef struct DeltaStep {
+	const Graph * graph;
+	unsigned int source;
+	float delta;
+	unsigned int n_buckets;
+	unsigned long long * labels;
+	// Cost bits each node was last expanded at along light and heavy edges
+	unsigned int * light_costs;
+	unsigned int * heavy_costs;
+
+	unsigned int * frontier;
+	unsigned int n_frontier;
+	unsigned int frontier_capacity;
+	unsigned int next_claim;
+
+	unsigned int n_threads;
+	ThreadBarrier barrier;
+	DeltaStepThread threads[DELTASTEP_MAX_THREADS];
+	float * dist;
+	unsigned int * parent;
+} DeltaStep;
+
+typedef struct DeltaStepWorker {
+	Thread thread;
+	DeltaStep * step;
+	unsigned int index;
+} DeltaStepWorker;
+
+static inline unsigned int DeltaStep_Bits(const float cost) {
+	unsigned int bits;
+	memcpy(&bits, &cost, sizeof(unsigned int));
+	return bits;
+}
+
+static inline float DeltaStep_Cost(const unsigned int bits) {
+	float cost;
+	memcpy(&cost, &bits, sizeof(float));
+	return cost;
+}
+
+// Lowers the cost of node to cost through parent, returning whether it fell
+static inline int DeltaStep_Lower(DeltaStep * const step, const unsigned int node, const float cost, const unsigned int parent) {
+	unsigned long long candidate = (unsigned long long)DeltaStep_Bits(cost) << 32 | parent;
+	unsigned long long label = __atomic_load_n(step->labels + node, __ATOMIC_RELAXED);
+	while ((candidate >> 32) < (label >> 32)) {
+		if (__atomic_compare_exchange_n(step->labels + node, &label, candidate, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) return 1;
+	}
+	return 0;
+}
+
+// Relaxes the light or heavy edges of node if its cost has fallen since they
+// were last relaxed, filing the nodes they lower in buckets no earlier than
+// first
+static void DeltaStep_Expand(DeltaStep * const step, DeltaStepThread * const thread, const unsigned int node,
+	const int heavy, const unsigned long long first) {
+	unsigned int bits = (unsigned int)(__atomic_load_n(step->labels + node, __ATOMIC_RELAXED) >> 32);
+	unsigned int * costs = heavy ? step->heavy_costs : step->light_costs;
+	if (__atomic_exchange_n(costs + node, bits, __ATOMIC_RELAXED) <= bits) return;
+	if (!heavy) DeltaStepList_Append(&thread->expanded, node);
+
+	const Graph * graph = step->graph;
+	float cost = DeltaStep_Cost(bits);
+	float delta = step->delta;
+	for (unsigned int i = graph->offsets[node]; i < graph->offsets[node + 1]; i++) {
+		float edge_cost = graph->edges[i].cost;
+		if ((edge_cost > delta) != heavy) continue;
+		unsigned int next = graph->edges[i].node;
+		float next_cost = cost + edge_cost;
+		if (DeltaStep_Lower(step, next, next_cost, node)) {
+			unsigned long long bucket = (unsigned long long)(next_cost / delta);
+			if (bucket < first) bucket = first;
+			DeltaStepList_Append(thread->buckets + bucket % step->n_buckets, next);
+		}
+	}
+}
+
+// Makes each thread's entries for bucket the frontier, returning how many
+// there are. Every thread calls it and gets the same answer.
+static unsigned int DeltaStep_Gather(DeltaStep * const step, const unsigned int index, const unsigned long long bucket) {
+	DeltaStepThread * thread = step->threads + index;
+	DeltaStepList * list = thread->buckets + bucket % step->n_buckets;
+	thread->count = list->n_nodes;
+	ThreadBarrier_Wait(&step->barrier);
+	if (index == 0) {
+		unsigned int total = 0;
+		for (unsigned int i = 0; i < step->n_threads; i++) {
+			step->threads[i].offset = total;
+			total += step->threads[i].count;
+		}
+		if (total > step->frontier_capacity) {
+			free(step->frontier);
+			step->frontier_capacity = total * 2;
+			step->frontier = (unsigned int *)malloc(step->frontier_capacity * sizeof(unsigned int));
+		}
+		step->n_frontier = total;
+		step->next_claim = 0;
+	}
+	ThreadBarrier_Wait(&step->barrier);
+	unsigned int total = step->n_frontier;
+	if (total == 0) return 0;
+	if (list->n_nodes) memcpy(step->frontier + thread->offset, list->nodes, list->n_nodes * sizeof(unsigned int));
+	list->n_nodes = 0;
+	ThreadBarrier_Wait(&step->barrier);
+	return total;
+}
+
+static void * DeltaStepWorker_Run(void * argument) {
+	DeltaStepWorker * worker = (DeltaStepWorker *)argument;
+	DeltaStep * step = worker->step;
+	unsigned int index = worker->index;
+	DeltaStepThread * thread = step->threads + index;
+	// Wait until the caller knows how many threads started
+	ThreadBarrier_Wait(&step->barrier);
+	unsigned int n_nodes = step->graph->n_nodes;
+	unsigned int begin = (unsigned int)((unsigned long long)n_nodes * index / step->n_threads);
+	unsigned int end = (unsigned int)((unsigned long long)n_nodes * (index + 1) / step->n_threads);
+
+	unsigned int infinity = DeltaStep_Bits(INFINITY);
+	for (unsigned int i = begin; i < end; i++) {
+		step->labels[i] = (unsigned long long)(i == step->source ? 0 : infinity) << 32 | DIJKSTRA_NO_PARENT;
+		step->light_costs[i] = step->heavy_costs[i] = infinity;
+	}
+	ThreadBarrier_Wait(&step->barrier);
+
+	unsigned long long bucket = 0;
+	while (bucket != DELTASTEP_NO_BUCKET) {
+		// Light phase, until the bucket stays empty
+		do {
+			unsigned int first;
+			while ((first = __atomic_fetch_add(&step->next_claim, DELTASTEP_CHUNK, __ATOMIC_RELAXED)) < step->n_frontier) {
+				unsigned int last = first + DELTASTEP_CHUNK < step->n_frontier ? first + DELTASTEP_CHUNK : step->n_frontier;
+				for (unsigned int i = first; i < last; i++) DeltaStep_Expand(step, thread, step->frontier[i], 0, bucket);
+			}
+		} while (DeltaStep_Gather(step, index, bucket));
+
+		// Heavy phase
+		for (unsigned int i = 0; i < thread->expanded.n_nodes; i++) DeltaStep_Expand(step, thread, thread->expanded.nodes[i], 1, bucket + 1);
+		thread->expanded.n_nodes = 0;
+
+		// Next bucket
+		thread->next_bucket = DELTASTEP_NO_BUCKET;
+		for (unsigned long long i = bucket + 1; i < bucket + step->n_buckets; i++) {
+			if (thread->buckets[i % step->n_buckets].n_nodes) {
+				thread->next_bucket = i;
+				break;
+			}
+		}
+		ThreadBarrier_Wait(&step->barrier);
+		bucket = DELTASTEP_NO_BUCKET;
+		for (unsigned int i = 0; i < step->n_threads; i++) {
+			if (step->threads[i].next_bucket < bucket) bucket = step->threads[i].next_bucket;
+		}
+		if (bucket != DELTASTEP_NO_BUCKET) DeltaStep_Gather(step, index, bucket);
+	}
+
+	for (unsigned int i = begin; i < end; i++) {
+		step->dist[i] = DeltaStep_Cost((unsigned int)(step->labels[i] >> 32));
+		if (step->parent) step->parent[i] = (unsigned int)step->labels[i];
+	}
+	return NULL;
+}
+
+/******************************************************************************
+ * Delta for graph: a multiple of the mean cost of a sample of its edges
+ */
+float DeltaStep_PickDelta(const Graph * const graph) {
+	if (graph->error || graph->n_edges == 0) return 1.0f;
+	unsigned int stride = graph->n_edges > DELTASTEP_SAMPLES ? graph->n_edges / DELTASTEP_SAMPLES : 1;
+	double total = 0;
+	unsigned int n_samples = 0;
+	for (unsigned int i = 0; i < graph->n_edges; i += stride) {
+		total += graph->edges[i].cost;
+		n_samples++;
+	}
+	float delta = (float)(total / n_samples) * DELTASTEP_MEAN_FACTOR;
+	// The ring of buckets must span the largest edge
+	if (delta < graph->max_cost / (DELTASTEP_MAX_BUCKETS - 3)) delta = graph->max_cost / (DELTASTEP_MAX_BUCKETS - 3);
+	return delta > 0 ? delta : 1.0f;
+}
+
+/******************************************************************************
+ * The shortest path tree from source, as Dijkstra_ShortestPathTree gives it
+ * without a cutoff, on n_threads threads (0 for one per processor) with
+ * buckets delta wide (0 to pick with DeltaStep_PickDelta). Returns
+ * DIJKSTRA_SUCCESS, the error of the graph, DIJKSTRA_ERROR_INVALID_START, or
+ * DIJKSTRA_ERROR_INVALID_OPTIONS if delta is negative or so small next to
+ * the largest edge cost that the ring of buckets would pass
+ * DELTASTEP_MAX_BUCKETS.
+ */
+int DeltaStep_ShortestPathTree(const Graph * const graph, const unsigned int source, const float delta,
+	const unsigned int n_threads, float * const dist, unsigned int * const parent) {
+	if (graph->error) return graph->error;
+	if (source >= graph->n_nodes) return DIJKSTRA_ERROR_INVALID_START;
+	float width = delta == 0 ? DeltaStep_PickDelta(graph) : delta;
+	if (!(width > 0) || graph->max_cost / width > DELTASTEP_MAX_BUCKETS - 3) return DIJKSTRA_ERROR_INVALID_OPTIONS;
+
+	DeltaStep step;
+	memset(&step, 0, sizeof(DeltaStep));
+	step.graph = graph;
+	step.source = source;
+	step.delta = width;
+	step.n_buckets = (unsigned int)(graph->max_cost / width) + 3;
+	step.labels = (unsigned long long *)malloc(graph->n_nodes * sizeof(unsigned long long));
+	step.light_costs = (unsigned int *)malloc(graph->n_nodes * sizeof(unsigned int));
+	step.heavy_costs = (unsigned int *)malloc(graph->n_nodes * sizeof(unsigned int));
+	step.frontier_capacity = 1024;
+	step.frontier = (unsigned int *)malloc(step.frontier_capacity * sizeof(unsigned int));
+	step.frontier[0] = source;
+	step.n_frontier = 1;
+	step.dist = dist;
+	step.parent = parent;
+
+	unsigned int n_wanted = n_threads ? n_threads : Thread_CountProcessors();
+	if (n_wanted > DELTASTEP_MAX_THREADS) n_wanted = DELTASTEP_MAX_THREADS;
+	if (n_wanted > graph->n_nodes) n_wanted = graph->n_nodes;
+	ThreadBarrier_Init(&step.barrier, n_wanted);
+
+	// The workers wait at the barrier until n_threads counts the ones that
+	// started, the calling thread being worker 0
+	DeltaStepWorker workers[DELTASTEP_MAX_THREADS];
+	step.n_threads = 1;
+	for (unsigned int i = 0; i < n_wanted; i++) {
+		workers[i].step = &step;
+		workers[i].index = i;
+		if (i > 0) {
+			if (!Thread_TryStart(&workers[i].thread, DeltaStepWorker_Run, workers + i)) break;
+			step.n_threads++;
+		}
+	}
+	for (unsigned int i = 0; i < step.n_threads; i++) {
+		step.threads[i].buckets = (DeltaStepList *)calloc(step.n_buckets, sizeof(DeltaStepList));
+	}
+	ThreadBarrier_SetCount(&step.barrier, step.n_threads);
+	DeltaStepWorker_Run(workers);
+	for (unsigned int i = 1; i < step.n_threads; i++) Thread_Join(&workers[i].thread);
+
+	ThreadBarrier_Destroy(&step.barrier);
+	for (unsigned int i = 0; i < step.n_threads; i++) {
+		for (unsigned int j = 0; j < step.n_buckets; j++) free(step.threads[i].buckets[j].nodes);
+		free(step.threads[i].buckets);
+		free(step.threads[i].expanded.nodes);
+	}
+	free(step.labels);
+	free(step.light_costs);
+	free(step.heavy_costs);
+	free(step.frontier);
+	return DIJKSTRA_SUCCESS;
+}
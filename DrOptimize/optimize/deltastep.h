@@ -0,0 +1,24 @@
+/******************************************************************************
+ * Header file for parallel delta-stepping.
+ */
+
+#pragma once
+
+#include "dijkstra.h"
+
+/******************************************************************************
+ * Delta-stepping settles nodes a bucket at a time instead of one at a time:
+ * bucket i holds the nodes whose tentative cost is in [i * delta,
+ * (i + 1) * delta), and all of them are expanded at once, on every thread.
+ * Edges no longer than delta, the light ones, can lead back into the same
+ * bucket, so it is expanded along them until it stays empty. The heavy edges
+ * of everything it held are then relaxed once, since they can only lead to
+ * later buckets.
+ *
+ * A small delta makes it Dijkstra, with a bucket per node and little
+ * parallelism; a large one makes it Bellman-Ford, relaxing edges many times
+ * over. A delta of 0 picks one from the edge costs.
+ */
+int DeltaStep_ShortestPathTree(const Graph * const graph, const unsigned int source, const float delta,
+	const unsigned int n_threads, float * const dist, unsigned int * const parent);
+float DeltaStep_PickDelta(const Graph * const graph);
@@ -8,7 +8,11 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "bucketqueue.h"
 #include "dijkstra.h"
+#include "lazyheap.h"
+#include "radixheap.h"
+#include "thread.h"
 
 Node Node_Init(const unsigned int id) {
 	Node node;
@@ -30,6 +34,87 @@ int int_compare(int left, int right) {
 	return left - right;
 }
 
+DijkstraOptions DijkstraOptions_Init(void) {
+	DijkstraOptions options;
+	options.queue = DIJKSTRA_QUEUE_HEAP;
+	// One metre when costs are in kilometres
+	options.quantization_step = 0.001f;
+	options.trace = NULL;
+	options.bidirectional = 0;
+	options.astar = 0;
+	return options;
+}
+
+/******************************************************************************
+ * Traces
+ */
+DijkstraTrace DijkstraTrace_New(void) {
+	DijkstraTrace trace;
+	memset(&trace, 0, sizeof(DijkstraTrace));
+	return trace;
+}
+
+void DijkstraTrace_Free(DijkstraTrace * const trace) {
+	free(trace->entries);
+	memset(trace, 0, sizeof(DijkstraTrace));
+}
+
+static void DijkstraTrace_Append(DijkstraTrace * const trace, const DijkstraTraceOp op, const unsigned int id, const float priority) {
+	if (trace->n_entries == trace->capacity) {
+		trace->capacity = trace->capacity ? trace->capacity * 2 : 1024;
+		trace->entries = (DijkstraTraceEntry *)realloc(trace->entries, trace->capacity * sizeof(DijkstraTraceEntry));
+	}
+	DijkstraTraceEntry * entry = trace->entries + trace->n_entries++;
+	entry->op = op;
+	entry->id = id;
+	entry->priority = priority;
+}
+
+static const char DIJKSTRA_TRACE_CODES[] = "idp";
+
+/******************************************************************************
+ * Traces are text: a "dijkstra-trace <n_keys> <n_entries>" header, then one
+ * "<i|d|p> <id> <priority>" line per operation. Both functions return 0 on
+ * success and -1 if the file cannot be opened or parsed.
+ */
+int DijkstraTrace_Write(const DijkstraTrace * const trace, const char * path) {
+	FILE * file = fopen(path, "w");
+	if (!file) return -1;
+	fprintf(file, "dijkstra-trace %u %u\n", trace->n_keys, trace->n_entries);
+	for (unsigned int i = 0; i < trace->n_entries; i++) {
+		const DijkstraTraceEntry * entry = trace->entries + i;
+		fprintf(file, "%c %u %.9g\n", DIJKSTRA_TRACE_CODES[entry->op], entry->id, entry->priority);
+	}
+	fclose(file);
+	return 0;
+}
+
+int DijkstraTrace_Read(DijkstraTrace * const trace, const char * path) {
+	FILE * file = fopen(path, "r");
+	if (!file) return -1;
+	unsigned int n_entries;
+	*trace = DijkstraTrace_New();
+	if (fscanf(file, "dijkstra-trace %u %u", &trace->n_keys, &n_entries) != 2) {
+		fclose(file);
+		return -1;
+	}
+	for (unsigned int i = 0; i < n_entries; i++) {
+		char code;
+		unsigned int id;
+		float priority;
+		const char * op;
+		if (fscanf(file, " %c %u %f", &code, &id, &priority) != 3
+			|| !(op = strchr(DIJKSTRA_TRACE_CODES, code)) || !*op || id >= trace->n_keys) {
+			DijkstraTrace_Free(trace);
+			fclose(file);
+			return -1;
+		}
+		DijkstraTrace_Append(trace, (DijkstraTraceOp)(op - DIJKSTRA_TRACE_CODES), id, priority);
+	}
+	fclose(file);
+	return 0;
+}
+
 Connection Connection_Init(const unsigned int start, const unsigned int end, const float cost) {
 	Connection con;
 	con.start = start;
@@ -38,16 +123,6 @@ Connection Connection_Init(const unsigned int start, const unsigned int end, con
 	return con;
 }
 
-static int Connection_Sort(const void * left, const void * right) {
-	Connection * n1 = (Connection *)left;
-	Connection * n2 = (Connection *)right;
-	int start_comp = (signed int)n1->start - (signed int)n2->start;
-	if (start_comp == 0) {
-		return (signed int)n1->end - (signed int)n2->end;
-	}
-	return start_comp;
-}
-
 Connection * Connection_TwoWay(const Connection * const connections, const unsigned int n_connections) {
 	Connection * output = (Connection *)malloc(n_connections * 2 * sizeof(Connection));
 	memcpy(output, connections, n_connections * sizeof(Connection));
@@ -64,6 +139,169 @@ static void FreePQNode(Pair * pair) {
 	return;
 }
 
+/******************************************************************************
+ * Search queue. Puts the queue selected in DijkstraOptions behind the one
+ * interface the relaxation loop needs.
+ */
+typedef struct DijkstraQueue {
+	DijkstraQueueType type;
+	PriorityQueue heap;
+	RadixHeap radix;
+	BucketQueue bucket;
+	LazyHeap lazy;
+	DijkstraTrace * trace;
+} DijkstraQueue;
+
+// An entry is stale once its node is settled or reached more cheaply
+static int DijkstraQueue_IsStale(const void * context, const unsigned int id, const float priority) {
+	const Node * node = (const Node *)context + id;
+	return node->visited || priority > node->min_cost_from_start;
+}
+
+// n_keys bounds the node ids; max_qcost is the largest quantized edge cost,
+// used by the bucket queue only
+static DijkstraQueue DijkstraQueue_New(const DijkstraQueueType type, const Node * const nodes,
+	const unsigned int n_keys, const unsigned int max_qcost) {
+	DijkstraQueue queue;
+	memset(&queue, 0, sizeof(DijkstraQueue));
+	queue.type = type;
+	switch (queue.type) {
+	case DIJKSTRA_QUEUE_RADIX:
+		queue.radix = RadixHeap_New(n_keys);
+		break;
+	case DIJKSTRA_QUEUE_BUCKET:
+		queue.bucket = BucketQueue_New(n_keys, max_qcost);
+		break;
+	case DIJKSTRA_QUEUE_LAZY:
+		queue.lazy = LazyHeap_New(DijkstraQueue_IsStale, nodes);
+		break;
+	default:
+		// Every node is implicitly at INFINITY until it is first reached
+		queue.heap = PriorityQueue_NewDense(float_compare, FreePQNode, n_keys, PQ_DEFAULT_ARITY);
+		PriorityQueue_BuildImplicit(&queue.heap, INFINITY, NULL, 0);
+		break;
+	}
+	return queue;
+}
+
+// Empties the queue of whatever an earlier query left in it, in time
+// proportional to that, and starts the trace of a query on n_nodes nodes
+static void DijkstraQueue_Begin(DijkstraQueue * const queue, DijkstraTrace * const trace, const unsigned int n_nodes) {
+	switch (queue->type) {
+	case DIJKSTRA_QUEUE_RADIX:
+		RadixHeap_Clear(&queue->radix);
+		break;
+	case DIJKSTRA_QUEUE_BUCKET:
+		BucketQueue_Clear(&queue->bucket);
+		break;
+	case DIJKSTRA_QUEUE_LAZY:
+		LazyHeap_Clear(&queue->lazy);
+		break;
+	default:
+		PriorityQueue_Clear(&queue->heap);
+		break;
+	}
+	queue->trace = trace;
+	if (trace) {
+		trace->n_entries = 0;
+		trace->n_keys = n_nodes;
+	}
+}
+
+static void DijkstraQueue_Free(DijkstraQueue * const queue) {
+	switch (queue->type) {
+	case DIJKSTRA_QUEUE_RADIX:
+		RadixHeap_Free(&queue->radix);
+		break;
+	case DIJKSTRA_QUEUE_BUCKET:
+		BucketQueue_Free(&queue->bucket);
+		break;
+	case DIJKSTRA_QUEUE_LAZY:
+		LazyHeap_Free(&queue->lazy);
+		break;
+	default:
+		PriorityQueue_Free(&queue->heap);
+		break;
+	}
+}
+
+// Queues id, or lowers its priority if queued is set
+static void DijkstraQueue_Update(DijkstraQueue * const queue, const unsigned int id, const float priority, const int queued) {
+	if (queue->trace) DijkstraTrace_Append(queue->trace, queued ? DIJKSTRA_TRACE_DECREASE : DIJKSTRA_TRACE_PUSH, id, priority);
+	switch (queue->type) {
+	case DIJKSTRA_QUEUE_RADIX:
+		if (queued) RadixHeap_Decrease(&queue->radix, id, priority);
+		else RadixHeap_Push(&queue->radix, id, priority);
+		break;
+	case DIJKSTRA_QUEUE_LAZY:
+		if (queued) LazyHeap_Decrease(&queue->lazy, id, priority);
+		else LazyHeap_Push(&queue->lazy, id, priority);
+		break;
+	default:
+		PriorityQueue_SetPriority(&queue->heap, (Data_t)id, priority);
+		break;
+	}
+}
+
+// The bucket queue's counterpart of DijkstraQueue_Update
+static void DijkstraQueue_UpdateQuantized(DijkstraQueue * const queue, const unsigned int id, const unsigned long long qpriority, const int queued) {
+	if (queue->trace) DijkstraTrace_Append(queue->trace, queued ? DIJKSTRA_TRACE_DECREASE : DIJKSTRA_TRACE_PUSH, id, (float)qpriority);
+	if (queued) BucketQueue_Decrease(&queue->bucket, id, qpriority);
+	else BucketQueue_Push(&queue->bucket, id, qpriority);
+}
+
+// Returns 0 once the queue is empty. The bucket queue gives its quantized
+// priority.
+static int DijkstraQueue_PopMin(DijkstraQueue * const queue, unsigned int * const out_id, float * const out_priority) {
+	int popped;
+	switch (queue->type) {
+	case DIJKSTRA_QUEUE_RADIX:
+		popped = RadixHeap_PopMin(&queue->radix, out_id, out_priority) == PQ_SUCCESS;
+		break;
+	case DIJKSTRA_QUEUE_BUCKET: {
+		unsigned long long qpriority;
+		popped = BucketQueue_PopMin(&queue->bucket, out_id, &qpriority) == PQ_SUCCESS;
+		if (popped) *out_priority = (float)qpriority;
+		break;
+	}
+	case DIJKSTRA_QUEUE_LAZY:
+		popped = LazyHeap_PopMin(&queue->lazy, out_id, out_priority) == PQ_SUCCESS;
+		break;
+	default: {
+		Data_t data;
+		popped = PriorityQueue_PopMin(&queue->heap, &data, out_priority) == PQ_SUCCESS;
+		if (popped) *out_id = (unsigned int)data;
+		break;
+	}
+	}
+	if (popped && queue->trace) DijkstraTrace_Append(queue->trace, DIJKSTRA_TRACE_POP, *out_id, *out_priority);
+	return popped;
+}
+
+static unsigned int DijkstraQueue_Size(const DijkstraQueue * const queue) {
+	switch (queue->type) {
+	case DIJKSTRA_QUEUE_RADIX: return queue->radix.n_data;
+	case DIJKSTRA_QUEUE_BUCKET: return queue->bucket.n_data;
+	case DIJKSTRA_QUEUE_LAZY: return queue->lazy.n_entries;
+	default: return queue->heap.n_data;
+	}
+}
+
+// Edges whose A* estimates are worked out together
+#define DIJKSTRA_ESTIMATE_BATCH 64
+
+static DijkstraOutput DijkstraOutput_Init(void) {
+	DijkstraOutput output;
+	output.error = DIJKSTRA_SUCCESS;
+	output.n_elements = 0;
+	output.path = NULL;
+	output.total_cost = INFINITY;
+	output.max_rounding_error = 0;
+	output.n_stale_pops = 0;
+	output.n_settled = 0;
+	return output;
+}
+
 /******************************************************************************
  * Use Dijkstra's Shortest Path Algorithm to find the shortest path through a
  * network defined as a list of connections, each with a cost.
@@ -78,118 +316,364 @@ static void FreePQNode(Pair * pair) {
  *	 -	This algorithm checks for connectivity of all nodes within the network,
  *		starting at start. If end is not included in the set of nodes connected
  *		to start, an error will be thrown.
+ *	 -	With the bucket queue, an error will be thrown if quantization_step is
+ *		not positive or rounds some cost above DIJKSTRA_MAX_QUANTIZED_COST.
+ *	 -	The connections are turned into a Graph for this one query. To answer
+ *		many queries on the same network, build it once with Graph_Build and
+ *		use Dijkstra_Query.
  */
 DijkstraOutput Dijkstra_ShortestPath(const Connection * const connections, const unsigned int n_connections,
 	const unsigned int start, const unsigned int end) {
+	DijkstraOptions options = DijkstraOptions_Init();
+	return Dijkstra_ShortestPathWithOptions(connections, n_connections, start, end, &options);
+}
 
-	DijkstraOutput output;
-	output.error = DIJKSTRA_SUCCESS;
-	output.n_elements = 0;
-	output.path = NULL;
-	output.total_cost = INFINITY;
+DijkstraOutput Dijkstra_ShortestPathWithOptions(const Connection * const connections, const unsigned int n_connections,
+	const unsigned int start, const unsigned int end, const DijkstraOptions * const options) {
+	// One query gains nothing from threads, nor from the reverse graph unless
+	// it searches backward
+	Graph graph = Graph_BuildParallel(connections, n_connections, 1, options->bidirectional);
+	DijkstraOutput output = Dijkstra_QueryWithOptions(&graph, start, end, options);
+	Graph_Free(&graph);
+	return output;
+}
 
-	// Check that there are 1 or more connections
-	if (n_connections == 0) {
-		output.error = DIJKSTRA_ERROR_NO_CONNECTIONS;
-		return output;
+/******************************************************************************
+ * Shortest path from start to end on a prebuilt Graph, with the same errors
+ * and options as Dijkstra_ShortestPath. The graph is only read, so queries on
+ * one Graph may run concurrently.
+ */
+DijkstraOutput Dijkstra_Query(const Graph * const graph, const unsigned int start, const unsigned int end) {
+	DijkstraOptions options = DijkstraOptions_Init();
+	return Dijkstra_QueryWithOptions(graph, start, end, &options);
+}
+
+DijkstraOutput Dijkstra_QueryWithOptions(const Graph * const graph, const unsigned int start, const unsigned int end,
+	const DijkstraOptions * const options) {
+	DijkstraWorkspace workspace = DijkstraWorkspace_New();
+	DijkstraOutput output = Dijkstra_QueryWithWorkspace(&workspace, graph, start, end, options);
+	DijkstraWorkspace_Free(&workspace);
+	return output;
+}
+
+/******************************************************************************
+ * Workspaces
+ */
+DijkstraWorkspace DijkstraWorkspace_New(void) {
+	DijkstraWorkspace workspace;
+	memset(&workspace, 0, sizeof(DijkstraWorkspace));
+	return workspace;
+}
+
+static void DijkstraWorkspace_FreeQueue(DijkstraWorkspace * const workspace) {
+	if (!workspace->queue) return;
+	DijkstraQueue_Free(workspace->queue);
+	free(workspace->queue);
+	workspace->queue = NULL;
+}
+
+void DijkstraWorkspace_Free(DijkstraWorkspace * const workspace) {
+	if (workspace->backward) {
+		DijkstraWorkspace_Free(workspace->backward);
+		free(workspace->backward);
 	}
+	DijkstraWorkspace_FreeQueue(workspace);
+	free(workspace->nodes);
+	free(workspace->qdist);
+	free(workspace->stamps);
+	memset(workspace, 0, sizeof(DijkstraWorkspace));
+}
 
-	// Find the maximum node id
-	unsigned int max_id = 0;
-	for (unsigned int i = 0; i < n_connections; i++) {
-		if (connections[i].start > max_id) max_id = connections[i].start;
-		if (connections[i].end > max_id) max_id = connections[i].end;
+size_t DijkstraWorkspace_Allocation(const DijkstraWorkspace * const workspace) {
+	size_t size = sizeof(DijkstraWorkspace) + workspace->capacity * (sizeof(Node) + sizeof(unsigned int));
+	if (workspace->qdist) size += workspace->capacity * sizeof(unsigned long long);
+	if (workspace->queue) {
+		const DijkstraQueue * queue = workspace->queue;
+		size += sizeof(DijkstraQueue);
+		switch (queue->type) {
+		case DIJKSTRA_QUEUE_RADIX: size += RadixHeap_Allocation(&queue->radix); break;
+		case DIJKSTRA_QUEUE_BUCKET: size += BucketQueue_Allocation(&queue->bucket); break;
+		case DIJKSTRA_QUEUE_LAZY: size += LazyHeap_Allocation(&queue->lazy); break;
+		default: size += PriorityQueue_Allocation(&queue->heap); break;
+		}
+	}
+	if (workspace->backward) size += DijkstraWorkspace_Allocation(workspace->backward);
+	return size;
+}
+
+// Makes room for n_nodes nodes and a queue of the requested type, keeping
+// whatever an earlier query already set up, and moves to a new epoch
+static void DijkstraWorkspace_Prepare(DijkstraWorkspace * const workspace, const unsigned int n_nodes,
+	const DijkstraOptions * const options, const unsigned int max_qcost) {
+	int quantized = options->queue == DIJKSTRA_QUEUE_BUCKET;
+	if (n_nodes > workspace->capacity) {
+		// The lazy queue points at the node array, and the other queues are
+		// sized by it, so the queue goes with it
+		DijkstraWorkspace_FreeQueue(workspace);
+		free(workspace->nodes);
+		free(workspace->qdist);
+		free(workspace->stamps);
+		workspace->nodes = (Node *)malloc(n_nodes * sizeof(Node));
+		workspace->qdist = NULL;
+		workspace->stamps = (unsigned int *)calloc(n_nodes, sizeof(unsigned int));
+		workspace->epoch = 0;
+		workspace->capacity = n_nodes;
+	}
+	if (quantized && !workspace->qdist) {
+		workspace->qdist = (unsigned long long *)malloc(workspace->capacity * sizeof(unsigned long long));
+	}
+
+	// A bucket queue with more buckets than needed still works
+	DijkstraQueue * queue = workspace->queue;
+	if (queue && (queue->type != options->queue || (quantized && queue->bucket.n_buckets <= max_qcost))) {
+		DijkstraWorkspace_FreeQueue(workspace);
+	}
+	if (!workspace->queue) {
+		workspace->queue = (DijkstraQueue *)malloc(sizeof(DijkstraQueue));
+		*workspace->queue = DijkstraQueue_New(options->queue, workspace->nodes, workspace->capacity, max_qcost);
+	}
+	DijkstraQueue_Begin(workspace->queue, options->trace, n_nodes);
+
+	// Stamps only need clearing when the epoch wraps around
+	if (++workspace->epoch == 0) {
+		memset(workspace->stamps, 0, workspace->capacity * sizeof(unsigned int));
+		workspace->epoch = 1;
+	}
+}
 
-		// There should not be negative costs
-		if (connections[i].cost < 0) {
-			output.error = DIJKSTRA_ERROR_NEGATIVE_COSTS;
-			return output;
+// The node record of id, reset if this query has not reached it yet
+static inline Node * DijkstraWorkspace_Node(DijkstraWorkspace * const workspace, const unsigned int id) {
+	if (workspace->stamps[id] != workspace->epoch) {
+		workspace->stamps[id] = workspace->epoch;
+		workspace->nodes[id] = Node_Init(id);
+		if (workspace->qdist) workspace->qdist[id] = BUCKET_NO_PRIORITY;
+	}
+	return workspace->nodes + id;
+}
+
+/******************************************************************************
+ * Bidirectional search: Dijkstra forward from start on the graph and backward
+ * from end on the reverse graph, each step taken by the direction with the
+ * smaller queue. mu is the cost of the best path seen to join the two
+ * searches, found when relaxing an edge into a node the other direction has
+ * reached. Once the keys popped last in the two directions add up to mu, no
+ * path through unsettled nodes can be shorter, and the path is stitched
+ * together at the node where it joined.
+ */
+static DijkstraOutput Dijkstra_Bidirectional(DijkstraWorkspace * const workspace, const Graph * const graph,
+	const unsigned int start, const unsigned int end, const DijkstraOptions * const options) {
+	DijkstraOutput output = DijkstraOutput_Init();
+	if (!workspace->backward) {
+		workspace->backward = (DijkstraWorkspace *)malloc(sizeof(DijkstraWorkspace));
+		*workspace->backward = DijkstraWorkspace_New();
+	}
+
+	// Neither queue is traced, since they interleave
+	DijkstraOptions untraced = *options;
+	untraced.trace = NULL;
+	DijkstraWorkspace * sides[2] = { workspace, workspace->backward };
+	const unsigned int * offsets[2] = { graph->offsets, graph->reverse_offsets };
+	const GraphEdge * edges[2] = { graph->edges, graph->reverse_edges };
+	unsigned int n_stale_pops[2];
+	float last[2] = { 0, 0 };
+	for (int side = 0; side < 2; side++) {
+		DijkstraWorkspace_Prepare(sides[side], graph->n_nodes, &untraced, 0);
+		n_stale_pops[side] = sides[side]->queue->lazy.n_stale_pops;
+		unsigned int root = side ? end : start;
+		DijkstraWorkspace_Node(sides[side], root)->min_cost_from_start = 0;
+		DijkstraQueue_Update(sides[side]->queue, root, 0.0f, 0);
+	}
+
+	float mu = start == end ? 0 : INFINITY;
+	unsigned int meeting = start;
+	while (mu > 0) {
+		int side = DijkstraQueue_Size(sides[1]->queue) < DijkstraQueue_Size(sides[0]->queue);
+		DijkstraWorkspace * here = sides[side];
+		DijkstraWorkspace * there = sides[!side];
+		unsigned int current_index;
+		if (!DijkstraQueue_PopMin(here->queue, &current_index, last + side)) break;
+		if (last[0] + last[1] >= mu) break;
+
+		Node * current = here->nodes + current_index;
+		output.n_settled++;
+		for (unsigned int i = offsets[side][current_index]; i < offsets[side][current_index + 1]; i++) {
+			Node * dest = DijkstraWorkspace_Node(here, edges[side][i].node);
+			float cost = current->min_cost_from_start + edges[side][i].cost;
+			if (dest->visited || cost >= dest->min_cost_from_start) continue;
+			int queued = dest->min_cost_from_start != INFINITY;
+			dest->min_cost_from_start = cost;
+			dest->best_id = current->id;
+			DijkstraQueue_Update(here->queue, dest->id, cost, queued);
+
+			// Does this join a path from the other side?
+			const Node * other = DijkstraWorkspace_Node(there, dest->id);
+			if (cost + other->min_cost_from_start < mu) {
+				mu = cost + other->min_cost_from_start;
+				meeting = dest->id;
+			}
+		}
+		current->visited = 1;
+	}
+	for (int side = 0; side < 2; side++) {
+		if (sides[side]->queue->type == DIJKSTRA_QUEUE_LAZY) {
+			output.n_stale_pops += sides[side]->queue->lazy.n_stale_pops - n_stale_pops[side];
 		}
 	}
-	unsigned int n_nodes = max_id + 1;
 
-	if (start > max_id) {
-		output.error = DIJKSTRA_ERROR_INVALID_START;
+	if (mu == INFINITY) {
+		output.error = DIJKSTRA_ERROR_START_AND_END_NOT_CONNECTED;
 		return output;
 	}
-	else if (end > max_id) {
-		output.error = DIJKSTRA_ERROR_INVALID_END;
+
+	// Count the nodes back to start and on to end
+	const Node * forward = workspace->nodes;
+	const Node * backward = workspace->backward->nodes;
+	unsigned int n_elements = 1;
+	for (unsigned int current = meeting; current != start; current = forward[current].best_id) n_elements++;
+	for (unsigned int current = meeting; current != end; current = backward[current].best_id) n_elements++;
+
+	output.path = (unsigned int *)malloc(n_elements * sizeof(unsigned int));
+	unsigned int i = 0;
+	for (unsigned int current = meeting; current != start; current = forward[current].best_id) {
+		output.path[i++] = current;
+	}
+	output.path[i++] = start;
+	for (unsigned int j = 0; j < i / 2; j++) {
+		unsigned int swap = output.path[j];
+		output.path[j] = output.path[i - 1 - j];
+		output.path[i - 1 - j] = swap;
+	}
+
+	// Sum the costs on from the meeting point in path order, so the total is
+	// rounded as a forward search would round it
+	output.total_cost = forward[meeting].min_cost_from_start;
+	for (unsigned int current = meeting; current != end; current = backward[current].best_id) {
+		unsigned int next = backward[current].best_id;
+		float cost = INFINITY;
+		for (unsigned int e = graph->offsets[current]; e < graph->offsets[current + 1]; e++) {
+			if (graph->edges[e].node == next && graph->edges[e].cost < cost) cost = graph->edges[e].cost;
+		}
+		output.total_cost += cost;
+		output.path[i++] = next;
+	}
+	output.n_elements = n_elements;
+	return output;
+}
+
+/******************************************************************************
+ * Dijkstra_QueryWithOptions on a workspace reused from earlier queries, which
+ * saves allocating and initializing a record for every node of the graph.
+ * The workspace can move between graphs of any size.
+ *
+ * With options->bidirectional set the graph must have its reverse graph and
+ * the queue must not be the bucket queue, or DIJKSTRA_ERROR_INVALID_OPTIONS
+ * is returned. Bidirectional queries are not traced.
+ *
+ * With options->astar set the graph must have coordinates (see
+ * Graph_SetCoordinates) or landmarks (see Graph_SelectLandmarks), the queue
+ * must be DIJKSTRA_QUEUE_HEAP and the query one-way. The path is shortest as long as the estimates are lower bounds.
+ */
+DijkstraOutput Dijkstra_QueryWithWorkspace(DijkstraWorkspace * const workspace, const Graph * const graph,
+	const unsigned int start, const unsigned int end, const DijkstraOptions * const options) {
+
+	DijkstraOutput output = DijkstraOutput_Init();
+	if (graph->error) {
+		output.error = graph->error;
 		return output;
 	}
+	unsigned int n_nodes = graph->n_nodes;
 
-	// Allocate nodes
-	Node * nodes = (Node *)malloc(n_nodes * sizeof(Node));
-	memset(nodes, 0, n_nodes * sizeof(Node));
-	for (unsigned int i = 0; i < n_connections; i++) {
-		nodes[connections[i].start] = Node_Init(connections[i].start);
-		nodes[connections[i].end] = Node_Init(connections[i].end);
+	// The bucket queue needs every quantized cost to fit its bucket count
+	int quantized = options->queue == DIJKSTRA_QUEUE_BUCKET;
+	float step = options->quantization_step;
+	if (quantized && (!(step > 0) || graph->max_cost / step > DIJKSTRA_MAX_QUANTIZED_COST)) {
+		output.error = DIJKSTRA_ERROR_INVALID_OPTIONS;
+		return output;
 	}
 
-	// Check that all nodes exist
-	for (unsigned int i = 0; i < n_nodes; i++) {
-		if (nodes[i].status != 1) {
-			output.error = DIJKSTRA_ERROR_MISSING_NODE_IDS;
-			return output;
-		}
+	// Searching backward takes the reverse graph, and exact distances
+	if (options->bidirectional && (quantized || !graph->reverse_offsets)) {
+		output.error = DIJKSTRA_ERROR_INVALID_OPTIONS;
+		return output;
 	}
 
-	// Sort connections by start then end
-	Connection * sorted_cons = (Connection *)malloc(n_connections * sizeof(Connection));
-	memcpy(sorted_cons, connections, n_connections * sizeof(Connection));
-	qsort(sorted_cons, n_connections, sizeof(Connection), Connection_Sort);
+	// A* takes coordinates or landmarks, and the heap queue. Its keys are not distances,
+	// which the lazy queue's staleness test relies on, and rounding can take
+	// them below the last key popped, which the monotone queues reject.
+	if (options->astar && (options->queue != DIJKSTRA_QUEUE_HEAP || options->bidirectional || (!graph->point_x && !graph->landmarks))) {
+		output.error = DIJKSTRA_ERROR_INVALID_OPTIONS;
+		return output;
+	}
 
-	// Get index to first item for each start
-	unsigned int * offset = (unsigned int *)malloc((n_nodes + 1) * sizeof(unsigned int));
-	memset(offset, 0, (n_nodes + 1) * sizeof(unsigned int));
-	int counter = 0;
-	for (unsigned int i = 0; i < n_nodes; i++) {
-		while (sorted_cons[counter].start < i) {
-			counter++;
-		}
-		offset[i] = counter;
+	if (start >= n_nodes) {
+		output.error = DIJKSTRA_ERROR_INVALID_START;
+		return output;
+	}
+	else if (end >= n_nodes) {
+		output.error = DIJKSTRA_ERROR_INVALID_END;
+		return output;
 	}
-	offset[0] = 0;
-	offset[n_nodes] = n_connections;
+	if (options->bidirectional) return Dijkstra_Bidirectional(workspace, graph, start, end, options);
 
-	// Create node queue using binary selection
-	PriorityQueue queue = PriorityQueue_New(int_compare, float_compare, FreePQNode);
-	int interval = 1 << (32 - __builtin_clz(n_nodes - 1));
-	while (interval > 1) {
-		for (int i = (interval >> 1) - 1; i < n_nodes; i += interval) {
-			PriorityQueue_Insert(&queue, i, INFINITY);
-		}
-		interval >>= 1;
+	// Round costs to whole steps for the bucket queue. Nodes then carry both
+	// the quantized distance that orders the search and the exact cost of the
+	// path that reached it.
+	unsigned int max_qcost = quantized ? (unsigned int)(graph->max_cost / step + 0.5f) : 0;
+	DijkstraWorkspace_Prepare(workspace, n_nodes, options, max_qcost);
+	Node * nodes = workspace->nodes;
+	unsigned long long * qdist = workspace->qdist;
+	DijkstraQueue * queue = workspace->queue;
+	unsigned int n_stale_pops = queue->lazy.n_stale_pops;
+
+	// Create node queue holding only the start
+	DijkstraWorkspace_Node(workspace, start)->min_cost_from_start = 0;
+	if (quantized) {
+		qdist[start] = 0;
+		DijkstraQueue_UpdateQuantized(queue, start, 0, 0);
 	}
-	PriorityQueue_SetPriority(&queue, start, 0.0f);
-	nodes[start].min_cost_from_start = 0;
+	else DijkstraQueue_Update(queue, start, 0.0f, 0);
+
+	// A* orders the queue by distance plus the estimate of the cost on to end,
+	// which is worked out for a batch of edges at a time
+	int astar = options->astar;
+	float estimates[DIJKSTRA_ESTIMATE_BATCH];
 
 	// Iterate through nodes in the queue
-	while (queue.n_data) {
+	unsigned int current_index;
+	float priority;
+	while (DijkstraQueue_PopMin(queue, &current_index, &priority)) {
 		// Get closest node to start that is unexplored
-		int current_index;
-		float priority;
-		PriorityQueue_PopMin(&queue, &current_index, &priority);
 		Node * current = nodes + current_index;
-
-		// If priority > INFINITY, there are no more nodes connected to start's
-		// network, and the end can never be reached
-		if (priority == INFINITY) {
-			output.error = DIJKSTRA_ERROR_START_AND_END_NOT_CONNECTED;
-			return output;
-		}
+		output.n_settled++;
 
 		// Iterate through each child that has not been visited yet
-		unsigned int first_connection = offset[current->id];
-		unsigned int last_connection = offset[current->id + 1];
+		unsigned int first_connection = graph->offsets[current->id];
+		unsigned int last_connection = graph->offsets[current->id + 1];
 		for (unsigned int i = first_connection; i < last_connection; i++) {
-			Connection * con = sorted_cons + i;
-			Node * dest = nodes + con->end;
+			unsigned int batch_index = (i - first_connection) % DIJKSTRA_ESTIMATE_BATCH;
+			if (astar && batch_index == 0) {
+				unsigned int n = last_connection - i < DIJKSTRA_ESTIMATE_BATCH ? last_connection - i : DIJKSTRA_ESTIMATE_BATCH;
+				Graph_Estimates(graph, graph->edges + i, n, end, estimates);
+			}
+			Node * dest = DijkstraWorkspace_Node(workspace, graph->edges[i].node);
+			float cost = graph->edges[i].cost;
 			if (!dest->visited) {
-				if (current->min_cost_from_start + con->cost < dest->min_cost_from_start) {
-					
-					dest->min_cost_from_start = current->min_cost_from_start + con->cost;
+				if (quantized) {
+					unsigned long long candidate = qdist[current->id] + (unsigned int)(cost / step + 0.5f);
+					if (candidate < qdist[dest->id]) {
+						int queued = qdist[dest->id] != BUCKET_NO_PRIORITY;
+						qdist[dest->id] = candidate;
+						dest->min_cost_from_start = current->min_cost_from_start + cost;
+						dest->best_id = current->id;
+						DijkstraQueue_UpdateQuantized(queue, dest->id, candidate, queued);
+					}
+				}
+				else if (current->min_cost_from_start + cost < dest->min_cost_from_start) {
+					int queued = dest->min_cost_from_start != INFINITY;
+					dest->min_cost_from_start = current->min_cost_from_start + cost;
 					dest->best_id = current->id;
-					PriorityQueue_SetPriority(&queue, dest->id, dest->min_cost_from_start);
+					float key = astar ? dest->min_cost_from_start + estimates[batch_index] : dest->min_cost_from_start;
+					DijkstraQueue_Update(queue, dest->id, key, queued);
 				}
 			}
 		}
@@ -198,6 +682,14 @@ DijkstraOutput Dijkstra_ShortestPath(const Connection * const connections, const
 
 		if (current->id == end) break;
 	}
+	if (queue->type == DIJKSTRA_QUEUE_LAZY) output.n_stale_pops = queue->lazy.n_stale_pops - n_stale_pops;
+
+	// If the queue ran dry first, there are no more nodes connected to
+	// start's network, and the end can never be reached
+	if (!DijkstraWorkspace_Node(workspace, end)->visited) {
+		output.error = DIJKSTRA_ERROR_START_AND_END_NOT_CONNECTED;
+		return output;
+	}
 
 	// Generate tree
 	unsigned int n_elements = 1;
@@ -219,10 +711,180 @@ DijkstraOutput Dijkstra_ShortestPath(const Connection * const connections, const
 	output.path[0] = start;
 	output.n_elements = n_elements;
 
-	// Free memory
-	free(nodes);
-	free(sorted_cons);
-	free(offset);
-	
+	// The path found is no longer than a shortest path P in rounded costs,
+	// and each edge of either was rounded by at most half a step. P is not
+	// known, only that it is simple, so it is taken to have n_nodes - 1 edges.
+	if (quantized) output.max_rounding_error = (float)((n_elements - 1 + (double)(n_nodes - 1)) * step * 0.5);
+
 	return output;
-}
\ No newline at end of file
+}
+
+/******************************************************************************
+ * Shortest path trees
+ */
+
+/******************************************************************************
+ * Fills dist with the cost of the shortest path from source to every node of
+ * graph, and parent, unless it is NULL, with the node before each on its
+ * path. Both are caller-owned arrays of graph->n_nodes entries. Nodes that
+ * cost more than cutoff to reach (pass INFINITY for no cutoff), or that
+ * cannot be reached at all, are left at INFINITY with parent
+ * DIJKSTRA_NO_PARENT, as is the parent of source. The search settles only
+ * nodes within the cutoff, on a radix heap like the distance tables. Returns
+ * DIJKSTRA_SUCCESS, the error of the graph, or DIJKSTRA_ERROR_INVALID_START.
+ */
+int Dijkstra_ShortestPathTree(const Graph * const graph, const unsigned int source, const float cutoff,
+	float * const dist, unsigned int * const parent) {
+	if (graph->error) return graph->error;
+	if (source >= graph->n_nodes) return DIJKSTRA_ERROR_INVALID_START;
+	for (unsigned int i = 0; i < graph->n_nodes; i++) dist[i] = INFINITY;
+	if (parent) memset(parent, 0xff, graph->n_nodes * sizeof(unsigned int));
+	if (!(cutoff >= 0)) return DIJKSTRA_SUCCESS;
+
+	// Costs never rise once set, so a node is queued exactly when its cost is
+	// finite and it has not been popped, and popped nodes are never lowered
+	RadixHeap queue = RadixHeap_New(graph->n_nodes);
+	dist[source] = 0;
+	RadixHeap_Push(&queue, source, 0);
+	unsigned int node;
+	float cost;
+	while (RadixHeap_PopMin(&queue, &node, &cost) == PQ_SUCCESS) {
+		for (unsigned int i = graph->offsets[node]; i < graph->offsets[node + 1]; i++) {
+			unsigned int next = graph->edges[i].node;
+			float next_cost = cost + graph->edges[i].cost;
+			if (next_cost < dist[next] && next_cost <= cutoff) {
+				if (dist[next] == INFINITY) RadixHeap_Push(&queue, next, next_cost);
+				else RadixHeap_Decrease(&queue, next, next_cost);
+				dist[next] = next_cost;
+				if (parent) parent[next] = node;
+			}
+		}
+	}
+	RadixHeap_Free(&queue);
+	return DIJKSTRA_SUCCESS;
+}
+
+/******************************************************************************
+ * Distance tables
+ */
+#define DIJKSTRA_MAX_THREADS 64
+
+typedef struct DijkstraTable {
+	const Graph * graph;
+	const unsigned int * sources;
+	unsigned int n_sources;
+	const unsigned int * targets;
+	unsigned int n_targets;
+	// Whether each node is a target, and how many distinct targets there are
+	unsigned char * is_target;
+	unsigned int n_distinct;
+	float * out;
+	// Next source to claim
+	unsigned int next_source;
+} DijkstraTable;
+
+// Fills the row of source, searching only until every target is settled
+static void DijkstraTable_Row(const DijkstraTable * const table, DijkstraWorkspace * const workspace,
+	const unsigned int source, float * const row) {
+	const Graph * graph = table->graph;
+	// Rows search most of the graph, where the radix heap runs about twice as
+	// fast as the dense heap
+	DijkstraOptions options = DijkstraOptions_Init();
+	options.queue = DIJKSTRA_QUEUE_RADIX;
+	DijkstraWorkspace_Prepare(workspace, graph->n_nodes, &options, 0);
+	Node * nodes = workspace->nodes;
+	DijkstraQueue * queue = workspace->queue;
+	DijkstraWorkspace_Node(workspace, source)->min_cost_from_start = 0;
+	DijkstraQueue_Update(queue, source, 0.0f, 0);
+
+	unsigned int n_remaining = table->n_distinct;
+	unsigned int current_index;
+	float priority;
+	while (n_remaining && DijkstraQueue_PopMin(queue, &current_index, &priority)) {
+		Node * current = nodes + current_index;
+		current->visited = 1;
+		n_remaining -= table->is_target[current_index];
+		if (!n_remaining) break;
+		for (unsigned int i = graph->offsets[current_index]; i < graph->offsets[current_index + 1]; i++) {
+			Node * dest = DijkstraWorkspace_Node(workspace, graph->edges[i].node);
+			float cost = current->min_cost_from_start + graph->edges[i].cost;
+			if (!dest->visited && cost < dest->min_cost_from_start) {
+				int queued = dest->min_cost_from_start != INFINITY;
+				dest->min_cost_from_start = cost;
+				dest->best_id = current_index;
+				DijkstraQueue_Update(queue, dest->id, cost, queued);
+			}
+		}
+	}
+
+	for (unsigned int j = 0; j < table->n_targets; j++) {
+		const Node * target = DijkstraWorkspace_Node(workspace, table->targets[j]);
+		row[j] = target->visited ? target->min_cost_from_start : INFINITY;
+	}
+}
+
+// Claims sources one at a time, so that threads stay busy however much the
+// searches differ in size
+static void * DijkstraTable_Run(void * argument) {
+	DijkstraTable * table = (DijkstraTable *)argument;
+	DijkstraWorkspace workspace = DijkstraWorkspace_New();
+	unsigned int i;
+	while ((i = __atomic_fetch_add(&table->next_source, 1, __ATOMIC_RELAXED)) < table->n_sources) {
+		DijkstraTable_Row(table, &workspace, table->sources[i], table->out + (size_t)i * table->n_targets);
+	}
+	DijkstraWorkspace_Free(&workspace);
+	return NULL;
+}
+
+/******************************************************************************
+ * Fills out, n_sources rows of n_targets floats, with the cost of the shortest
+ * path from each source to each target, INFINITY where there is none. Each
+ * source is one search that stops once it has settled every target, and the
+ * sources are spread over n_threads threads (0 for one per processor), each
+ * with its own workspace. Returns DIJKSTRA_SUCCESS, the error of the graph,
+ * or DIJKSTRA_ERROR_INVALID_START or DIJKSTRA_ERROR_INVALID_END if a source
+ * or target is not a node, in which case out is left alone.
+ */
+int Dijkstra_DistanceTable(const Graph * const graph, const unsigned int * const sources, const unsigned int n_sources,
+	const unsigned int * const targets, const unsigned int n_targets, float * const out) {
+	return Dijkstra_DistanceTableParallel(graph, sources, n_sources, targets, n_targets, out, 0);
+}
+
+int Dijkstra_DistanceTableParallel(const Graph * const graph, const unsigned int * const sources, const unsigned int n_sources,
+	const unsigned int * const targets, const unsigned int n_targets, float * const out, const unsigned int n_threads) {
+	if (graph->error) return graph->error;
+	for (unsigned int i = 0; i < n_sources; i++) {
+		if (sources[i] >= graph->n_nodes) return DIJKSTRA_ERROR_INVALID_START;
+	}
+	for (unsigned int j = 0; j < n_targets; j++) {
+		if (targets[j] >= graph->n_nodes) return DIJKSTRA_ERROR_INVALID_END;
+	}
+	if (n_sources == 0 || n_targets == 0) return DIJKSTRA_SUCCESS;
+
+	DijkstraTable table;
+	table.graph = graph;
+	table.sources = sources;
+	table.n_sources = n_sources;
+	table.targets = targets;
+	table.n_targets = n_targets;
+	table.is_target = (unsigned char *)calloc(graph->n_nodes, 1);
+	table.n_distinct = 0;
+	for (unsigned int j = 0; j < n_targets; j++) {
+		table.n_distinct += !table.is_target[targets[j]];
+		table.is_target[targets[j]] = 1;
+	}
+	table.out = out;
+	table.next_source = 0;
+
+	unsigned int n_workers = n_threads;
+	if (n_workers == 0) n_workers = Thread_CountProcessors();
+	if (n_workers > DIJKSTRA_MAX_THREADS) n_workers = DIJKSTRA_MAX_THREADS;
+	if (n_workers > n_sources) n_workers = n_sources;
+	Thread threads[DIJKSTRA_MAX_THREADS];
+	for (unsigned int i = 1; i < n_workers; i++) Thread_Start(threads + i, DijkstraTable_Run, &table);
+	DijkstraTable_Run(&table);
+	for (unsigned int i = 1; i < n_workers; i++) Thread_Join(threads + i);
+
+	free(table.is_target);
+	return DIJKSTRA_SUCCESS;
+}
@@ -26,18 +26,192 @@ typedef struct Connection {
 #define DIJKSTRA_ERROR_INVALID_START -4
 #define DIJKSTRA_ERROR_INVALID_END -5
 #define DIJKSTRA_ERROR_START_AND_END_NOT_CONNECTED -6
+#define DIJKSTRA_ERROR_INVALID_OPTIONS -7
+
+// Parent of the nodes a shortest path tree does not reach
+#define DIJKSTRA_NO_PARENT 0xffffffffu
+
+// Largest quantized edge cost, which sets the bucket queue's bucket count
+#define DIJKSTRA_MAX_QUANTIZED_COST (1u << 24)
+
+/******************************************************************************
+ * Queue used for the search frontier:
+ *	 -	DIJKSTRA_QUEUE_HEAP is a dense-key PriorityQueue heap.
+ *	 -	DIJKSTRA_QUEUE_RADIX is a monotone RadixHeap, which relies on Dijkstra
+ *		never pushing a distance below the last one popped.
+ *	 -	DIJKSTRA_QUEUE_BUCKET is Dial's BucketQueue. Edge costs are rounded to
+ *		whole multiples of quantization_step and the search runs on those; the
+ *		path returned is shortest for the rounded costs. Rounded distances
+ *		are 64-bit, so only the largest edge limits how small the step can be.
+ *	 -	DIJKSTRA_QUEUE_LAZY is a LazyHeap: relaxation pushes duplicates and
+ *		entries for visited nodes or beaten distances are skipped on pop.
+ */
+typedef enum DijkstraQueueType {
+	DIJKSTRA_QUEUE_HEAP,
+	DIJKSTRA_QUEUE_RADIX,
+	DIJKSTRA_QUEUE_BUCKET,
+	DIJKSTRA_QUEUE_LAZY
+} DijkstraQueueType;
+
+/******************************************************************************
+ * A trace records every operation the search makes on its queue, so that the
+ * queue backends can be benchmarked on real access patterns (see pqbench.c).
+ * Decreases are updates of a node that is already queued. Priorities are the
+ * ones the queue saw, which for the bucket queue are quantized distances.
+ */
+typedef enum DijkstraTraceOp {
+	DIJKSTRA_TRACE_PUSH,
+	DIJKSTRA_TRACE_DECREASE,
+	DIJKSTRA_TRACE_POP
+} DijkstraTraceOp;
+
+typedef struct DijkstraTraceEntry {
+	DijkstraTraceOp op;
+	unsigned int id;
+	float priority;
+} DijkstraTraceEntry;
+
+typedef struct DijkstraTrace {
+	DijkstraTraceEntry * entries;
+	unsigned int n_entries;
+	unsigned int capacity;
+	unsigned int n_keys;
+} DijkstraTrace;
+
+typedef struct DijkstraOptions {
+	DijkstraQueueType queue;
+	float quantization_step;
+	// If set, replaced with the trace of the next query
+	DijkstraTrace * trace;
+	// Search from both ends at once; see Dijkstra_QueryWithWorkspace
+	int bidirectional;
+	// Order the search by distance plus the estimate to end (A*)
+	int astar;
+} DijkstraOptions;
 
 typedef struct DijkstraOutput {
 	unsigned int * path;
 	unsigned int n_elements;
 	float total_cost;
+	// Bound on how far total_cost can be above the cost of a true shortest
+	// path, for a search on quantized costs: half a step for every edge of
+	// the path found and of a shortest path. The shortest path is not known,
+	// so it is counted as n_nodes - 1 edges long, which makes this a worst
+	// case for the whole graph rather than for the path found: it grows with
+	// the graph, to about 100 km at a 1 m step on 200k nodes. 0 unless costs
+	// were quantized.
+	float max_rounding_error;
+	// Stale entries the lazy queue discarded; 0 for other queues
+	unsigned int n_stale_pops;
+	// Nodes popped and expanded, in both directions together
+	unsigned int n_settled;
 	unsigned int error;
 } DijkstraOutput;
 
+/******************************************************************************
+ * A network in compressed sparse row form (graph.c). The connections leaving
+ * node i are edges[offsets[i]] up to edges[offsets[i + 1]], each holding the
+ * node it leads to. If the reverse graph was built, the connections arriving
+ * at node i are likewise in reverse_edges, each holding the node it comes
+ * from; otherwise reverse_offsets and reverse_edges are NULL. Every list keeps
+ * the order of the connections it was built from.
+ *
+ * Build it once with Graph_Build and run any number of Dijkstra_Query calls
+ * against it. error is DIJKSTRA_SUCCESS, or the reason the connections were
+ * rejected. point_x, point_y and point_z are NULL unless Graph_SetCoordinates
+ * has placed the nodes for A* queries.
+ *
+ * Graph_SelectLandmarks gives A* bounds without coordinates (landmarks.c).
+ * landmark_from[i * n_landmarks + l] is the cost from landmarks[l] to node i
+ * and landmark_to the cost from node i to it, INFINITY where there is no
+ * path; all three are NULL until landmarks are selected or read.
+ */
+#define GRAPH_MAX_LANDMARKS 64
+
+typedef struct GraphEdge {
+	unsigned int node;
+	float cost;
+} GraphEdge;
+
+typedef struct Graph {
+	unsigned int * offsets;
+	GraphEdge * edges;
+	unsigned int * reverse_offsets;
+	GraphEdge * reverse_edges;
+	unsigned int n_nodes;
+	unsigned int n_edges;
+	double * point_x;
+	double * point_y;
+	double * point_z;
+	unsigned int n_landmarks;
+	unsigned int * landmarks;
+	float * landmark_from;
+	float * landmark_to;
+	float max_cost;
+	unsigned int error;
+} Graph;
+
+/******************************************************************************
+ * Per-query state kept alive between queries. The node records are only
+ * valid where stamps matches epoch; every query moves to a new epoch instead
+ * of resetting them, and the queue is emptied of just what the last query
+ * left in it, so a query costs time in proportion to the nodes it reaches
+ * rather than to the size of the graph. The arrays grow to the largest graph
+ * queried. A workspace serves one query at a time: give each thread its own.
+ */
+struct DijkstraQueue;
+
+typedef struct DijkstraWorkspace {
+	Node * nodes;
+	unsigned long long * qdist;
+	unsigned int * stamps;
+	unsigned int epoch;
+	unsigned int capacity;
+	struct DijkstraQueue * queue;
+	// State of the backward half of bidirectional queries
+	struct DijkstraWorkspace * backward;
+} DijkstraWorkspace;
+
 Node Node_Init(const unsigned int id);
 Connection Connection_Init(const unsigned int start, const unsigned int end, const float cost);
+DijkstraOptions DijkstraOptions_Init(void);
+
+DijkstraTrace DijkstraTrace_New(void);
+void DijkstraTrace_Free(DijkstraTrace * const);
+int DijkstraTrace_Write(const DijkstraTrace * const, const char * path);
+int DijkstraTrace_Read(DijkstraTrace * const, const char * path);
 
 Connection * Connection_TwoWay(const Connection * const connections, const unsigned int n_connections);
 
+Graph Graph_Build(const Connection * const connections, const unsigned int n_connections);
+Graph Graph_BuildParallel(const Connection * const connections, const unsigned int n_connections,
+	const unsigned int n_threads, const int reverse);
+void Graph_SetCoordinates(Graph * const, const double * const lats, const double * const lons, const float cost_per_km);
+void Graph_Estimates(const Graph * const, const GraphEdge * const edges, const unsigned int n,
+	const unsigned int goal, float * const out);
+int Graph_SelectLandmarks(Graph * const, const unsigned int n_landmarks, const unsigned int n_threads);
+int Graph_WriteLandmarks(const Graph * const, const char * path);
+int Graph_ReadLandmarks(Graph * const, const char * path);
+void Graph_Free(Graph * const);
+size_t Graph_Allocation(const Graph * const);
+
+DijkstraWorkspace DijkstraWorkspace_New(void);
+void DijkstraWorkspace_Free(DijkstraWorkspace * const);
+size_t DijkstraWorkspace_Allocation(const DijkstraWorkspace * const);
+
 DijkstraOutput Dijkstra_ShortestPath(const Connection * const connections, const unsigned int n_connections,
-	const unsigned int start, const unsigned int end);
\ No newline at end of file
+	const unsigned int start, const unsigned int end);
+DijkstraOutput Dijkstra_ShortestPathWithOptions(const Connection * const connections, const unsigned int n_connections,
+	const unsigned int start, const unsigned int end, const DijkstraOptions * const options);
+DijkstraOutput Dijkstra_Query(const Graph * const graph, const unsigned int start, const unsigned int end);
+DijkstraOutput Dijkstra_QueryWithOptions(const Graph * const graph, const unsigned int start, const unsigned int end,
+	const DijkstraOptions * const options);
+DijkstraOutput Dijkstra_QueryWithWorkspace(DijkstraWorkspace * const workspace, const Graph * const graph,
+	const unsigned int start, const unsigned int end, const DijkstraOptions * const options);
+
+int Dijkstra_ShortestPathTree(const Graph * const graph, const unsigned int source, const float cutoff,
+	float * const dist, unsigned int * const parent);
+int Dijkstra_DistanceTable(const Graph * const graph, const unsigned int * const sources, const unsigned int n_sources,
+	const unsigned int * const targets, const unsigned int n_targets, float * const out);
+int Dijkstra_DistanceTableParallel(const Graph * const graph, const unsigned int * const sources, const unsigned int n_sources,
+	const unsigned int * const targets, const unsigned int n_targets, float * const out, const unsigned int n_threads);
\ No newline at end of file
@@ -2,9 +2,14 @@
  * Testing module for the Dijkstra path-finding algorithm
  */
 
+#include <math.h>
 #include <stdio.h>
+#include <string.h>
 
+#include "ch.h"
+#include "deltastep.h"
 #include "dijkstra.h"
+#include "hubs.h"
 
 int main() {
 	/*
@@ -46,6 +51,290 @@ int main() {
 	}
 	printf("}]\n");
 
+	// The radix heap must find a path of the same cost
+	DijkstraOptions options = DijkstraOptions_Init();
+	options.queue = DIJKSTRA_QUEUE_RADIX;
+	DijkstraOutput radix = Dijkstra_ShortestPathWithOptions(twoway, 36, 0, 5, &options);
+	printf("Radix heap path %s\n", radix.total_cost == data.total_cost ? "matches" : "differs");
+	free(radix.path);
+
+	// So must the bucket queue, whose costs are whole multiples of the step
+	options.queue = DIJKSTRA_QUEUE_BUCKET;
+	options.quantization_step = 0.5f;
+	DijkstraOutput bucket = Dijkstra_ShortestPathWithOptions(twoway, 36, 0, 5, &options);
+	printf("Bucket queue path %s, rounding error at most %.2f\n",
+		bucket.total_cost == data.total_cost ? "matches" : "differs", bucket.max_rounding_error);
+	free(bucket.path);
+
+	// And the lazy queue, which skips the entries its duplicates superseded
+	options.queue = DIJKSTRA_QUEUE_LAZY;
+	DijkstraOutput lazy = Dijkstra_ShortestPathWithOptions(twoway, 36, 0, 5, &options);
+	printf("Lazy queue path %s, %u stale pops\n", lazy.total_cost == data.total_cost ? "matches" : "differs", lazy.n_stale_pops);
+	free(lazy.path);
+
+	// A captured trace survives a round trip through a file
+	DijkstraTrace trace = DijkstraTrace_New();
+	options = DijkstraOptions_Init();
+	options.trace = &trace;
+	DijkstraOutput traced = Dijkstra_ShortestPathWithOptions(twoway, 36, 0, 5, &options);
+	DijkstraTrace reread;
+	int trace_matches = DijkstraTrace_Write(&trace, "dijkstra.trace") == 0 && DijkstraTrace_Read(&reread, "dijkstra.trace") == 0;
+	if (trace_matches) {
+		trace_matches = reread.n_entries == trace.n_entries && reread.n_keys == trace.n_keys;
+		for (unsigned int i = 0; trace_matches && i < trace.n_entries; i++) {
+			trace_matches = reread.entries[i].op == trace.entries[i].op && reread.entries[i].id == trace.entries[i].id
+				&& reread.entries[i].priority == trace.entries[i].priority;
+		}
+		DijkstraTrace_Free(&reread);
+	}
+	printf("Trace of %u operations %s\n", trace.n_entries, trace_matches ? "round trips" : "differs");
+	remove("dijkstra.trace");
+	DijkstraTrace_Free(&trace);
+	free(traced.path);
+
+	// Queries on a prebuilt Graph agree with building it per query
+	Graph graph = Graph_Build(twoway, 36);
+	int graph_matches = 1;
+	for (unsigned int end = 0; end < graph.n_nodes; end++) {
+		DijkstraOutput queried = Dijkstra_Query(&graph, 0, end);
+		DijkstraOutput direct = Dijkstra_ShortestPath(twoway, 36, 0, end);
+		if (queried.error != direct.error || queried.total_cost != direct.total_cost) graph_matches = 0;
+		free(queried.path);
+		free(direct.path);
+	}
+	printf("Graph queries %s (%u nodes, %u edges)\n", graph_matches ? "match" : "differ", graph.n_nodes, graph.n_edges);
+
+	// So do queries sharing one workspace, whatever queue each one uses
+	DijkstraWorkspace workspace = DijkstraWorkspace_New();
+	int workspace_matches = 1;
+	for (unsigned int end = 0; end < 4 * graph.n_nodes; end++) {
+		options = DijkstraOptions_Init();
+		options.queue = (DijkstraQueueType)(end / graph.n_nodes);
+		options.quantization_step = 0.5f;
+		DijkstraOutput reused = Dijkstra_QueryWithWorkspace(&workspace, &graph, end % graph.n_nodes, 12 - end % graph.n_nodes, &options);
+		DijkstraOutput fresh = Dijkstra_QueryWithOptions(&graph, end % graph.n_nodes, 12 - end % graph.n_nodes, &options);
+		if (reused.error != fresh.error || reused.total_cost != fresh.total_cost || reused.n_elements != fresh.n_elements) workspace_matches = 0;
+		free(reused.path);
+		free(fresh.path);
+	}
+	printf("Workspace queries %s\n", workspace_matches ? "match" : "differ");
+
+	// Searching from both ends finds paths of the same cost
+	int bidirectional_matches = 1;
+	unsigned int n_settled[2] = { 0, 0 };
+	for (unsigned int pair = 0; pair < graph.n_nodes * graph.n_nodes; pair++) {
+		options = DijkstraOptions_Init();
+		DijkstraOutput one_way = Dijkstra_QueryWithWorkspace(&workspace, &graph, pair / graph.n_nodes, pair % graph.n_nodes, &options);
+		options.bidirectional = 1;
+		DijkstraOutput two_way = Dijkstra_QueryWithWorkspace(&workspace, &graph, pair / graph.n_nodes, pair % graph.n_nodes, &options);
+		if (one_way.error != two_way.error || one_way.total_cost != two_way.total_cost || (!two_way.error
+			&& (two_way.path[0] != pair / graph.n_nodes || two_way.path[two_way.n_elements - 1] != pair % graph.n_nodes))) {
+			bidirectional_matches = 0;
+		}
+		n_settled[0] += one_way.n_settled;
+		n_settled[1] += two_way.n_settled;
+		free(one_way.path);
+		free(two_way.path);
+	}
+	printf("Bidirectional queries %s, %u nodes settled against %u\n", bidirectional_matches ? "match" : "differ", n_settled[1], n_settled[0]);
+
+	// A distance table holds the cost of each query from a source to a
+	// target, whichever thread worked out its row
+	unsigned int table_nodes[13];
+	float table[13 * 13];
+	for (unsigned int i = 0; i < 13; i++) table_nodes[i] = 12 - i;
+	int table_matches = Dijkstra_DistanceTableParallel(&graph, table_nodes, 13, table_nodes, 13, table, 3) == DIJKSTRA_SUCCESS;
+	for (unsigned int pair = 0; pair < 13 * 13; pair++) {
+		options = DijkstraOptions_Init();
+		DijkstraOutput queried = Dijkstra_QueryWithWorkspace(&workspace, &graph, table_nodes[pair / 13], table_nodes[pair % 13], &options);
+		if (queried.total_cost != table[pair]) table_matches = 0;
+		free(queried.path);
+	}
+	printf("Distance table %s\n", table_matches ? "matches" : "differs");
+
+	// The shortest path tree from node 0 holds the cost of every query from
+	// it, and a parent that cost less by an edge, up to the cutoff
+	float dist[13];
+	unsigned int parent[13];
+	int tree_matches = Dijkstra_ShortestPathTree(&graph, 0, 9.0f, dist, parent) == DIJKSTRA_SUCCESS;
+	for (unsigned int node = 0; node < 13; node++) {
+		DijkstraOutput queried = Dijkstra_Query(&graph, 0, node);
+		if (queried.total_cost > 9.0f) tree_matches = tree_matches && dist[node] == INFINITY && parent[node] == DIJKSTRA_NO_PARENT;
+		else if (node == 0) tree_matches = tree_matches && dist[node] == 0 && parent[node] == DIJKSTRA_NO_PARENT;
+		else {
+			int edge_found = 0;
+			for (unsigned int i = graph.offsets[parent[node]]; i < graph.offsets[parent[node] + 1]; i++) {
+				edge_found = edge_found || (graph.edges[i].node == node && dist[parent[node]] + graph.edges[i].cost == dist[node]);
+			}
+			tree_matches = tree_matches && dist[node] == queried.total_cost && edge_found;
+		}
+		free(queried.path);
+	}
+	printf("Shortest path tree %s\n", tree_matches ? "matches" : "differs");
+
+	// Delta-stepping gives the same tree without a cutoff, for narrow buckets
+	// and for buckets picked from the edge costs
+	float step_dist[13];
+	unsigned int step_parent[13];
+	int step_matches = Dijkstra_ShortestPathTree(&graph, 0, INFINITY, dist, parent) == DIJKSTRA_SUCCESS;
+	for (unsigned int trial = 0; trial < 2; trial++) {
+		float delta = trial ? 0 : 1.0f;
+		step_matches = step_matches && DeltaStep_ShortestPathTree(&graph, 0, delta, 3, step_dist, step_parent) == DIJKSTRA_SUCCESS;
+		for (unsigned int node = 0; node < 13; node++) {
+			if (step_dist[node] != dist[node]) step_matches = 0;
+			else if (dist[node] == INFINITY || node == 0) step_matches = step_matches && step_parent[node] == DIJKSTRA_NO_PARENT;
+			else {
+				int edge_found = 0;
+				for (unsigned int i = graph.offsets[step_parent[node]]; i < graph.offsets[step_parent[node] + 1]; i++) {
+					edge_found = edge_found || (graph.edges[i].node == node && step_dist[step_parent[node]] + graph.edges[i].cost == dist[node]);
+				}
+				step_matches = step_matches && edge_found;
+			}
+		}
+	}
+	printf("Delta-stepping tree %s\n", step_matches ? "matches" : "differs");
+
+	// A* on a 20 by 20 grid of streets 0.01 degrees apart near the equator,
+	// each block 1.2 km long
+	Connection streets[2 * 20 * 19];
+	double lats[20 * 20], lons[20 * 20];
+	unsigned int n_streets = 0;
+	for (unsigned int node = 0; node < 20 * 20; node++) {
+		lats[node] = 0.01 * (node / 20);
+		lons[node] = 0.01 * (node % 20);
+		if (node % 20 < 19) streets[n_streets++] = Connection_Init(node, node + 1, 1.2f);
+		if (node / 20 < 19) streets[n_streets++] = Connection_Init(node, node + 20, 1.2f);
+	}
+	Connection * twoway_streets = Connection_TwoWay(streets, n_streets);
+	Graph grid = Graph_Build(twoway_streets, 2 * n_streets);
+	Graph_SetCoordinates(&grid, lats, lons, 1.0f);
+	int astar_matches = 1;
+	n_settled[0] = n_settled[1] = 0;
+	for (unsigned int start = 0; start < grid.n_nodes; start++) {
+		options = DijkstraOptions_Init();
+		DijkstraOutput plain = Dijkstra_QueryWithWorkspace(&workspace, &grid, start, grid.n_nodes - 1 - start, &options);
+		options.astar = 1;
+		DijkstraOutput directed = Dijkstra_QueryWithWorkspace(&workspace, &grid, start, grid.n_nodes - 1 - start, &options);
+		if (plain.error != directed.error || plain.total_cost != directed.total_cost) astar_matches = 0;
+		n_settled[0] += plain.n_settled;
+		n_settled[1] += directed.n_settled;
+		free(plain.path);
+		free(directed.path);
+	}
+	printf("A* queries %s, %u nodes settled against %u\n", astar_matches ? "match" : "differ", n_settled[1], n_settled[0]);
+
+	// So does A* on the same grid without coordinates, going by landmarks
+	// that have been through a file
+	Graph unplaced = Graph_Build(twoway_streets, 2 * n_streets);
+	int landmarks_match = Graph_SelectLandmarks(&unplaced, 4, 2) == DIJKSTRA_SUCCESS
+		&& Graph_WriteLandmarks(&unplaced, "dijkstra.landmarks") == 0 && Graph_ReadLandmarks(&unplaced, "dijkstra.landmarks") == 0;
+	remove("dijkstra.landmarks");
+	n_settled[0] = n_settled[1] = 0;
+	for (unsigned int start = 0; landmarks_match && start < unplaced.n_nodes; start++) {
+		options = DijkstraOptions_Init();
+		DijkstraOutput plain = Dijkstra_QueryWithWorkspace(&workspace, &unplaced, start, (start * 37) % unplaced.n_nodes, &options);
+		options.astar = 1;
+		DijkstraOutput directed = Dijkstra_QueryWithWorkspace(&workspace, &unplaced, start, (start * 37) % unplaced.n_nodes, &options);
+		landmarks_match = plain.error == directed.error && plain.total_cost == directed.total_cost;
+		n_settled[0] += plain.n_settled;
+		n_settled[1] += directed.n_settled;
+		free(plain.path);
+		free(directed.path);
+	}
+	printf("Landmark queries %s, %u nodes settled against %u\n", landmarks_match ? "match" : "differ", n_settled[1], n_settled[0]);
+	Graph_Free(&unplaced);
+
+	// Contraction hierarchy queries agree with Dijkstra, before and after a
+	// round trip through a file
+	Hierarchy hierarchy = Hierarchy_Build(&grid, 2);
+	Hierarchy reloaded;
+	int hierarchy_matches = Hierarchy_Write(&hierarchy, "dijkstra.ch") == 0;
+	hierarchy_matches = Hierarchy_Read(&reloaded, "dijkstra.ch") == 0 && hierarchy_matches;
+	remove("dijkstra.ch");
+	HierarchyWorkspace hierarchy_workspace = HierarchyWorkspace_New();
+	options = DijkstraOptions_Init();
+	n_settled[0] = n_settled[1] = 0;
+	for (unsigned int pair = 0; hierarchy_matches && pair < grid.n_nodes * grid.n_nodes; pair += 7) {
+		unsigned int start = pair / grid.n_nodes, end = pair % grid.n_nodes;
+		DijkstraOutput plain = Dijkstra_QueryWithWorkspace(&workspace, &grid, start, end, &options);
+		DijkstraOutput contracted = Hierarchy_QueryWithWorkspace(&hierarchy_workspace, &reloaded, start, end);
+		hierarchy_matches = plain.total_cost == contracted.total_cost && contracted.path[0] == start
+			&& contracted.path[contracted.n_elements - 1] == end && contracted.n_elements == plain.n_elements;
+		n_settled[0] += plain.n_settled;
+		n_settled[1] += contracted.n_settled;
+		free(plain.path);
+		free(contracted.path);
+	}
+	printf("Hierarchy queries %s with %u shortcuts, %u nodes settled against %u\n", hierarchy_matches ? "match" : "differ",
+		hierarchy.n_shortcuts, n_settled[1], n_settled[0]);
+
+	// Hub labels in hierarchy order, through a file, and in degree order give
+	// the same distances, up to rounding in the order costs are added
+	HubLabels ordered = HubLabels_Build(&grid, &hierarchy, 1);
+	HubLabels by_degree = HubLabels_Build(&grid, NULL, 0);
+	HubLabels reread_labels;
+	int labels_match = HubLabels_Write(&ordered, "dijkstra.hubs") == 0;
+	labels_match = HubLabels_Read(&reread_labels, "dijkstra.hubs") == 0 && labels_match;
+	remove("dijkstra.hubs");
+	for (unsigned int pair = 0; labels_match && pair < grid.n_nodes * grid.n_nodes; pair += 7) {
+		unsigned int start = pair / grid.n_nodes, end = pair % grid.n_nodes;
+		DijkstraOutput plain = Dijkstra_QueryWithWorkspace(&workspace, &grid, start, end, &options);
+		DijkstraOutput labelled = HubLabels_Query(&reread_labels, start, end);
+		float tolerance = plain.total_cost * 1e-5f;
+		labels_match = fabsf(labelled.total_cost - plain.total_cost) <= tolerance
+			&& fabsf(HubLabels_Distance(&by_degree, start, end) - plain.total_cost) <= tolerance
+			&& labelled.n_elements == plain.n_elements && labelled.path[0] == start && labelled.path[labelled.n_elements - 1] == end;
+		// Consecutive nodes must be neighbours on the grid
+		for (unsigned int i = 1; labels_match && i < labelled.n_elements; i++) {
+			unsigned int a = labelled.path[i - 1], b = labelled.path[i];
+			labels_match = (a > b ? a - b : b - a) == 1 || (a > b ? a - b : b - a) == 20;
+		}
+		free(plain.path);
+		free(labelled.path);
+	}
+	printf("Hub label queries %s, %.1f entries per node in hierarchy order and %.1f in degree order\n",
+		labels_match ? "match" : "differ", (double)ordered.n_entries / grid.n_nodes, (double)by_degree.n_entries / grid.n_nodes);
+	HubLabels_Free(&reread_labels);
+	HubLabels_Free(&by_degree);
+	HubLabels_Free(&ordered);
+	HierarchyWorkspace_Free(&hierarchy_workspace);
+	Hierarchy_Free(&reloaded);
+	Hierarchy_Free(&hierarchy);
+	Graph_Free(&grid);
+	free(twoway_streets);
+	DijkstraWorkspace_Free(&workspace);
+
+	// Threads must not change the layout, and the reverse graph must hold
+	// every edge the other way round
+	Graph threaded = Graph_BuildParallel(twoway, 36, 4, 1);
+	int layout_matches = memcmp(graph.offsets, threaded.offsets, (graph.n_nodes + 1) * sizeof(unsigned int)) == 0
+		&& memcmp(graph.edges, threaded.edges, graph.n_edges * sizeof(GraphEdge)) == 0
+		&& memcmp(graph.reverse_edges, threaded.reverse_edges, graph.n_edges * sizeof(GraphEdge)) == 0;
+	unsigned int n_reversed = 0;
+	for (unsigned int node = 0; node < graph.n_nodes; node++) {
+		for (unsigned int i = graph.reverse_offsets[node]; i < graph.reverse_offsets[node + 1]; i++) {
+			unsigned int from = graph.reverse_edges[i].node;
+			for (unsigned int j = graph.offsets[from]; j < graph.offsets[from + 1]; j++) {
+				if (graph.edges[j].node == node && graph.edges[j].cost == graph.reverse_edges[i].cost) {
+					n_reversed++;
+					break;
+				}
+			}
+		}
+	}
+	printf("Threaded build %s, %u of %u edges reversed\n", layout_matches ? "matches" : "differs", n_reversed, graph.n_edges);
+	Graph_Free(&threaded);
+	Graph_Free(&graph);
+
+	// Nodes 2 and 3 are not connected to 0 and 1
+	Connection island[] = {
+		{0, 1, 1.0},
+		{1, 0, 1.0},
+		{2, 3, 1.0}
+	};
+	DijkstraOutput unreachable = Dijkstra_ShortestPath(island, 3, 0, 3);
+	printf("Unreachable end gives error %i\n", unreachable.error);
+
 	free(twoway);
 	free(data.path);
 
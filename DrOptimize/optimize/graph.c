@@ -0,0 +1,413 @@
+/******************************************************************************
+ * Compressed sparse row graph for repeated Dijkstra queries. Built once from
+ * a list of connections, then shared by every Dijkstra_Query against it.
+ *
+ * Construction is a two-level counting sort in O(V + E), split into phases
+ * that each run on n_threads threads without atomics:
+ *	 1.	Validate: find the largest id and cost and any negative cost.
+ *	 2.	Count: each thread histograms its share of the connections by block,
+ *		a power-of-two range of nodes, and marks the ids it sees.
+ *	 3.	Scatter: after a scan of the histograms, each thread copies its
+ *		connections into the region of their block.
+ *	 4.	Place: each block, now contiguous and small enough to stay in cache,
+ *		is counting-sorted by node into the final offsets and edges.
+ * The forward graph groups the connections by start and the reverse graph by
+ * end; both go through the same passes. Both sorts are stable, so each
+ * adjacency list keeps the order of the connections whatever the thread
+ * count.
+ */
+
+#include <math.h>
+#include <memory.h>
+#include <stdlib.h>
+
+#include "dijkstra.h"
+#include "thread.h"
+
+#define GRAPH_MAX_THREADS 64
+// Fewer edges per thread than this are not worth a thread
+#define GRAPH_MIN_EDGES_PER_THREAD (1u << 16)
+#define GRAPH_BLOCKS_PER_THREAD 8
+#define GRAPH_MAX_BLOCK_SHIFT 16
+
+// As in util.HaversineDist
+#define GRAPH_EARTH_RADIUS_KM 6371.0
+// Estimates are shrunk by this factor so that rounding cannot push them past
+// the float edge costs
+#define GRAPH_ESTIMATE_SLACK (1.0 - 1.0 / (1 << 20))
+
+// One direction of the graph under construction
+typedef struct GraphDirection {
+	int by_end;
+	// n_threads rows of n_blocks counts, scanned into write cursors
+	unsigned int * counts;
+	unsigned int * block_starts;
+	Connection * partitioned;
+	unsigned int * offsets;
+	GraphEdge * edges;
+} GraphDirection;
+
+typedef struct GraphBuild {
+	const Connection * connections;
+	unsigned int n_connections;
+	unsigned int n_nodes;
+	unsigned int n_threads;
+	unsigned int n_blocks;
+	unsigned int block_shift;
+	GraphDirection directions[2];
+	unsigned int n_directions;
+	unsigned char * seen;
+
+	// Results of the validation, per thread
+	unsigned int max_ids[GRAPH_MAX_THREADS];
+	float max_costs[GRAPH_MAX_THREADS];
+	int negative[GRAPH_MAX_THREADS];
+} GraphBuild;
+
+typedef void (*GraphPhase)(GraphBuild * const, const unsigned int thread);
+
+typedef struct GraphWorker {
+	Thread thread;
+	GraphBuild * build;
+	GraphPhase phase;
+	unsigned int index;
+} GraphWorker;
+
+static void * GraphWorker_Run(void * argument) {
+	GraphWorker * worker = (GraphWorker *)argument;
+	worker->phase(worker->build, worker->index);
+	return NULL;
+}
+
+// Runs phase on every thread, the calling thread being thread 0
+static void GraphBuild_Run(GraphBuild * const build, const GraphPhase phase) {
+	GraphWorker workers[GRAPH_MAX_THREADS];
+	for (unsigned int i = 1; i < build->n_threads; i++) {
+		workers[i].build = build;
+		workers[i].phase = phase;
+		workers[i].index = i;
+		Thread_Start(&workers[i].thread, GraphWorker_Run, workers + i);
+	}
+	phase(build, 0);
+	for (unsigned int i = 1; i < build->n_threads; i++) Thread_Join(&workers[i].thread);
+}
+
+// The share [*begin, *end) of the connections that belongs to thread
+static inline void GraphBuild_Share(const GraphBuild * const build, const unsigned int thread,
+	unsigned int * const begin, unsigned int * const end) {
+	*begin = (unsigned int)((unsigned long long)build->n_connections * thread / build->n_threads);
+	*end = (unsigned int)((unsigned long long)build->n_connections * (thread + 1) / build->n_threads);
+}
+
+static inline unsigned int GraphDirection_Key(const GraphDirection * const direction, const Connection * const con) {
+	return direction->by_end ? con->end : con->start;
+}
+
+/******************************************************************************
+ * Phases
+ */
+static void GraphBuild_Validate(GraphBuild * const build, const unsigned int thread) {
+	unsigned int begin, end;
+	GraphBuild_Share(build, thread, &begin, &end);
+	unsigned int max_id = 0;
+	float max_cost = 0;
+	int negative = 0;
+	for (unsigned int i = begin; i < end; i++) {
+		const Connection * con = build->connections + i;
+		if (con->start > max_id) max_id = con->start;
+		if (con->end > max_id) max_id = con->end;
+		if (con->cost < 0) negative = 1;
+		if (con->cost > max_cost) max_cost = con->cost;
+	}
+	build->max_ids[thread] = max_id;
+	build->max_costs[thread] = max_cost;
+	build->negative[thread] = negative;
+}
+
+static void GraphBuild_Count(GraphBuild * const build, const unsigned int thread) {
+	unsigned int begin, end;
+	GraphBuild_Share(build, thread, &begin, &end);
+	for (unsigned int i = begin; i < end; i++) {
+		const Connection * con = build->connections + i;
+		// Every thread only ever stores 1, so plain stores would do but for
+		// the letter of the memory model
+		__atomic_store_n(build->seen + con->start, 1, __ATOMIC_RELAXED);
+		__atomic_store_n(build->seen + con->end, 1, __ATOMIC_RELAXED);
+	}
+	for (unsigned int d = 0; d < build->n_directions; d++) {
+		GraphDirection * direction = build->directions + d;
+		unsigned int * counts = direction->counts + thread * build->n_blocks;
+		for (unsigned int i = begin; i < end; i++) {
+			counts[GraphDirection_Key(direction, build->connections + i) >> build->block_shift]++;
+		}
+	}
+}
+
+static void GraphBuild_Scatter(GraphBuild * const build, const unsigned int thread) {
+	unsigned int begin, end;
+	GraphBuild_Share(build, thread, &begin, &end);
+	for (unsigned int d = 0; d < build->n_directions; d++) {
+		GraphDirection * direction = build->directions + d;
+		unsigned int * cursors = direction->counts + thread * build->n_blocks;
+		for (unsigned int i = begin; i < end; i++) {
+			const Connection * con = build->connections + i;
+			direction->partitioned[cursors[GraphDirection_Key(direction, con) >> build->block_shift]++] = *con;
+		}
+	}
+}
+
+// Blocks are dealt out to the threads in turn
+static void GraphBuild_Place(GraphBuild * const build, const unsigned int thread) {
+	unsigned int block_size = 1u << build->block_shift;
+	unsigned int * cursors = (unsigned int *)malloc(block_size * sizeof(unsigned int));
+	for (unsigned int d = 0; d < build->n_directions; d++) {
+		GraphDirection * direction = build->directions + d;
+		for (unsigned int block = thread; block < build->n_blocks; block += build->n_threads) {
+			unsigned int first = block << build->block_shift;
+			unsigned int n_nodes = build->n_nodes - first < block_size ? build->n_nodes - first : block_size;
+			const Connection * cons = direction->partitioned + direction->block_starts[block];
+			unsigned int n_cons = direction->block_starts[block + 1] - direction->block_starts[block];
+
+			// Degrees, then the offsets and write cursor of each node
+			memset(cursors, 0, n_nodes * sizeof(unsigned int));
+			for (unsigned int i = 0; i < n_cons; i++) cursors[GraphDirection_Key(direction, cons + i) - first]++;
+			unsigned int position = direction->block_starts[block];
+			for (unsigned int i = 0; i < n_nodes; i++) {
+				unsigned int degree = cursors[i];
+				direction->offsets[first + i] = position;
+				cursors[i] = position;
+				position += degree;
+			}
+
+			for (unsigned int i = 0; i < n_cons; i++) {
+				GraphEdge * edge = direction->edges + cursors[GraphDirection_Key(direction, cons + i) - first]++;
+				edge->node = direction->by_end ? cons[i].start : cons[i].end;
+				edge->cost = cons[i].cost;
+			}
+		}
+	}
+	free(cursors);
+}
+
+/******************************************************************************
+ * Construction
+ */
+
+// Automatic counts stop short of threads with too little work
+static unsigned int Graph_ThreadCount(unsigned int n_threads, const unsigned int n_connections) {
+	if (n_threads == 0) {
+		unsigned int useful = n_connections / GRAPH_MIN_EDGES_PER_THREAD + 1;
+		n_threads = Thread_CountProcessors();
+		if (n_threads > useful) n_threads = useful;
+	}
+	if (n_threads > GRAPH_MAX_THREADS) n_threads = GRAPH_MAX_THREADS;
+	return n_threads;
+}
+
+// Turns the per-thread block histograms of a direction into write cursors:
+// block by block, and within a block thread by thread
+static void GraphDirection_Scan(GraphDirection * const direction, const GraphBuild * const build) {
+	unsigned int position = 0;
+	for (unsigned int block = 0; block < build->n_blocks; block++) {
+		direction->block_starts[block] = position;
+		for (unsigned int thread = 0; thread < build->n_threads; thread++) {
+			unsigned int * count = direction->counts + thread * build->n_blocks + block;
+			unsigned int n = *count;
+			*count = position;
+			position += n;
+		}
+	}
+	direction->block_starts[build->n_blocks] = position;
+}
+
+/******************************************************************************
+ * Validates the connections and lays them out as CSR arrays, using n_threads
+ * threads (0 for one per processor) and also building the reverse graph if
+ * reverse is set. On failure the Graph holds no arrays and error is one of
+ * DIJKSTRA_ERROR_NO_CONNECTIONS, DIJKSTRA_ERROR_NEGATIVE_COSTS or
+ * DIJKSTRA_ERROR_MISSING_NODE_IDS.
+ */
+Graph Graph_BuildParallel(const Connection * const connections, const unsigned int n_connections,
+	const unsigned int n_threads, const int reverse) {
+	Graph graph;
+	memset(&graph, 0, sizeof(Graph));
+
+	// Check that there are 1 or more connections
+	if (n_connections == 0) {
+		graph.error = DIJKSTRA_ERROR_NO_CONNECTIONS;
+		return graph;
+	}
+
+	GraphBuild build;
+	memset(&build, 0, sizeof(GraphBuild));
+	build.connections = connections;
+	build.n_connections = n_connections;
+	build.n_threads = Graph_ThreadCount(n_threads, n_connections);
+
+	// Find the maximum node id; there should not be negative costs
+	GraphBuild_Run(&build, GraphBuild_Validate);
+	unsigned int max_id = 0;
+	for (unsigned int i = 0; i < build.n_threads; i++) {
+		if (build.negative[i]) {
+			graph.error = DIJKSTRA_ERROR_NEGATIVE_COSTS;
+			return graph;
+		}
+		if (build.max_ids[i] > max_id) max_id = build.max_ids[i];
+		if (build.max_costs[i] > graph.max_cost) graph.max_cost = build.max_costs[i];
+	}
+	build.n_nodes = max_id + 1;
+
+	// Enough blocks to share out, each at most 2^GRAPH_MAX_BLOCK_SHIFT nodes
+	unsigned int target_blocks = build.n_threads * GRAPH_BLOCKS_PER_THREAD;
+	while (build.block_shift < GRAPH_MAX_BLOCK_SHIFT && (build.n_nodes >> build.block_shift) >= target_blocks) build.block_shift++;
+	build.n_blocks = ((build.n_nodes - 1) >> build.block_shift) + 1;
+
+	build.n_directions = reverse ? 2 : 1;
+	for (unsigned int d = 0; d < build.n_directions; d++) {
+		build.directions[d].by_end = d;
+		build.directions[d].counts = (unsigned int *)calloc(build.n_threads * build.n_blocks, sizeof(unsigned int));
+		build.directions[d].block_starts = (unsigned int *)malloc((build.n_blocks + 1) * sizeof(unsigned int));
+	}
+	build.seen = (unsigned char *)calloc(build.n_nodes, 1);
+	GraphBuild_Run(&build, GraphBuild_Count);
+
+	// Check that all nodes exist
+	int missing = 0;
+	for (unsigned int i = 0; i < build.n_nodes && !missing; i++) missing = !build.seen[i];
+	free(build.seen);
+
+	if (!missing) {
+		for (unsigned int d = 0; d < build.n_directions; d++) {
+			GraphDirection * direction = build.directions + d;
+			GraphDirection_Scan(direction, &build);
+			direction->partitioned = (Connection *)malloc(n_connections * sizeof(Connection));
+			direction->offsets = (unsigned int *)malloc((build.n_nodes + 1) * sizeof(unsigned int));
+			direction->offsets[build.n_nodes] = n_connections;
+			direction->edges = (GraphEdge *)malloc(n_connections * sizeof(GraphEdge));
+		}
+		GraphBuild_Run(&build, GraphBuild_Scatter);
+		GraphBuild_Run(&build, GraphBuild_Place);
+	}
+
+	for (unsigned int d = 0; d < build.n_directions; d++) {
+		free(build.directions[d].counts);
+		free(build.directions[d].block_starts);
+		free(build.directions[d].partitioned);
+	}
+	if (missing) {
+		graph.error = DIJKSTRA_ERROR_MISSING_NODE_IDS;
+		return graph;
+	}
+
+	graph.n_nodes = build.n_nodes;
+	graph.n_edges = n_connections;
+	graph.offsets = build.directions[0].offsets;
+	graph.edges = build.directions[0].edges;
+	if (reverse) {
+		graph.reverse_offsets = build.directions[1].offsets;
+		graph.reverse_edges = build.directions[1].edges;
+	}
+	return graph;
+}
+
+// Both directions, on one thread per processor
+Graph Graph_Build(const Connection * const connections, const unsigned int n_connections) {
+	return Graph_BuildParallel(connections, n_connections, 0, 1);
+}
+
+/******************************************************************************
+ * Coordinates
+ */
+
+/******************************************************************************
+ * Gives every node a position from its latitude and longitude in degrees, for
+ * A* queries. Nodes are stored as points in space scaled to the Earth's radius
+ * in cost units, so the estimate of the cost between two nodes is the length
+ * of the chord between them. That never exceeds the great-circle distance, so
+ * the estimate is a lower bound (and consistent) as long as every connection
+ * costs at least cost_per_km times the great-circle distance between its
+ * ends, which holds for lengths in kilometres summed along the road.
+ */
+void Graph_SetCoordinates(Graph * const graph, const double * const lats, const double * const lons, const float cost_per_km) {
+	if (graph->error) return;
+	if (!graph->point_x) {
+		graph->point_x = (double *)malloc(graph->n_nodes * sizeof(double));
+		graph->point_y = (double *)malloc(graph->n_nodes * sizeof(double));
+		graph->point_z = (double *)malloc(graph->n_nodes * sizeof(double));
+	}
+	double radius = GRAPH_EARTH_RADIUS_KM * cost_per_km * GRAPH_ESTIMATE_SLACK;
+	double to_radians = 0.017453292519943295;
+	for (unsigned int i = 0; i < graph->n_nodes; i++) {
+		double lat = lats[i] * to_radians;
+		double lon = lons[i] * to_radians;
+		graph->point_x[i] = radius * cos(lat) * cos(lon);
+		graph->point_y[i] = radius * cos(lat) * sin(lon);
+		graph->point_z[i] = radius * sin(lat);
+	}
+}
+
+// The chord between each node and goal
+static void Graph_ChordEstimates(const Graph * const graph, const GraphEdge * const edges, const unsigned int n,
+	const unsigned int goal, float * const out) {
+	const double * restrict xs = graph->point_x;
+	const double * restrict ys = graph->point_y;
+	const double * restrict zs = graph->point_z;
+	double goal_x = xs[goal], goal_y = ys[goal], goal_z = zs[goal];
+	for (unsigned int i = 0; i < n; i++) {
+		unsigned int node = edges[i].node;
+		double dx = xs[node] - goal_x;
+		double dy = ys[node] - goal_y;
+		double dz = zs[node] - goal_z;
+		out[i] = (float)sqrt(dx * dx + dy * dy + dz * dz);
+	}
+}
+
+// Writes a lower bound on the cost from the node of each of the n edges to
+// goal: the larger of the chord and the landmark bounds, whichever the graph
+// has. There are no branches on the nodes, so the loops vectorize.
+void Graph_Estimates(const Graph * const graph, const GraphEdge * const edges, const unsigned int n,
+	const unsigned int goal, float * const out) {
+	if (graph->point_x) Graph_ChordEstimates(graph, edges, n, goal, out);
+	else memset(out, 0, n * sizeof(float));
+	if (!graph->landmarks) return;
+
+	// Where a landmark reaches neither node or is reached by neither, the
+	// difference is NaN, which fmaxf passes over. The costs to the goal are
+	// shrunk so that rounding cannot push the bound past the true cost.
+	unsigned int k = graph->n_landmarks;
+	const float * goal_from = graph->landmark_from + (size_t)goal * k;
+	const float * goal_to = graph->landmark_to + (size_t)goal * k;
+	for (unsigned int i = 0; i < n; i++) {
+		const float * from = graph->landmark_from + (size_t)edges[i].node * k;
+		const float * to = graph->landmark_to + (size_t)edges[i].node * k;
+		float bound = out[i];
+		for (unsigned int l = 0; l < k; l++) {
+			bound = fmaxf(bound, goal_from[l] * (float)GRAPH_ESTIMATE_SLACK - from[l]);
+			bound = fmaxf(bound, to[l] * (float)GRAPH_ESTIMATE_SLACK - goal_to[l]);
+		}
+		out[i] = bound;
+	}
+}
+
+void Graph_Free(Graph * const graph) {
+	free(graph->offsets);
+	free(graph->edges);
+	free(graph->reverse_offsets);
+	free(graph->reverse_edges);
+	free(graph->point_x);
+	free(graph->point_y);
+	free(graph->point_z);
+	free(graph->landmarks);
+	free(graph->landmark_from);
+	free(graph->landmark_to);
+	memset(graph, 0, sizeof(Graph));
+}
+
+size_t Graph_Allocation(const Graph * const graph) {
+	size_t size = sizeof(Graph);
+	if (graph->offsets) size += (graph->n_nodes + 1) * sizeof(unsigned int) + graph->n_edges * sizeof(GraphEdge);
+	if (graph->reverse_offsets) size += (graph->n_nodes + 1) * sizeof(unsigned int) + graph->n_edges * sizeof(GraphEdge);
+	if (graph->point_x) size += graph->n_nodes * 3 * sizeof(double);
+	if (graph->landmarks) size += graph->n_landmarks * (sizeof(unsigned int) + 2 * (size_t)graph->n_nodes * sizeof(float));
+	return size;
+}
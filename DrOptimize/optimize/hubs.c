@@ -0,0 +1,433 @@
+/******************************************************************************
+ * Hub labels by pruned landmark labeling. The nodes are taken in order of
+ * importance, the top of a Hierarchy first or else the nodes of highest
+ * degree, and each in turn becomes a hub: a search from it adds it to the in
+ * label of every node it reaches, and a search over the reverse graph to the
+ * out label of every node that reaches it. A search is pruned at any node the
+ * labels built so far already give the right cost for, which the hubs before
+ * it have usually covered, so most searches stay small and the labels stay
+ * short. The check loads the hub's own label into a table by rank, making it
+ * one lookup per entry of the node's label.
+ *
+ * Labels are built on one thread, since each search prunes against the labels
+ * of all the hubs before it.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hubs.h"
+
+// A label while it is being built
+typedef struct HubLabelList {
+	unsigned int * hubs;
+	float * costs;
+	unsigned int * next;
+	unsigned int n_entries;
+	unsigned int capacity;
+} HubLabelList;
+
+typedef struct HubLabelsBuild {
+	const Graph * graph;
+	unsigned int * order;
+	HubLabelList * lists[2];
+	// Costs of the current hub's label, by rank
+	float * hub_costs;
+	// State of the current search
+	float * costs;
+	unsigned int * parents;
+	unsigned int * touched;
+	unsigned int n_touched;
+	PriorityQueue queue;
+} HubLabelsBuild;
+
+static void HubLabelList_Append(HubLabelList * const list, const unsigned int hub, const float cost, const unsigned int next) {
+	if (list->n_entries == list->capacity) {
+		list->capacity = list->capacity ? list->capacity * 2 : 4;
+		list->hubs = (unsigned int *)realloc(list->hubs, list->capacity * sizeof(unsigned int));
+		list->costs = (float *)realloc(list->costs, list->capacity * sizeof(float));
+		list->next = (unsigned int *)realloc(list->next, list->capacity * sizeof(unsigned int));
+	}
+	list->hubs[list->n_entries] = hub;
+	list->costs[list->n_entries] = cost;
+	list->next[list->n_entries] = next;
+	list->n_entries++;
+}
+
+static int HubLabels_Compare(float left, float right) {
+	if (left > right) return 1;
+	else if (left < right) return -1;
+	else return 0;
+}
+
+static int HubLabels_CompareKeys(const void * left, const void * right) {
+	unsigned long long a = *(const unsigned long long *)left, b = *(const unsigned long long *)right;
+	return (a > b) - (a < b);
+}
+
+// Nodes by falling rank in order, or else by falling degree and then id
+static void HubLabelsBuild_Order(HubLabelsBuild * const build, const Hierarchy * const order) {
+	const Graph * graph = build->graph;
+	unsigned int n_nodes = graph->n_nodes;
+	if (order) {
+		for (unsigned int node = 0; node < n_nodes; node++) build->order[n_nodes - 1 - order->ranks[node]] = node;
+		return;
+	}
+	unsigned long long * keys = (unsigned long long *)malloc(n_nodes * sizeof(unsigned long long));
+	for (unsigned int node = 0; node < n_nodes; node++) {
+		unsigned int degree = graph->offsets[node + 1] - graph->offsets[node]
+			+ graph->reverse_offsets[node + 1] - graph->reverse_offsets[node];
+		keys[node] = (unsigned long long)(0xffffffffu - degree) << 32 | node;
+	}
+	qsort(keys, n_nodes, sizeof(unsigned long long), HubLabels_CompareKeys);
+	for (unsigned int i = 0; i < n_nodes; i++) build->order[i] = (unsigned int)keys[i];
+	free(keys);
+}
+
+// Makes the hub of the given rank a hub of the labels on side, searching
+// forward for in labels and backward for out labels
+static void HubLabelsBuild_Search(HubLabelsBuild * const build, const int side, const unsigned int rank) {
+	const Graph * graph = build->graph;
+	unsigned int hub = build->order[rank];
+	const unsigned int * offsets = side == HUB_LABEL_IN ? graph->offsets : graph->reverse_offsets;
+	const GraphEdge * edges = side == HUB_LABEL_IN ? graph->edges : graph->reverse_edges;
+
+	// The hub's label on the other side, whose entries meet this side's
+	const HubLabelList * own = build->lists[!side] + hub;
+	for (unsigned int i = 0; i < own->n_entries; i++) build->hub_costs[own->hubs[i]] = own->costs[i];
+
+	build->costs[hub] = 0;
+	build->parents[hub] = HUB_LABEL_NONE;
+	build->touched[build->n_touched++] = hub;
+	PriorityQueue_SetPriority(&build->queue, (Data_t)hub, 0);
+	Data_t data;
+	float cost;
+	while (PriorityQueue_PopMin(&build->queue, &data, &cost) == PQ_SUCCESS) {
+		unsigned int node = (unsigned int)data;
+		HubLabelList * list = build->lists[side] + node;
+		int covered = 0;
+		for (unsigned int i = 0; i < list->n_entries && !covered; i++) {
+			covered = build->hub_costs[list->hubs[i]] + list->costs[i] <= cost;
+		}
+		if (covered) continue;
+
+		HubLabelList_Append(list, rank, cost, build->parents[node]);
+		for (unsigned int i = offsets[node]; i < offsets[node + 1]; i++) {
+			unsigned int next = edges[i].node;
+			float next_cost = cost + edges[i].cost;
+			if (next_cost < build->costs[next]) {
+				if (build->costs[next] == INFINITY) build->touched[build->n_touched++] = next;
+				build->costs[next] = next_cost;
+				build->parents[next] = node;
+				PriorityQueue_SetPriority(&build->queue, (Data_t)next, next_cost);
+			}
+		}
+	}
+
+	for (unsigned int i = 0; i < build->n_touched; i++) build->costs[build->touched[i]] = INFINITY;
+	build->n_touched = 0;
+	for (unsigned int i = 0; i < own->n_entries; i++) build->hub_costs[own->hubs[i]] = INFINITY;
+}
+
+// Lays the labels of one side out as padded arrays, freeing the lists
+static void HubLabels_Pack(HubLabels * const labels, const int side, HubLabelList * const lists, const int with_paths) {
+	unsigned int n_nodes = labels->n_nodes;
+	HubLabelSide * packed = labels->sides + side;
+	packed->offsets = (unsigned int *)malloc((n_nodes + 1) * sizeof(unsigned int));
+	packed->offsets[0] = 0;
+	for (unsigned int i = 0; i < n_nodes; i++) {
+		packed->offsets[i + 1] = packed->offsets[i] + (lists[i].n_entries / HUB_LABEL_BLOCK + 1) * HUB_LABEL_BLOCK;
+		labels->n_entries += lists[i].n_entries;
+	}
+	size_t n_slots = packed->offsets[n_nodes] ? packed->offsets[n_nodes] : HUB_LABEL_BLOCK;
+	packed->hubs = (unsigned int *)aligned_alloc(HUB_LABEL_BLOCK * sizeof(unsigned int), n_slots * sizeof(unsigned int));
+	packed->costs = (float *)aligned_alloc(HUB_LABEL_BLOCK * sizeof(float), n_slots * sizeof(float));
+	if (with_paths) packed->next = (unsigned int *)malloc(n_slots * sizeof(unsigned int));
+	for (unsigned int i = 0; i < n_nodes; i++) {
+		unsigned int first = packed->offsets[i];
+		unsigned int n = lists[i].n_entries;
+		memcpy(packed->hubs + first, lists[i].hubs, n * sizeof(unsigned int));
+		memcpy(packed->costs + first, lists[i].costs, n * sizeof(float));
+		if (with_paths) memcpy(packed->next + first, lists[i].next, n * sizeof(unsigned int));
+		for (unsigned int j = first + n; j < packed->offsets[i + 1]; j++) {
+			packed->hubs[j] = HUB_LABEL_NONE;
+			packed->costs[j] = INFINITY;
+			if (with_paths) packed->next[j] = HUB_LABEL_NONE;
+		}
+		free(lists[i].hubs);
+		free(lists[i].costs);
+		free(lists[i].next);
+	}
+	free(lists);
+}
+
+/******************************************************************************
+ * Labels every node of graph, which must have its reverse graph, taking the
+ * hubs in the order of the hierarchy order if given (built from the same
+ * graph) and by degree otherwise. With with_paths set the labels also keep
+ * what HubLabels_Query needs to recover paths.
+ */
+HubLabels HubLabels_Build(const Graph * const graph, const Hierarchy * const order, const int with_paths) {
+	struct timespec began, ended;
+	clock_gettime(CLOCK_MONOTONIC, &began);
+	HubLabels labels;
+	memset(&labels, 0, sizeof(HubLabels));
+	if (graph->error || (order && order->error)) {
+		labels.error = graph->error ? graph->error : order->error;
+		return labels;
+	}
+	if (!graph->reverse_offsets || (order && order->n_nodes != graph->n_nodes)) {
+		labels.error = DIJKSTRA_ERROR_INVALID_OPTIONS;
+		return labels;
+	}
+	unsigned int n_nodes = labels.n_nodes = graph->n_nodes;
+
+	HubLabelsBuild build;
+	build.graph = graph;
+	build.order = (unsigned int *)malloc(n_nodes * sizeof(unsigned int));
+	build.lists[HUB_LABEL_OUT] = (HubLabelList *)calloc(n_nodes, sizeof(HubLabelList));
+	build.lists[HUB_LABEL_IN] = (HubLabelList *)calloc(n_nodes, sizeof(HubLabelList));
+	build.hub_costs = (float *)malloc(n_nodes * sizeof(float));
+	build.costs = (float *)malloc(n_nodes * sizeof(float));
+	build.parents = (unsigned int *)malloc(n_nodes * sizeof(unsigned int));
+	build.touched = (unsigned int *)malloc(n_nodes * sizeof(unsigned int));
+	build.n_touched = 0;
+	build.queue = PriorityQueue_NewDense(HubLabels_Compare, NULL, n_nodes, PQ_DEFAULT_ARITY);
+	PriorityQueue_BuildImplicit(&build.queue, INFINITY, NULL, 0);
+	for (unsigned int i = 0; i < n_nodes; i++) build.hub_costs[i] = build.costs[i] = INFINITY;
+
+	HubLabelsBuild_Order(&build, order);
+	for (unsigned int rank = 0; rank < n_nodes; rank++) {
+		HubLabelsBuild_Search(&build, HUB_LABEL_IN, rank);
+		HubLabelsBuild_Search(&build, HUB_LABEL_OUT, rank);
+	}
+
+	labels.hub_nodes = build.order;
+	HubLabels_Pack(&labels, HUB_LABEL_OUT, build.lists[HUB_LABEL_OUT], with_paths);
+	HubLabels_Pack(&labels, HUB_LABEL_IN, build.lists[HUB_LABEL_IN], with_paths);
+	free(build.hub_costs);
+	free(build.costs);
+	free(build.parents);
+	free(build.touched);
+	PriorityQueue_Free(&build.queue);
+
+	clock_gettime(CLOCK_MONOTONIC, &ended);
+	labels.build_seconds = (ended.tv_sec - began.tv_sec) + (ended.tv_nsec - began.tv_nsec) * 1e-9;
+	return labels;
+}
+
+void HubLabels_Free(HubLabels * const labels) {
+	free(labels->hub_nodes);
+	for (int side = 0; side < 2; side++) {
+		free(labels->sides[side].offsets);
+		free(labels->sides[side].hubs);
+		free(labels->sides[side].costs);
+		free(labels->sides[side].next);
+	}
+	memset(labels, 0, sizeof(HubLabels));
+}
+
+size_t HubLabels_Allocation(const HubLabels * const labels) {
+	size_t size = sizeof(HubLabels);
+	if (!labels->hub_nodes) return size;
+	size += labels->n_nodes * sizeof(unsigned int);
+	for (int side = 0; side < 2; side++) {
+		const HubLabelSide * packed = labels->sides + side;
+		size_t n_slots = packed->offsets[labels->n_nodes];
+		size += (labels->n_nodes + 1) * sizeof(unsigned int) + n_slots * (sizeof(unsigned int) + sizeof(float));
+		if (packed->next) size += n_slots * sizeof(unsigned int);
+	}
+	return size;
+}
+
+/******************************************************************************
+ * Files are binary, in the byte order of the machine: the 8 bytes of
+ * HUB_LABELS_MAGIC, n_nodes and whether there are paths, hub_nodes, then for
+ * the out side and the in side the offsets followed by only the entries of
+ * each label, without padding. Both functions return 0 on success and -1 if
+ * the file cannot be opened or does not hold valid labels.
+ */
+static const char HUB_LABELS_MAGIC[8] = { 'd', 'k', 'h', 'l', 0, 0, 0, 1 };
+
+int HubLabels_Write(const HubLabels * const labels, const char * path) {
+	if (labels->error) return -1;
+	FILE * file = fopen(path, "wb");
+	if (!file) return -1;
+	unsigned int n = labels->n_nodes;
+	int with_paths = labels->sides[HUB_LABEL_OUT].next != NULL;
+	unsigned int header[2] = { n, (unsigned int)with_paths };
+	int ok = fwrite(HUB_LABELS_MAGIC, 1, 8, file) == 8 && fwrite(header, sizeof(unsigned int), 2, file) == 2
+		&& fwrite(labels->hub_nodes, sizeof(unsigned int), n, file) == n;
+	for (int side = 0; ok && side < 2; side++) {
+		const HubLabelSide * packed = labels->sides + side;
+		unsigned int * lengths = (unsigned int *)malloc((n ? n : 1) * sizeof(unsigned int));
+		for (unsigned int i = 0; i < n; i++) {
+			lengths[i] = 0;
+			while (packed->hubs[packed->offsets[i] + lengths[i]] != HUB_LABEL_NONE) lengths[i]++;
+		}
+		ok = fwrite(lengths, sizeof(unsigned int), n, file) == n;
+		for (unsigned int i = 0; ok && i < n; i++) {
+			unsigned int first = packed->offsets[i];
+			ok = fwrite(packed->hubs + first, sizeof(unsigned int), lengths[i], file) == lengths[i]
+				&& fwrite(packed->costs + first, sizeof(float), lengths[i], file) == lengths[i]
+				&& (!with_paths || fwrite(packed->next + first, sizeof(unsigned int), lengths[i], file) == lengths[i]);
+		}
+		free(lengths);
+	}
+	return fclose(file) == 0 && ok ? 0 : -1;
+}
+
+// Reads the labels of one side into lists, checking that each is in
+// increasing rank and names only real nodes
+static int HubLabels_ReadSide(FILE * file, const unsigned int n, const int with_paths, HubLabelList ** const out_lists) {
+	HubLabelList * lists = (HubLabelList *)calloc(n ? n : 1, sizeof(HubLabelList));
+	*out_lists = lists;
+	unsigned int * lengths = (unsigned int *)malloc((n ? n : 1) * sizeof(unsigned int));
+	int ok = fread(lengths, sizeof(unsigned int), n, file) == n;
+	for (unsigned int i = 0; ok && i < n; i++) {
+		HubLabelList * list = lists + i;
+		ok = lengths[i] <= n;
+		if (!ok) break;
+		list->n_entries = list->capacity = lengths[i];
+		list->hubs = (unsigned int *)malloc((lengths[i] ? lengths[i] : 1) * sizeof(unsigned int));
+		list->costs = (float *)malloc((lengths[i] ? lengths[i] : 1) * sizeof(float));
+		list->next = (unsigned int *)malloc((lengths[i] ? lengths[i] : 1) * sizeof(unsigned int));
+		ok = fread(list->hubs, sizeof(unsigned int), lengths[i], file) == lengths[i]
+			&& fread(list->costs, sizeof(float), lengths[i], file) == lengths[i]
+			&& (!with_paths || fread(list->next, sizeof(unsigned int), lengths[i], file) == lengths[i]);
+		for (unsigned int j = 0; ok && j < lengths[i]; j++) {
+			ok = list->hubs[j] < n && (j == 0 || list->hubs[j] > list->hubs[j - 1]) && list->costs[j] >= 0
+				&& (!with_paths || list->next[j] < n || list->next[j] == HUB_LABEL_NONE);
+		}
+	}
+	free(lengths);
+	return ok ? 0 : -1;
+}
+
+int HubLabels_Read(HubLabels * const labels, const char * path) {
+	memset(labels, 0, sizeof(HubLabels));
+	FILE * file = fopen(path, "rb");
+	if (!file) return -1;
+	char magic[8];
+	unsigned int header[2];
+	int ok = fread(magic, 1, 8, file) == 8 && memcmp(magic, HUB_LABELS_MAGIC, 8) == 0
+		&& fread(header, sizeof(unsigned int), 2, file) == 2 && header[1] <= 1;
+	HubLabelList * lists[2] = { NULL, NULL };
+	if (ok) {
+		unsigned int n = labels->n_nodes = header[0];
+		labels->hub_nodes = (unsigned int *)malloc((n ? n : 1) * sizeof(unsigned int));
+		ok = fread(labels->hub_nodes, sizeof(unsigned int), n, file) == n;
+		for (unsigned int i = 0; ok && i < n; i++) ok = labels->hub_nodes[i] < n;
+		ok = ok && HubLabels_ReadSide(file, n, header[1], lists + HUB_LABEL_OUT) == 0
+			&& HubLabels_ReadSide(file, n, header[1], lists + HUB_LABEL_IN) == 0;
+	}
+	fclose(file);
+	for (int side = 0; side < 2; side++) {
+		if (lists[side]) HubLabels_Pack(labels, side, lists[side], ok && header[1]);
+	}
+	if (!ok) {
+		HubLabels_Free(labels);
+		return -1;
+	}
+	return 0;
+}
+
+/******************************************************************************
+ * Queries
+ */
+
+// Merges the out label of start with the in label of end, returning the
+// cheapest cost through a hub they share and where that hub is in each. The
+// merge does not branch on the entries.
+static inline float HubLabels_Meet(const HubLabels * const labels, const unsigned int start, const unsigned int end,
+	unsigned int * const out_index, unsigned int * const in_index) {
+	const HubLabelSide * out = labels->sides + HUB_LABEL_OUT;
+	const HubLabelSide * in = labels->sides + HUB_LABEL_IN;
+	unsigned int i = out->offsets[start], j = in->offsets[end];
+	float best = INFINITY;
+	unsigned int best_i = i, best_j = j;
+	while (out->hubs[i] != HUB_LABEL_NONE && in->hubs[j] != HUB_LABEL_NONE) {
+		unsigned int a = out->hubs[i], b = in->hubs[j];
+		float cost = out->costs[i] + in->costs[j];
+		int better = a == b && cost < best;
+		best = better ? cost : best;
+		best_i = better ? i : best_i;
+		best_j = better ? j : best_j;
+		i += a <= b;
+		j += b <= a;
+	}
+	*out_index = best_i;
+	*in_index = best_j;
+	return best;
+}
+
+// The cost of the shortest path from start to end, INFINITY if there is none
+// or either is not a node
+float HubLabels_Distance(const HubLabels * const labels, const unsigned int start, const unsigned int end) {
+	if (labels->error || start >= labels->n_nodes || end >= labels->n_nodes) return INFINITY;
+	unsigned int i, j;
+	return HubLabels_Meet(labels, start, end, &i, &j);
+}
+
+/******************************************************************************
+ * Shortest path from start to end, with the errors of Dijkstra_Query, or
+ * DIJKSTRA_ERROR_INVALID_OPTIONS if the labels were built without paths.
+ * Each step meets the labels of the ends still apart and moves one of them a
+ * node towards the hub they share, so the path costs one merge per node.
+ */
+DijkstraOutput HubLabels_Query(const HubLabels * const labels, const unsigned int start, const unsigned int end) {
+	DijkstraOutput output;
+	memset(&output, 0, sizeof(DijkstraOutput));
+	output.total_cost = INFINITY;
+	if (labels->error) {
+		output.error = labels->error;
+		return output;
+	}
+	if (!labels->sides[HUB_LABEL_OUT].next) {
+		output.error = DIJKSTRA_ERROR_INVALID_OPTIONS;
+		return output;
+	}
+	if (start >= labels->n_nodes) {
+		output.error = DIJKSTRA_ERROR_INVALID_START;
+		return output;
+	}
+	else if (end >= labels->n_nodes) {
+		output.error = DIJKSTRA_ERROR_INVALID_END;
+		return output;
+	}
+	unsigned int i, j;
+	output.total_cost = HubLabels_Meet(labels, start, end, &i, &j);
+	if (output.total_cost == INFINITY) {
+		output.error = DIJKSTRA_ERROR_START_AND_END_NOT_CONNECTED;
+		return output;
+	}
+
+	// The path grows from start at the front of the buffer and from end at
+	// the back; a shortest path has no more nodes than the graph
+	unsigned int n_nodes = labels->n_nodes;
+	unsigned int * buffer = (unsigned int *)malloc(n_nodes * sizeof(unsigned int));
+	unsigned int n_front = 0, n_back = 0;
+	unsigned int front = start, back = end;
+	buffer[n_front++] = front;
+	while (front != back && n_front + n_back < n_nodes) {
+		HubLabels_Meet(labels, front, back, &i, &j);
+		if (labels->sides[HUB_LABEL_OUT].next[i] != HUB_LABEL_NONE) {
+			front = labels->sides[HUB_LABEL_OUT].next[i];
+			buffer[n_front++] = front;
+		}
+		else {
+			buffer[n_nodes - ++n_back] = back;
+			back = labels->sides[HUB_LABEL_IN].next[j];
+		}
+	}
+
+	output.n_elements = n_front + n_back;
+	output.path = (unsigned int *)malloc(output.n_elements * sizeof(unsigned int));
+	memcpy(output.path, buffer, n_front * sizeof(unsigned int));
+	memcpy(output.path + n_front, buffer + n_nodes - n_back, n_back * sizeof(unsigned int));
+	free(buffer);
+	return output;
+}
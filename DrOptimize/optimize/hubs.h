@@ -0,0 +1,58 @@
+/******************************************************************************
+ * Header file for hub labels.
+ */
+
+#pragma once
+
+#include "ch.h"
+
+/******************************************************************************
+ * Hub labels answer distance queries without searching. Every node has an
+ * out label, hubs it can reach with the cost to each, and an in label, hubs
+ * that reach it with the cost from each, chosen so that some hub on a
+ * shortest path from s to t is in both the out label of s and the in label
+ * of t. A query is then a merge of the two labels.
+ *
+ * Hubs are named by rank, their position in the order they were processed;
+ * hub_nodes gives the node of each rank. The label of node i on one side is
+ * hubs[offsets[i]] up to hubs[offsets[i + 1]], in increasing rank and padded
+ * with HUB_LABEL_NONE to a whole number of HUB_LABEL_BLOCK entries, with
+ * costs alongside. Each label starts on a block, so the arrays suit vector
+ * loads, and ends in at least one HUB_LABEL_NONE, so merges need no bounds.
+ * next, if the labels were built with paths, is the neighbour on the way to
+ * or from the hub: the next node going out, the previous one coming in.
+ *
+ * n_entries counts the entries other than padding, build_seconds is how long
+ * the labels took to build, and error is DIJKSTRA_SUCCESS or the reason they
+ * could not be.
+ */
+#define HUB_LABEL_NONE 0xffffffffu
+#define HUB_LABEL_BLOCK 8
+
+#define HUB_LABEL_OUT 0
+#define HUB_LABEL_IN 1
+
+typedef struct HubLabelSide {
+	unsigned int * offsets;
+	unsigned int * hubs;
+	float * costs;
+	unsigned int * next;
+} HubLabelSide;
+
+typedef struct HubLabels {
+	unsigned int n_nodes;
+	unsigned int * hub_nodes;
+	HubLabelSide sides[2];
+	size_t n_entries;
+	double build_seconds;
+	unsigned int error;
+} HubLabels;
+
+HubLabels HubLabels_Build(const Graph * const graph, const Hierarchy * const order, const int with_paths);
+void HubLabels_Free(HubLabels * const);
+size_t HubLabels_Allocation(const HubLabels * const);
+int HubLabels_Write(const HubLabels * const, const char * path);
+int HubLabels_Read(HubLabels * const, const char * path);
+
+float HubLabels_Distance(const HubLabels * const labels, const unsigned int start, const unsigned int end);
+DijkstraOutput HubLabels_Query(const HubLabels * const labels, const unsigned int start, const unsigned int end);
@@ -0,0 +1,213 @@
+/******************************************************************************
+ * Landmarks for A* on graphs without coordinates (ALT). Each landmark L keeps
+ * its distance to and from every node, and by the triangle inequality
+ *	d(v, t) >= d(L, t) - d(L, v)	and	d(v, t) >= d(v, L) - d(t, L)
+ * so the largest of these over the landmarks is a lower bound on the cost on
+ * to the goal t, which Graph_Estimates hands to A*.
+ *
+ * Landmarks are picked by farthest-point selection: each is the node farthest
+ * from the landmarks before it, the first being the farthest from node 0.
+ * Nodes that none of them reach count as farthest, so every part of a
+ * disconnected graph gets one. The searches from the landmarks are part of
+ * the selection and run in turn; the searches to them, over the reverse
+ * graph, then run on n_threads threads.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dijkstra.h"
+#include "thread.h"
+
+#define LANDMARKS_MAX_THREADS 64
+
+typedef struct LandmarksBuild {
+	Graph * graph;
+	unsigned int n_threads;
+	// Distances from one search, per thread
+	float * distances[LANDMARKS_MAX_THREADS];
+	PriorityQueue queues[LANDMARKS_MAX_THREADS];
+} LandmarksBuild;
+
+typedef struct LandmarksWorker {
+	Thread thread;
+	LandmarksBuild * build;
+	unsigned int index;
+} LandmarksWorker;
+
+static int Landmarks_Compare(float left, float right) {
+	if (left > right) return 1;
+	else if (left < right) return -1;
+	else return 0;
+}
+
+// Costs from source to every node along edges, INFINITY where unreachable
+static void Landmarks_Search(LandmarksBuild * const build, const unsigned int thread, const unsigned int * const offsets,
+	const GraphEdge * const edges, const unsigned int source) {
+	float * distances = build->distances[thread];
+	PriorityQueue * queue = build->queues + thread;
+	for (unsigned int i = 0; i < build->graph->n_nodes; i++) distances[i] = INFINITY;
+	PriorityQueue_Clear(queue);
+	distances[source] = 0;
+	PriorityQueue_SetPriority(queue, (Data_t)source, 0);
+
+	Data_t data;
+	float cost;
+	while (PriorityQueue_PopMin(queue, &data, &cost) == PQ_SUCCESS) {
+		unsigned int node = (unsigned int)data;
+		for (unsigned int i = offsets[node]; i < offsets[node + 1]; i++) {
+			float next_cost = cost + edges[i].cost;
+			if (next_cost < distances[edges[i].node]) {
+				distances[edges[i].node] = next_cost;
+				PriorityQueue_SetPriority(queue, (Data_t)edges[i].node, next_cost);
+			}
+		}
+	}
+}
+
+// Searches to the landmarks thread, thread + n_threads, and so on
+static void * LandmarksWorker_Run(void * argument) {
+	LandmarksWorker * worker = (LandmarksWorker *)argument;
+	LandmarksBuild * build = worker->build;
+	Graph * graph = build->graph;
+	unsigned int k = graph->n_landmarks;
+	for (unsigned int l = worker->index; l < k; l += build->n_threads) {
+		Landmarks_Search(build, worker->index, graph->reverse_offsets, graph->reverse_edges, graph->landmarks[l]);
+		for (unsigned int i = 0; i < graph->n_nodes; i++) graph->landmark_to[(size_t)i * k + l] = build->distances[worker->index][i];
+	}
+	return NULL;
+}
+
+static void Graph_FreeLandmarks(Graph * const graph) {
+	free(graph->landmarks);
+	free(graph->landmark_from);
+	free(graph->landmark_to);
+	graph->landmarks = NULL;
+	graph->landmark_from = graph->landmark_to = NULL;
+	graph->n_landmarks = 0;
+}
+
+/******************************************************************************
+ * Picks n_landmarks landmarks, at most GRAPH_MAX_LANDMARKS and no more than
+ * there are nodes, and fills in their distance tables using n_threads threads
+ * (0 for one per processor), replacing any landmarks the graph had. The graph
+ * must have its reverse graph. Returns DIJKSTRA_SUCCESS, the error of the
+ * graph, or DIJKSTRA_ERROR_INVALID_OPTIONS.
+ */
+int Graph_SelectLandmarks(Graph * const graph, const unsigned int n_landmarks, const unsigned int n_threads) {
+	if (graph->error) return graph->error;
+	if (!graph->reverse_offsets || n_landmarks == 0 || n_landmarks > GRAPH_MAX_LANDMARKS || n_landmarks > graph->n_nodes) {
+		return DIJKSTRA_ERROR_INVALID_OPTIONS;
+	}
+	Graph_FreeLandmarks(graph);
+	unsigned int n_nodes = graph->n_nodes;
+	unsigned int k = n_landmarks;
+	graph->n_landmarks = k;
+	graph->landmarks = (unsigned int *)malloc(k * sizeof(unsigned int));
+	graph->landmark_from = (float *)malloc((size_t)n_nodes * k * sizeof(float));
+	graph->landmark_to = (float *)malloc((size_t)n_nodes * k * sizeof(float));
+
+	LandmarksBuild build;
+	memset(&build, 0, sizeof(LandmarksBuild));
+	build.graph = graph;
+	build.n_threads = n_threads;
+	if (build.n_threads == 0) build.n_threads = Thread_CountProcessors();
+	if (build.n_threads > LANDMARKS_MAX_THREADS) build.n_threads = LANDMARKS_MAX_THREADS;
+	if (build.n_threads > k) build.n_threads = k;
+	for (unsigned int i = 0; i < build.n_threads; i++) {
+		build.distances[i] = (float *)malloc(n_nodes * sizeof(float));
+		build.queues[i] = PriorityQueue_NewDense(Landmarks_Compare, NULL, n_nodes, PQ_DEFAULT_ARITY);
+		PriorityQueue_BuildImplicit(build.queues + i, INFINITY, NULL, 0);
+	}
+
+	// The distance from each node to its nearest landmark so far, or -1 for
+	// the landmarks themselves
+	float * nearest = (float *)malloc(n_nodes * sizeof(float));
+	Landmarks_Search(&build, 0, graph->offsets, graph->edges, 0);
+	memcpy(nearest, build.distances[0], n_nodes * sizeof(float));
+	for (unsigned int l = 0; l < k; l++) {
+		unsigned int farthest = 0;
+		for (unsigned int i = 1; i < n_nodes; i++) {
+			if (nearest[i] > nearest[farthest]) farthest = i;
+		}
+		graph->landmarks[l] = farthest;
+		Landmarks_Search(&build, 0, graph->offsets, graph->edges, farthest);
+		const float * distances = build.distances[0];
+		for (unsigned int i = 0; i < n_nodes; i++) {
+			graph->landmark_from[(size_t)i * k + l] = distances[i];
+			if (l == 0 || distances[i] < nearest[i]) nearest[i] = distances[i];
+		}
+		for (unsigned int i = 0; i <= l; i++) nearest[graph->landmarks[i]] = -1;
+	}
+	free(nearest);
+
+	LandmarksWorker workers[LANDMARKS_MAX_THREADS];
+	for (unsigned int i = 0; i < build.n_threads; i++) {
+		workers[i].build = &build;
+		workers[i].index = i;
+		if (i > 0) Thread_Start(&workers[i].thread, LandmarksWorker_Run, workers + i);
+	}
+	LandmarksWorker_Run(workers);
+	for (unsigned int i = 1; i < build.n_threads; i++) Thread_Join(&workers[i].thread);
+
+	for (unsigned int i = 0; i < build.n_threads; i++) {
+		free(build.distances[i]);
+		PriorityQueue_Free(build.queues + i);
+	}
+	return DIJKSTRA_SUCCESS;
+}
+
+/******************************************************************************
+ * Landmark files are binary, in the byte order of the machine: the 8 bytes of
+ * LANDMARKS_MAGIC, n_nodes and n_landmarks, then landmarks, landmark_from and
+ * landmark_to. They go alongside the connections the graph is built from, and
+ * only load into a graph of the same size. Both functions return 0 on success
+ * and -1 if the file cannot be opened or does not fit the graph; a graph that
+ * fails to load is left without landmarks.
+ */
+static const char LANDMARKS_MAGIC[8] = { 'd', 'k', 'l', 'm', 0, 0, 0, 1 };
+
+int Graph_WriteLandmarks(const Graph * const graph, const char * path) {
+	if (!graph->landmarks) return -1;
+	FILE * file = fopen(path, "wb");
+	if (!file) return -1;
+	unsigned int k = graph->n_landmarks;
+	size_t n_distances = (size_t)graph->n_nodes * k;
+	unsigned int header[2] = { graph->n_nodes, k };
+	int ok = fwrite(LANDMARKS_MAGIC, 1, 8, file) == 8 && fwrite(header, sizeof(unsigned int), 2, file) == 2
+		&& fwrite(graph->landmarks, sizeof(unsigned int), k, file) == k
+		&& fwrite(graph->landmark_from, sizeof(float), n_distances, file) == n_distances
+		&& fwrite(graph->landmark_to, sizeof(float), n_distances, file) == n_distances;
+	return fclose(file) == 0 && ok ? 0 : -1;
+}
+
+int Graph_ReadLandmarks(Graph * const graph, const char * path) {
+	Graph_FreeLandmarks(graph);
+	if (graph->error) return -1;
+	FILE * file = fopen(path, "rb");
+	if (!file) return -1;
+	char magic[8];
+	unsigned int header[2];
+	int ok = fread(magic, 1, 8, file) == 8 && memcmp(magic, LANDMARKS_MAGIC, 8) == 0
+		&& fread(header, sizeof(unsigned int), 2, file) == 2
+		&& header[0] == graph->n_nodes && header[1] > 0 && header[1] <= GRAPH_MAX_LANDMARKS;
+	if (ok) {
+		unsigned int k = graph->n_landmarks = header[1];
+		size_t n_distances = (size_t)graph->n_nodes * k;
+		graph->landmarks = (unsigned int *)malloc(k * sizeof(unsigned int));
+		graph->landmark_from = (float *)malloc(n_distances * sizeof(float));
+		graph->landmark_to = (float *)malloc(n_distances * sizeof(float));
+		ok = fread(graph->landmarks, sizeof(unsigned int), k, file) == k
+			&& fread(graph->landmark_from, sizeof(float), n_distances, file) == n_distances
+			&& fread(graph->landmark_to, sizeof(float), n_distances, file) == n_distances;
+		for (unsigned int l = 0; ok && l < k; l++) ok = graph->landmarks[l] < graph->n_nodes;
+	}
+	fclose(file);
+	if (!ok) {
+		Graph_FreeLandmarks(graph);
+		return -1;
+	}
+	return 0;
+}
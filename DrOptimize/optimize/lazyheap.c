@@ -0,0 +1,123 @@
+/******************************************************************************
+ * Implementation of the Lazy Heap.
+ */
+
+#include <memory.h>
+#include <stdlib.h>
+
+#include "lazyheap.h"
+
+/******************************************************************************
+ * Sifting
+ */
+static void LazyHeap_SiftUp(LazyHeap * const heap, unsigned int position) {
+	LazyEntry entry = heap->entries[position];
+	while (position > 0) {
+		unsigned int parent = (position - 1) / 2;
+		if (entry.priority >= heap->entries[parent].priority) break;
+		heap->entries[position] = heap->entries[parent];
+		position = parent;
+	}
+	heap->entries[position] = entry;
+}
+
+static void LazyHeap_SiftDown(LazyHeap * const heap, unsigned int position) {
+	LazyEntry entry = heap->entries[position];
+	while (1) {
+		unsigned int best = position * 2 + 1;
+		if (best >= heap->n_entries) break;
+		if (best + 1 < heap->n_entries && heap->entries[best + 1].priority < heap->entries[best].priority) best++;
+		if (heap->entries[best].priority >= entry.priority) break;
+		heap->entries[position] = heap->entries[best];
+		position = best;
+	}
+	heap->entries[position] = entry;
+}
+
+/******************************************************************************
+ * Initialization
+ */
+LazyHeap LazyHeap_New(LazyStaleFunc is_stale, const void * context) {
+	LazyHeap heap;
+	memset(&heap, 0, sizeof(LazyHeap));
+	heap.is_stale = is_stale;
+	heap.context = context;
+	return heap;
+}
+
+/******************************************************************************
+ * Memory Free
+ */
+void LazyHeap_Free(LazyHeap * const heap) {
+	free(heap->entries);
+	memset(heap, 0, sizeof(LazyHeap));
+}
+
+void LazyHeap_Clear(LazyHeap * const heap) {
+	heap->n_entries = 0;
+	heap->n_stale = 0;
+}
+
+/******************************************************************************
+ * Push and Decrease
+ */
+void LazyHeap_Push(LazyHeap * const heap, const unsigned int id, const float priority) {
+	if (heap->n_entries == heap->capacity) {
+		heap->capacity = heap->capacity ? heap->capacity * 2 : 64;
+		heap->entries = (LazyEntry *)realloc(heap->entries, heap->capacity * sizeof(LazyEntry));
+	}
+	heap->entries[heap->n_entries].priority = priority;
+	heap->entries[heap->n_entries].id = id;
+	LazyHeap_SiftUp(heap, heap->n_entries++);
+}
+
+void LazyHeap_Decrease(LazyHeap * const heap, const unsigned int id, const float priority) {
+	LazyHeap_Push(heap, id, priority);
+	heap->n_stale++;
+	if (heap->n_entries >= LAZYHEAP_COMPACT_MIN && heap->n_stale * 2 > heap->n_entries) LazyHeap_Compact(heap);
+}
+
+/******************************************************************************
+ * Pop Next
+ */
+PQError LazyHeap_PopMin(LazyHeap * const heap, unsigned int * const out_id, float * const out_priority) {
+	while (heap->n_entries) {
+		LazyEntry top = heap->entries[0];
+		heap->entries[0] = heap->entries[--heap->n_entries];
+		if (heap->n_entries) LazyHeap_SiftDown(heap, 0);
+
+		if (heap->is_stale(heap->context, top.id, top.priority)) {
+			heap->n_stale_pops++;
+			if (heap->n_stale) heap->n_stale--;
+			continue;
+		}
+		*out_id = top.id;
+		*out_priority = top.priority;
+		return PQ_SUCCESS;
+	}
+	return PQ_ERROR_EMPTY_QUEUE;
+}
+
+/******************************************************************************
+ * Compaction
+ */
+void LazyHeap_Compact(LazyHeap * const heap) {
+	unsigned int kept = 0;
+	for (unsigned int i = 0; i < heap->n_entries; i++) {
+		LazyEntry entry = heap->entries[i];
+		if (!heap->is_stale(heap->context, entry.id, entry.priority)) heap->entries[kept++] = entry;
+	}
+	heap->n_entries = kept;
+	heap->n_stale = 0;
+	heap->n_compactions++;
+
+	// Floyd's heapify, bottom-up from the last internal node
+	for (unsigned int i = kept / 2; i-- > 0;) LazyHeap_SiftDown(heap, i);
+}
+
+/******************************************************************************
+ * Memory Heap Footprint
+ */
+size_t LazyHeap_Allocation(const LazyHeap * const heap) {
+	return sizeof(LazyHeap) + heap->capacity * sizeof(LazyEntry);
+}
@@ -0,0 +1,48 @@
+/******************************************************************************
+ * Header file for the Lazy Heap.
+ */
+
+#pragma once
+
+#include "priorityqueue.h"
+
+/******************************************************************************
+ * LazyHeap is a flat binary min-heap of (id, priority) entries with no index.
+ * Instead of moving an entry when its priority drops, Decrease pushes a
+ * duplicate and the old entry goes stale. Staleness is decided by the
+ * caller's is_stale callback, which PopMin uses to discard stale entries as
+ * they surface.
+ *
+ * Decrease counts the entries it makes stale. Once they are more than half
+ * of the heap (and the heap has at least LAZYHEAP_COMPACT_MIN entries), the
+ * heap is compacted: stale entries are filtered out and the rest heapified.
+ */
+
+#define LAZYHEAP_COMPACT_MIN 1024
+
+typedef int (*LazyStaleFunc)(const void * context, const unsigned int id, const float priority);
+
+typedef struct LazyEntry {
+	float priority;
+	unsigned int id;
+} LazyEntry;
+
+typedef struct LazyHeap {
+	LazyEntry * entries;
+	unsigned int n_entries;
+	unsigned int capacity;
+	unsigned int n_stale;
+	unsigned int n_stale_pops;
+	unsigned int n_compactions;
+	LazyStaleFunc is_stale;
+	const void * context;
+} LazyHeap;
+
+LazyHeap LazyHeap_New(LazyStaleFunc is_stale, const void * context);
+void LazyHeap_Free(LazyHeap * const);
+void LazyHeap_Clear(LazyHeap * const);
+void LazyHeap_Push(LazyHeap * const, const unsigned int id, const float priority);
+void LazyHeap_Decrease(LazyHeap * const, const unsigned int id, const float priority);
+PQError LazyHeap_PopMin(LazyHeap * const, unsigned int * const out_id, float * const out_priority);
+void LazyHeap_Compact(LazyHeap * const);
+size_t LazyHeap_Allocation(const LazyHeap * const);
@@ -0,0 +1,78 @@
+/******************************************************************************
+ * Benchmark for the MultiQueue. Each thread repeatedly pops a Pair and
+ * re-inserts it a random amount further on, the access pattern of a
+ * label-correcting search, and the throughput is reported per thread count.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "multiqueue.h"
+
+#define MQBENCH_PREFILL (1 << 20)
+#define MQBENCH_OPERATIONS (1 << 21)
+#define MQBENCH_MAX_THREADS 32
+
+typedef struct BenchThread {
+	pthread_t thread;
+	MultiQueue * queue;
+	unsigned int n_operations;
+	unsigned int seed;
+} BenchThread;
+
+static int FloatCompare(float left, float right) {
+	return (left > right) - (left < right);
+}
+
+static double Now(void) {
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+static void * BenchThread_Run(void * argument) {
+	BenchThread * bench = (BenchThread *)argument;
+	Data_t data;
+	Priority_t priority;
+	for (unsigned int i = 0; i < bench->n_operations; i++) {
+		if (MultiQueue_PopMin(bench->queue, &data, &priority) != PQ_SUCCESS) continue;
+		bench->seed = bench->seed * 1103515245u + 12345u;
+		MultiQueue_Insert(bench->queue, data, priority + (float)((bench->seed >> 16) % 1000));
+	}
+	return NULL;
+}
+
+int main() {
+	double baseline = 0;
+	printf("threads  Mops/s  speedup\n");
+	for (unsigned int n_threads = 1; n_threads <= MQBENCH_MAX_THREADS; n_threads *= 2) {
+		MultiQueue queue = MultiQueue_New(FloatCompare, n_threads, MQ_DEFAULT_FACTOR);
+		for (int i = 0; i < MQBENCH_PREFILL; i++) MultiQueue_Insert(&queue, i, (float)(rand() % 1000));
+
+		// Split a fixed amount of work between the threads
+		BenchThread threads[MQBENCH_MAX_THREADS];
+		double start = Now();
+		for (unsigned int i = 0; i < n_threads; i++) {
+			threads[i].queue = &queue;
+			threads[i].n_operations = MQBENCH_OPERATIONS / n_threads;
+			threads[i].seed = i + 1;
+			pthread_create(&threads[i].thread, NULL, BenchThread_Run, threads + i);
+		}
+		for (unsigned int i = 0; i < n_threads; i++) pthread_join(threads[i].thread, NULL);
+		double elapsed = Now() - start;
+
+		// Every pop was matched by an insert
+		if (MultiQueue_Length(&queue) != MQBENCH_PREFILL) {
+			printf("Lost pairs: %u of %u remain\n", MultiQueue_Length(&queue), MQBENCH_PREFILL);
+			return 1;
+		}
+
+		double rate = 2.0 * MQBENCH_OPERATIONS / elapsed / 1e6;
+		if (n_threads == 1) baseline = rate;
+		printf("%7u  %6.2f  %7.2f\n", n_threads, rate, rate / baseline);
+		MultiQueue_Free(&queue);
+	}
+	return 0;
+}
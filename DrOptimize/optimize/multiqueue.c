@@ -0,0 +1,159 @@
+/******************************************************************************
+ * Implementation of the MultiQueue.
+ */
+
+#include <memory.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "multiqueue.h"
+
+// Each thread draws heap indices from its own xorshift generator
+static __thread unsigned int mq_seed;
+
+static inline unsigned int MultiQueue_Random(const unsigned int n) {
+	if (mq_seed == 0) mq_seed = (unsigned int)(uintptr_t)&mq_seed | 1;
+	mq_seed ^= mq_seed << 13;
+	mq_seed ^= mq_seed >> 17;
+	mq_seed ^= mq_seed << 5;
+	return mq_seed % n;
+}
+
+/******************************************************************************
+ * Sequential Heaps, always used under their lock. n_data and top are
+ * published atomically for the lock-free peeks in PopMin.
+ */
+static void MQHeap_Push(MQHeap * const heap, PriorityCompareFunc compare, const Pair pair) {
+	unsigned int n_data = heap->n_data;
+	if (n_data == heap->capacity) {
+		heap->capacity = heap->capacity ? heap->capacity * 2 : 64;
+		heap->pairs = (Pair *)realloc(heap->pairs, heap->capacity * sizeof(Pair));
+	}
+	unsigned int position = n_data;
+	while (position > 0) {
+		unsigned int parent = (position - 1) / 2;
+		if (compare(pair.priority, heap->pairs[parent].priority) >= 0) break;
+		heap->pairs[position] = heap->pairs[parent];
+		position = parent;
+	}
+	heap->pairs[position] = pair;
+	__atomic_store(&heap->top, &heap->pairs[0].priority, __ATOMIC_RELAXED);
+	__atomic_store_n(&heap->n_data, n_data + 1, __ATOMIC_RELEASE);
+}
+
+static Pair MQHeap_Pop(MQHeap * const heap, PriorityCompareFunc compare) {
+	Pair top = heap->pairs[0];
+	unsigned int n_data = heap->n_data - 1;
+	Pair pair = heap->pairs[n_data];
+	unsigned int position = 0;
+	while (1) {
+		unsigned int best = position * 2 + 1;
+		if (best >= n_data) break;
+		if (best + 1 < n_data && compare(heap->pairs[best + 1].priority, heap->pairs[best].priority) < 0) best++;
+		if (compare(heap->pairs[best].priority, pair.priority) >= 0) break;
+		heap->pairs[position] = heap->pairs[best];
+		position = best;
+	}
+	if (n_data) {
+		heap->pairs[position] = pair;
+		__atomic_store(&heap->top, &heap->pairs[0].priority, __ATOMIC_RELAXED);
+	}
+	__atomic_store_n(&heap->n_data, n_data, __ATOMIC_RELEASE);
+	return top;
+}
+
+/******************************************************************************
+ * Initialization
+ */
+MultiQueue MultiQueue_New(PriorityCompareFunc priority_compare, const unsigned int n_threads, const unsigned int factor) {
+	MultiQueue queue;
+	queue.priority_compare = priority_compare;
+	queue.n_heaps = (n_threads ? n_threads : 1) * (factor ? factor : MQ_DEFAULT_FACTOR);
+	// Two heaps at least, so PopMin has a choice
+	if (queue.n_heaps < 2) queue.n_heaps = 2;
+	queue.heaps = (MQHeap *)aligned_alloc(sizeof(MQHeap), queue.n_heaps * sizeof(MQHeap));
+	memset(queue.heaps, 0, queue.n_heaps * sizeof(MQHeap));
+	for (unsigned int i = 0; i < queue.n_heaps; i++) pthread_mutex_init(&queue.heaps[i].lock, NULL);
+	return queue;
+}
+
+/******************************************************************************
+ * Memory Free
+ */
+void MultiQueue_Free(MultiQueue * const queue) {
+	for (unsigned int i = 0; i < queue->n_heaps; i++) {
+		pthread_mutex_destroy(&queue->heaps[i].lock);
+		free(queue->heaps[i].pairs);
+	}
+	free(queue->heaps);
+	queue->heaps = NULL;
+	queue->n_heaps = 0;
+}
+
+/******************************************************************************
+ * Insert and Pop
+ */
+PQError MultiQueue_Insert(MultiQueue * const queue, const Data_t data, const Priority_t priority) {
+	Pair pair = { data, priority };
+
+	// Skip heaps that another thread holds rather than waiting for them
+	MQHeap * heap;
+	do heap = queue->heaps + MultiQueue_Random(queue->n_heaps);
+	while (pthread_mutex_trylock(&heap->lock) != 0);
+
+	MQHeap_Push(heap, queue->priority_compare, pair);
+	pthread_mutex_unlock(&heap->lock);
+	return PQ_SUCCESS;
+}
+
+PQError MultiQueue_PopMin(MultiQueue * const queue, Data_t * const out_data, Priority_t * const out_priority) {
+	// Sample two heaps a bounded number of times before falling back on a scan
+	for (unsigned int attempt = 0; attempt < 2 * queue->n_heaps; attempt++) {
+		MQHeap * first = queue->heaps + MultiQueue_Random(queue->n_heaps);
+		MQHeap * second = queue->heaps + MultiQueue_Random(queue->n_heaps);
+		unsigned int first_n = __atomic_load_n(&first->n_data, __ATOMIC_ACQUIRE);
+		unsigned int second_n = __atomic_load_n(&second->n_data, __ATOMIC_ACQUIRE);
+		if (!first_n && !second_n) continue;
+
+		MQHeap * heap = first_n ? first : second;
+		if (first_n && second_n) {
+			Priority_t first_top, second_top;
+			__atomic_load(&first->top, &first_top, __ATOMIC_RELAXED);
+			__atomic_load(&second->top, &second_top, __ATOMIC_RELAXED);
+			if (queue->priority_compare(second_top, first_top) < 0) heap = second;
+		}
+
+		if (pthread_mutex_trylock(&heap->lock) != 0) continue;
+		if (heap->n_data) {
+			Pair pair = MQHeap_Pop(heap, queue->priority_compare);
+			pthread_mutex_unlock(&heap->lock);
+			*out_data = pair.data;
+			*out_priority = pair.priority;
+			return PQ_SUCCESS;
+		}
+		pthread_mutex_unlock(&heap->lock);
+	}
+
+	// Mostly empty: take from any heap that still holds something
+	for (unsigned int i = 0; i < queue->n_heaps; i++) {
+		MQHeap * heap = queue->heaps + i;
+		if (!__atomic_load_n(&heap->n_data, __ATOMIC_ACQUIRE)) continue;
+		pthread_mutex_lock(&heap->lock);
+		if (heap->n_data) {
+			Pair pair = MQHeap_Pop(heap, queue->priority_compare);
+			pthread_mutex_unlock(&heap->lock);
+			*out_data = pair.data;
+			*out_priority = pair.priority;
+			return PQ_SUCCESS;
+		}
+		pthread_mutex_unlock(&heap->lock);
+	}
+	return PQ_ERROR_EMPTY_QUEUE;
+}
+
+// Exact only while no other thread is modifying the queue
+unsigned int MultiQueue_Length(const MultiQueue * const queue) {
+	unsigned int length = 0;
+	for (unsigned int i = 0; i < queue->n_heaps; i++) length += __atomic_load_n(&queue->heaps[i].n_data, __ATOMIC_RELAXED);
+	return length;
+}
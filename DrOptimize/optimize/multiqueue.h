@@ -0,0 +1,45 @@
+/******************************************************************************
+ * Header file for the MultiQueue.
+ */
+
+#pragma once
+
+#include <pthread.h>
+
+#include "priorityqueue.h"
+
+/******************************************************************************
+ * MultiQueue is a relaxed concurrent priority queue of Pairs for use from
+ * many threads at once. It holds factor * n_threads sequential binary heaps,
+ * each behind its own lock:
+ *	 -	Insert pushes into one random heap.
+ *	 -	PopMin peeks at the minima of two random heaps and pops the better
+ *		one.
+ * PopMin therefore returns a Pair close to, but not always exactly, the
+ * minimum, which suits label-correcting searches that tolerate reordering.
+ * Data is not indexed, so the same data may be queued more than once.
+ * PopMin only reports PQ_ERROR_EMPTY_QUEUE after finding every heap empty.
+ */
+
+#define MQ_DEFAULT_FACTOR 2
+
+typedef struct MQHeap {
+	pthread_mutex_t lock;
+	Pair * pairs;
+	unsigned int n_data;
+	unsigned int capacity;
+	// Copy of pairs[0].priority that other threads read without the lock
+	Priority_t top;
+} __attribute__((aligned(64))) MQHeap;
+
+typedef struct MultiQueue {
+	MQHeap * heaps;
+	unsigned int n_heaps;
+	PriorityCompareFunc priority_compare;
+} MultiQueue;
+
+MultiQueue MultiQueue_New(PriorityCompareFunc, const unsigned int n_threads, const unsigned int factor);
+void MultiQueue_Free(MultiQueue * const);
+PQError MultiQueue_Insert(MultiQueue * const, const Data_t, const Priority_t);
+PQError MultiQueue_PopMin(MultiQueue * const, Data_t * const out_data, Priority_t * const out_priority);
+unsigned int MultiQueue_Length(const MultiQueue * const);
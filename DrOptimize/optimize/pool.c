@@ -0,0 +1,115 @@
+/******************************************************************************
+ * Implementation of the fixed-size object Pool.
+ */
+
+#include <memory.h>
+#include <stdlib.h>
+
+#include "pool.h"
+
+#define POOL_FIRST_SLAB 64
+#define POOL_MAX_SLAB 65536
+
+static inline char * PoolSlab_Objects(PoolSlab * const slab) {
+	return (char *)(slab + 1);
+}
+
+/******************************************************************************
+ * Initialization
+ */
+Pool Pool_New(const size_t object_size) {
+	Pool pool;
+	memset(&pool, 0, sizeof(Pool));
+
+	// Released objects hold the free list link, so they must fit a pointer
+	size_t size = object_size > sizeof(void *) ? object_size : sizeof(void *);
+	pool.object_size = (size + sizeof(void *) - 1) / sizeof(void *) * sizeof(void *);
+
+	return pool;
+}
+
+/******************************************************************************
+ * Memory Free
+ */
+void Pool_Free(Pool * const pool) {
+	PoolSlab * slab = pool->slabs;
+	while (slab) {
+		PoolSlab * next = slab->next;
+		free(slab);
+		slab = next;
+	}
+	pool->slabs = pool->current = NULL;
+	pool->free_list = NULL;
+	pool->n_carved = 0;
+	pool->capacity = 0;
+}
+
+void Pool_Reset(Pool * const pool) {
+	// Every object becomes available again; the slabs are kept
+	pool->free_list = NULL;
+	pool->current = pool->slabs;
+	pool->n_carved = 0;
+}
+
+/******************************************************************************
+ * Allocation
+ */
+static void Pool_AddSlab(Pool * const pool, size_t n_objects) {
+	PoolSlab * slab = (PoolSlab *)malloc(sizeof(PoolSlab) + n_objects * pool->object_size);
+	slab->next = NULL;
+	slab->n_objects = n_objects;
+	pool->capacity += n_objects;
+
+	// Append so that Pool_Reset carves the slabs in the same order again
+	if (!pool->slabs) {
+		pool->slabs = slab;
+		pool->current = slab;
+		pool->n_carved = 0;
+	}
+	else {
+		PoolSlab * last = pool->current ? pool->current : pool->slabs;
+		while (last->next) last = last->next;
+		last->next = slab;
+		if (!pool->current) {
+			pool->current = slab;
+			pool->n_carved = 0;
+		}
+	}
+}
+
+void Pool_Reserve(Pool * const pool, const size_t n_objects) {
+	if (n_objects > pool->capacity) Pool_AddSlab(pool, n_objects - pool->capacity);
+}
+
+void * Pool_Alloc(Pool * const pool) {
+	// Reuse released objects first
+	if (pool->free_list) {
+		void * object = pool->free_list;
+		pool->free_list = *(void **)object;
+		return object;
+	}
+
+	// Then carve the current slab, moving on to the next one when it is full
+	while (pool->current && pool->n_carved == pool->current->n_objects) {
+		pool->current = pool->current->next;
+		pool->n_carved = 0;
+	}
+	if (!pool->current) {
+		size_t n_objects = pool->capacity ? pool->capacity : POOL_FIRST_SLAB;
+		if (n_objects > POOL_MAX_SLAB) n_objects = POOL_MAX_SLAB;
+		Pool_AddSlab(pool, n_objects);
+	}
+	return PoolSlab_Objects(pool->current) + pool->object_size * pool->n_carved++;
+}
+
+void Pool_Release(Pool * const pool, void * const object) {
+	*(void **)object = pool->free_list;
+	pool->free_list = object;
+}
+
+/******************************************************************************
+ * Memory Heap Footprint
+ */
+size_t Pool_Allocation(const Pool * const pool) {
+	return pool->capacity * pool->object_size;
+}
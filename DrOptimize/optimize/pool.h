@@ -0,0 +1,36 @@
+/******************************************************************************
+ * Header file for the fixed-size object Pool.
+ */
+
+#pragma once
+
+#include <stdlib.h>
+
+/******************************************************************************
+ * A Pool hands out objects of one size from a list of slabs. Released objects
+ * go onto a free list and are reused before the slabs are carved further.
+ * Slabs are only returned to the system by Pool_Free, so a Pool can be reset
+ * and reused across many short-lived workloads without touching malloc.
+ */
+
+typedef struct PoolSlab {
+	struct PoolSlab * next;
+	size_t n_objects;
+} PoolSlab;
+
+typedef struct Pool {
+	void * free_list;
+	PoolSlab * slabs;
+	PoolSlab * current;
+	size_t n_carved;
+	size_t object_size;
+	size_t capacity;
+} Pool;
+
+Pool Pool_New(const size_t object_size);
+void Pool_Free(Pool * const);
+void Pool_Reset(Pool * const);
+void Pool_Reserve(Pool * const, const size_t n_objects);
+void * Pool_Alloc(Pool * const);
+void Pool_Release(Pool * const, void * const object);
+size_t Pool_Allocation(const Pool * const);
@@ -0,0 +1,82 @@
+/******************************************************************************
+ * Internal header shared by the Priority Queue backends. Not part of the
+ * public API; include priorityqueue.h instead.
+ */
+
+#pragma once
+
+#include "priorityqueue.h"
+
+/******************************************************************************
+ * Shared helpers (priorityqueue.c)
+ */
+void PriorityQueue_SortPairs(const PriorityQueue * const, Pair ** const pairs, const unsigned int n, const int by_data);
+unsigned int PriorityQueue_SearchPairs(const PriorityQueue * const, Pair ** const pairs, const unsigned int n, const Data_t data);
+void PriorityQueue_AttachStats(PriorityQueue * const);
+
+// Bump PriorityQueue_Stats counters in PQ_STATS builds
+#ifdef PQ_STATS
+#define PQ_COUNT_N(queue, counter, n) do { if ((queue)->stats) (queue)->stats->counter += (n); } while (0)
+#else
+#define PQ_COUNT_N(queue, counter, n) do { } while (0)
+#endif
+#define PQ_COUNT(queue, counter) PQ_COUNT_N(queue, counter, 1)
+
+// Every comparator call of the backends goes through these, to be counted
+static inline int PriorityQueue_ComparePriority(const PriorityQueue * const queue, const Priority_t left, const Priority_t right) {
+	PQ_COUNT(queue, n_comparisons);
+	return queue->priority_compare(left, right);
+}
+
+static inline int PriorityQueue_CompareData(const PriorityQueue * const queue, const Data_t left, const Data_t right) {
+	PQ_COUNT(queue, n_comparisons);
+	return queue->data_compare(left, right);
+}
+
+static inline int PriorityQueue_IsHeap(const PriorityQueue * const queue) {
+	return queue->backend == PQ_BACKEND_HEAP || queue->backend == PQ_BACKEND_MINMAX_HEAP;
+}
+
+/******************************************************************************
+ * Balanced tree backend (pqbalanced.c)
+ */
+PQError PQBalanced_Insert(PriorityQueue * const, const Data_t, const Priority_t);
+PQError PQBalanced_Remove(PriorityQueue * const, const Data_t);
+PQError PQBalanced_GetPriority(const PriorityQueue * const, const Data_t, Priority_t * const);
+PQError PQBalanced_SetPriority(PriorityQueue * const, const Data_t, const Priority_t);
+PQError PQBalanced_PopMin(PriorityQueue * const, Data_t * const, Priority_t * const);
+PQError PQBalanced_PopMax(PriorityQueue * const, Data_t * const, Priority_t * const);
+unsigned int PQBalanced_PopBatch(PriorityQueue * const, const unsigned int limit, Pair * const output);
+
+/******************************************************************************
+ * Heap backend (pqheap.c)
+ */
+void PQHeap_Free(PriorityQueue * const);
+void PQHeap_Clear(PriorityQueue * const);
+void PQHeap_Reserve(PriorityQueue * const, const unsigned int n_data);
+PQError PQHeap_Build(PriorityQueue * const, const Pair * const pairs, const unsigned int n);
+PQError PQHeap_InsertMany(PriorityQueue * const, const Pair * const pairs, const unsigned int n);
+PQError PQHeap_Insert(PriorityQueue * const, const Data_t, const Priority_t);
+PQError PQHeap_Remove(PriorityQueue * const, const Data_t);
+PQError PQHeap_GetPriority(const PriorityQueue * const, const Data_t, Priority_t * const);
+PQError PQHeap_SetPriority(PriorityQueue * const, const Data_t, const Priority_t);
+PQError PQHeap_PopMin(PriorityQueue * const, Data_t * const, Priority_t * const);
+PQError PQHeap_PopMax(PriorityQueue * const, Data_t * const, Priority_t * const);
+Pair * PQHeap_Serialize(PriorityQueue * const, const int by_data);
+void PQHeap_PrintTree(const PriorityQueue * const, const char * pattern);
+size_t PQHeap_Allocation(const PriorityQueue * const);
+
+// Moves pair into position and points its index slot at it
+static inline void PQHeap_Place(PriorityQueue * const queue, const unsigned int position, const Pair pair, const unsigned int slot) {
+	queue->heap[position] = pair;
+	queue->heap_slots[position] = slot;
+	queue->index.positions[slot] = position;
+}
+
+/******************************************************************************
+ * Min-max layout of the heap backend (pqminmax.c)
+ */
+void PQMinMax_BubbleUp(PriorityQueue * const, const unsigned int position);
+void PQMinMax_TrickleDown(PriorityQueue * const, const unsigned int position);
+void PQMinMax_Fix(PriorityQueue * const, const unsigned int position);
+unsigned int PQMinMax_MaxPosition(const PriorityQueue * const);
@@ -0,0 +1,420 @@
+/******************************************************************************
+ * Balanced tree backend of the Priority Queue. Both trees are AVL trees
+ * without a sentinel root:
+ *	 -	The data tree is ordered by data.
+ *	 -	The priority tree is ordered by priority, with ties broken by data, so
+ *		every Pair has a unique position and equal priorities stay balanced.
+ */
+
+#include <math.h>
+#include <memory.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pqbackend.h"
+
+/******************************************************************************
+ * Initialization
+ */
+PriorityQueue PriorityQueue_NewBalanced(DataCompareFunc data_compare, PriorityCompareFunc priority_compare, FreePairFunc free_pair) {
+	PriorityQueue queue;
+	memset(&queue, 0, sizeof(PriorityQueue));
+
+	queue.backend = PQ_BACKEND_BALANCED_TREE;
+	queue.dnode_pool = Pool_New(sizeof(DataNode));
+	queue.pnode_pool = Pool_New(sizeof(PriorityNode));
+	queue.pair_pool = Pool_New(sizeof(Pair));
+	queue.data_compare = data_compare;
+	queue.priority_compare = priority_compare;
+	queue.free_pair = free_pair;
+	PriorityQueue_AttachStats(&queue);
+
+	return queue;
+}
+
+/******************************************************************************
+ * Data Tree
+ */
+static inline int DataNode_Height(const DataNode * const node) {
+	return node ? node->height : 0;
+}
+
+static inline void DataNode_Update(DataNode * const node) {
+	int left = DataNode_Height(node->left);
+	int right = DataNode_Height(node->right);
+	node->height = (left > right ? left : right) + 1;
+}
+
+static DataNode * DataNode_RotateRight(DataNode * const node) {
+	DataNode * pivot = node->left;
+	node->left = pivot->right;
+	pivot->right = node;
+	DataNode_Update(node);
+	DataNode_Update(pivot);
+	return pivot;
+}
+
+static DataNode * DataNode_RotateLeft(DataNode * const node) {
+	DataNode * pivot = node->right;
+	node->right = pivot->left;
+	pivot->left = node;
+	DataNode_Update(node);
+	DataNode_Update(pivot);
+	return pivot;
+}
+
+static DataNode * DataNode_Rebalance(DataNode * const node) {
+	DataNode_Update(node);
+	int balance = DataNode_Height(node->left) - DataNode_Height(node->right);
+	if (balance > 1) {
+		if (DataNode_Height(node->left->left) < DataNode_Height(node->left->right)) {
+			node->left = DataNode_RotateLeft(node->left);
+		}
+		return DataNode_RotateRight(node);
+	}
+	if (balance < -1) {
+		if (DataNode_Height(node->right->right) < DataNode_Height(node->right->left)) {
+			node->right = DataNode_RotateRight(node->right);
+		}
+		return DataNode_RotateLeft(node);
+	}
+	return node;
+}
+
+// Inserts new_node; sets *inserted to 0 if the data already exists
+static DataNode * DataNode_Insert(const PriorityQueue * const queue, DataNode * const node, DataNode * const new_node, int * const inserted) {
+	if (!node) return new_node;
+	PQ_COUNT(queue, n_node_visits);
+	int comp = PriorityQueue_CompareData(queue, new_node->pair->data, node->pair->data);
+	if (comp == 0) {
+		*inserted = 0;
+		return node;
+	}
+	if (comp > 0) node->right = DataNode_Insert(queue, node->right, new_node, inserted);
+	else node->left = DataNode_Insert(queue, node->left, new_node, inserted);
+	return DataNode_Rebalance(node);
+}
+
+// Detaches the left-most node of the subtree into *out_min
+static DataNode * DataNode_RemoveMin(DataNode * const node, DataNode ** const out_min) {
+	if (!node->left) {
+		*out_min = node;
+		return node->right;
+	}
+	node->left = DataNode_RemoveMin(node->left, out_min);
+	return DataNode_Rebalance(node);
+}
+
+// Detaches the node holding data into *out_node, or leaves it NULL
+static DataNode * DataNode_Remove(const PriorityQueue * const queue, DataNode * const node, const Data_t data, DataNode ** const out_node) {
+	if (!node) return NULL;
+	PQ_COUNT(queue, n_node_visits);
+	int comp = PriorityQueue_CompareData(queue, data, node->pair->data);
+	if (comp > 0) node->right = DataNode_Remove(queue, node->right, data, out_node);
+	else if (comp < 0) node->left = DataNode_Remove(queue, node->left, data, out_node);
+	else {
+		*out_node = node;
+		if (!node->left) return node->right;
+		if (!node->right) return node->left;
+		// Replace with the in-order successor
+		DataNode * successor;
+		DataNode * right = DataNode_RemoveMin(node->right, &successor);
+		successor->left = node->left;
+		successor->right = right;
+		return DataNode_Rebalance(successor);
+	}
+	return DataNode_Rebalance(node);
+}
+
+// Joins two trees and a node ordered between them, whatever their heights
+static DataNode * DataNode_Join(DataNode * const left, DataNode * const node, DataNode * const right) {
+	int left_height = DataNode_Height(left);
+	int right_height = DataNode_Height(right);
+	if (left_height > right_height + 1) {
+		left->right = DataNode_Join(left->right, node, right);
+		return DataNode_Rebalance(left);
+	}
+	if (right_height > left_height + 1) {
+		right->left = DataNode_Join(left, node, right->left);
+		return DataNode_Rebalance(right);
+	}
+	node->left = left;
+	node->right = right;
+	DataNode_Update(node);
+	return node;
+}
+
+// Detaches and releases the nodes of n pairs, sorted by data, in one walk
+static DataNode * DataNode_RemoveSorted(PriorityQueue * const queue, DataNode * const node, Pair ** const pairs, const unsigned int n) {
+	if (!node || n == 0) return node;
+	PQ_COUNT(queue, n_node_visits);
+	unsigned int below = PriorityQueue_SearchPairs(queue, pairs, n, node->pair->data);
+	unsigned int found = below < n && PriorityQueue_CompareData(queue, pairs[below]->data, node->pair->data) == 0;
+	DataNode * left = DataNode_RemoveSorted(queue, node->left, pairs, below);
+	DataNode * right = DataNode_RemoveSorted(queue, node->right, pairs + below + found, n - below - found);
+	if (!found) return DataNode_Join(left, node, right);
+
+	if (queue->free_pair) queue->free_pair(node->pair);
+	Pool_Release(&queue->pair_pool, node->pair);
+	Pool_Release(&queue->dnode_pool, node);
+	if (!right) return left;
+	DataNode * successor;
+	right = DataNode_RemoveMin(right, &successor);
+	return DataNode_Join(left, successor, right);
+}
+
+static DataNode * DataNode_Find(const PriorityQueue * const queue, const Data_t data) {
+	DataNode * node = queue->data_tree;
+	while (node) {
+		PQ_COUNT(queue, n_node_visits);
+		int comp = PriorityQueue_CompareData(queue, data, node->pair->data);
+		if (comp == 0) break;
+		node = comp > 0 ? node->right : node->left;
+	}
+	return node;
+}
+
+/******************************************************************************
+ * Priority Tree
+ */
+static inline int PriorityNode_Height(const PriorityNode * const node) {
+	return node ? node->height : 0;
+}
+
+static inline void PriorityNode_Update(PriorityNode * const node) {
+	int left = PriorityNode_Height(node->left);
+	int right = PriorityNode_Height(node->right);
+	node->height = (left > right ? left : right) + 1;
+}
+
+static PriorityNode * PriorityNode_RotateRight(PriorityNode * const node) {
+	PriorityNode * pivot = node->left;
+	node->left = pivot->right;
+	pivot->right = node;
+	PriorityNode_Update(node);
+	PriorityNode_Update(pivot);
+	return pivot;
+}
+
+static PriorityNode * PriorityNode_RotateLeft(PriorityNode * const node) {
+	PriorityNode * pivot = node->right;
+	node->right = pivot->left;
+	pivot->left = node;
+	PriorityNode_Update(node);
+	PriorityNode_Update(pivot);
+	return pivot;
+}
+
+static PriorityNode * PriorityNode_Rebalance(PriorityNode * const node) {
+	PriorityNode_Update(node);
+	int balance = PriorityNode_Height(node->left) - PriorityNode_Height(node->right);
+	if (balance > 1) {
+		if (PriorityNode_Height(node->left->left) < PriorityNode_Height(node->left->right)) {
+			node->left = PriorityNode_RotateLeft(node->left);
+		}
+		return PriorityNode_RotateRight(node);
+	}
+	if (balance < -1) {
+		if (PriorityNode_Height(node->right->right) < PriorityNode_Height(node->right->left)) {
+			node->right = PriorityNode_RotateRight(node->right);
+		}
+		return PriorityNode_RotateLeft(node);
+	}
+	return node;
+}
+
+// Orders by priority, then by data
+static inline int PriorityNode_Compare(const PriorityQueue * const queue, const Pair * const left, const Pair * const right) {
+	int comp = PriorityQueue_ComparePriority(queue, left->priority, right->priority);
+	if (comp == 0) comp = PriorityQueue_CompareData(queue, left->data, right->data);
+	return comp;
+}
+
+static PriorityNode * PriorityNode_Insert(const PriorityQueue * const queue, PriorityNode * const node, PriorityNode * const new_node) {
+	if (!node) return new_node;
+	PQ_COUNT(queue, n_node_visits);
+	if (PriorityNode_Compare(queue, new_node->pair, node->pair) > 0) {
+		node->right = PriorityNode_Insert(queue, node->right, new_node);
+	}
+	else node->left = PriorityNode_Insert(queue, node->left, new_node);
+	return PriorityNode_Rebalance(node);
+}
+
+static PriorityNode * PriorityNode_RemoveMin(PriorityNode * const node, PriorityNode ** const out_min) {
+	if (!node->left) {
+		*out_min = node;
+		return node->right;
+	}
+	node->left = PriorityNode_RemoveMin(node->left, out_min);
+	return PriorityNode_Rebalance(node);
+}
+
+// Detaches the node holding pair into *out_node
+static PriorityNode * PriorityNode_Remove(const PriorityQueue * const queue, PriorityNode * const node, const Pair * const pair, PriorityNode ** const out_node) {
+	if (!node) return NULL;
+	PQ_COUNT(queue, n_node_visits);
+	int comp = PriorityNode_Compare(queue, pair, node->pair);
+	if (comp > 0) node->right = PriorityNode_Remove(queue, node->right, pair, out_node);
+	else if (comp < 0) node->left = PriorityNode_Remove(queue, node->left, pair, out_node);
+	else {
+		*out_node = node;
+		if (!node->left) return node->right;
+		if (!node->right) return node->left;
+		PriorityNode * successor;
+		PriorityNode * right = PriorityNode_RemoveMin(node->right, &successor);
+		successor->left = node->left;
+		successor->right = right;
+		return PriorityNode_Rebalance(successor);
+	}
+	return PriorityNode_Rebalance(node);
+}
+
+static PriorityNode * PriorityNode_Join(PriorityNode * const left, PriorityNode * const node, PriorityNode * const right) {
+	int left_height = PriorityNode_Height(left);
+	int right_height = PriorityNode_Height(right);
+	if (left_height > right_height + 1) {
+		left->right = PriorityNode_Join(left->right, node, right);
+		return PriorityNode_Rebalance(left);
+	}
+	if (right_height > left_height + 1) {
+		right->left = PriorityNode_Join(left, node, right->left);
+		return PriorityNode_Rebalance(right);
+	}
+	node->left = left;
+	node->right = right;
+	PriorityNode_Update(node);
+	return node;
+}
+
+// Detaches the first nodes in order until *n reaches limit, as
+// PriorityQueue_PopPrefix does, rejoining what is left
+static PriorityNode * PriorityNode_PopPrefix(PriorityQueue * const queue, PriorityNode * const node,
+	Pair * const output, Pair ** const popped, unsigned int * const n, const unsigned int limit) {
+	if (!node || *n == limit) return node;
+	PriorityNode * left = PriorityNode_PopPrefix(queue, node->left, output, popped, n, limit);
+	if (*n == limit) return PriorityNode_Join(left, node, node->right);
+	PQ_COUNT(queue, n_node_visits);
+	output[*n] = *node->pair;
+	popped[(*n)++] = node->pair;
+	PriorityNode * right = node->right;
+	Pool_Release(&queue->pnode_pool, node);
+	return PriorityNode_PopPrefix(queue, right, output, popped, n, limit);
+}
+
+/******************************************************************************
+ * Insert and Remove
+ */
+PQError PQBalanced_Insert(PriorityQueue * const queue, const Data_t data, const Priority_t priority) {
+	Pair * pair = (Pair *)Pool_Alloc(&queue->pair_pool);
+	pair->data = data;
+	pair->priority = priority;
+
+	// Insert into the data tree first to check for duplicates
+	DataNode * dnode = (DataNode *)Pool_Alloc(&queue->dnode_pool);
+	dnode->pair = pair;
+	dnode->left = dnode->right = NULL;
+	dnode->height = 1;
+	int inserted = 1;
+	queue->data_tree = DataNode_Insert(queue, queue->data_tree, dnode, &inserted);
+	if (!inserted) {
+		Pool_Release(&queue->dnode_pool, dnode);
+		Pool_Release(&queue->pair_pool, pair);
+		return PQ_ERROR_KEY_ALREADY_EXISTS;
+	}
+
+	PriorityNode * pnode = (PriorityNode *)Pool_Alloc(&queue->pnode_pool);
+	pnode->pair = pair;
+	pnode->left = pnode->right = NULL;
+	pnode->height = 1;
+	queue->priority_tree = PriorityNode_Insert(queue, queue->priority_tree, pnode);
+
+	PQ_COUNT_N(queue, n_allocations, 3);
+	queue->n_data++;
+	return PQ_SUCCESS;
+}
+
+PQError PQBalanced_Remove(PriorityQueue * const queue, const Data_t data) {
+	DataNode * dnode = NULL;
+	queue->data_tree = DataNode_Remove(queue, queue->data_tree, data, &dnode);
+	if (!dnode) return PQ_ERROR_KEY_DOES_NOT_EXIST;
+
+	PriorityNode * pnode = NULL;
+	queue->priority_tree = PriorityNode_Remove(queue, queue->priority_tree, dnode->pair, &pnode);
+
+	if (queue->free_pair) queue->free_pair(dnode->pair);
+	Pool_Release(&queue->pair_pool, dnode->pair);
+	Pool_Release(&queue->dnode_pool, dnode);
+	Pool_Release(&queue->pnode_pool, pnode);
+	queue->n_data--;
+
+	return PQ_SUCCESS;
+}
+
+/******************************************************************************
+ * Getting and Modifying Priority
+ */
+PQError PQBalanced_GetPriority(const PriorityQueue * const queue, const Data_t data, Priority_t * const out_priority) {
+	DataNode * node = DataNode_Find(queue, data);
+	if (!node) return PQ_ERROR_KEY_DOES_NOT_EXIST;
+	*out_priority = node->pair->priority;
+	return PQ_SUCCESS;
+}
+
+PQError PQBalanced_SetPriority(PriorityQueue * const queue, const Data_t data, const Priority_t priority) {
+	DataNode * dnode = DataNode_Find(queue, data);
+	if (!dnode) return PQ_ERROR_KEY_DOES_NOT_EXIST;
+
+	// Re-position the existing node in the priority tree; nothing is allocated
+	PriorityNode * pnode = NULL;
+	queue->priority_tree = PriorityNode_Remove(queue, queue->priority_tree, dnode->pair, &pnode);
+	dnode->pair->priority = priority;
+	pnode->left = pnode->right = NULL;
+	pnode->height = 1;
+	queue->priority_tree = PriorityNode_Insert(queue, queue->priority_tree, pnode);
+
+	return PQ_SUCCESS;
+}
+
+/******************************************************************************
+ * Pop Next
+ */
+PQError PQBalanced_PopMin(PriorityQueue * const queue, Data_t * const out_data, Priority_t * const out_priority) {
+	if (queue->n_data == 0) return PQ_ERROR_EMPTY_QUEUE;
+	PriorityNode * node = queue->priority_tree;
+	while (node->left) {
+		PQ_COUNT(queue, n_node_visits);
+		node = node->left;
+	}
+
+	*out_data = node->pair->data;
+	*out_priority = node->pair->priority;
+	return PQBalanced_Remove(queue, *out_data);
+}
+
+PQError PQBalanced_PopMax(PriorityQueue * const queue, Data_t * const out_data, Priority_t * const out_priority) {
+	if (queue->n_data == 0) return PQ_ERROR_EMPTY_QUEUE;
+	PriorityNode * node = queue->priority_tree;
+	while (node->right) {
+		PQ_COUNT(queue, n_node_visits);
+		node = node->right;
+	}
+
+	*out_data = node->pair->data;
+	*out_priority = node->pair->priority;
+	return PQBalanced_Remove(queue, *out_data);
+}
+
+/******************************************************************************
+ * Pops limit pairs, at most n_data, in priority order into output: one walk
+ * splits them off the priority tree and one removes them from the data tree.
+ */
+unsigned int PQBalanced_PopBatch(PriorityQueue * const queue, const unsigned int limit, Pair * const output) {
+	Pair ** popped = (Pair **)malloc(limit * sizeof(Pair *));
+	unsigned int n = 0;
+	queue->priority_tree = PriorityNode_PopPrefix(queue, queue->priority_tree, output, popped, &n, limit);
+	PriorityQueue_SortPairs(queue, popped, n, 1);
+	queue->data_tree = DataNode_RemoveSorted(queue, queue->data_tree, popped, n);
+	queue->n_data -= n;
+	free(popped);
+	return n;
+}
@@ -0,0 +1,508 @@
+/******************************************************************************
+ * Benchmark for the queue backends. Captures Dijkstra traces on synthetic grid
+ * and random geometric graphs, plus any trace files given on the command line
+ * (for example ones dumped from OSM graphs with DijkstraOptions.trace and
+ * DijkstraTrace_Write), and replays each trace against every backend.
+ *
+ * Reports, per trace and backend:
+ *	 -	ns/op, the best of PQBENCH_REPEATS timed replays.
+ *	 -	Peak memory of the queue, from its Allocation function.
+ *	 -	Comparisons per op, for backends that compare through function
+ *		pointers.
+ *
+ * Pops may break ties differently from the captured run, so a decrease can
+ * name a node a backend has already popped; replays push it again instead.
+ *
+ * Usage: pqbench [--dump <directory>] [trace files...]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bucketqueue.h"
+#include "dijkstra.h"
+#include "lazyheap.h"
+#include "pqgeneric.h"
+#include "priorityqueue.h"
+#include "radixheap.h"
+
+#define PQBENCH_REPEATS 3
+#define PQBENCH_GRID_SIDE 256
+#define PQBENCH_GEOMETRIC_NODES 50000
+#define PQBENCH_QUANTIZATION_STEP 0.001f
+
+static unsigned long long n_comparisons;
+
+static int FloatCompare(float left, float right) {
+	return (left > right) - (left < right);
+}
+
+static int IntCompare(int left, int right) {
+	return (left > right) - (left < right);
+}
+
+static int CountingFloatCompare(float left, float right) {
+	n_comparisons++;
+	return (left > right) - (left < right);
+}
+
+static int CountingIntCompare(int left, int right) {
+	n_comparisons++;
+	return (left > right) - (left < right);
+}
+
+static double Now(void) {
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+static float Random(void) {
+	return (float)rand() / RAND_MAX;
+}
+
+/******************************************************************************
+ * Graphs
+ */
+
+// A side x side grid with random costs on the four-neighbour edges
+static Connection * Graph_Grid(const unsigned int side, unsigned int * const out_n) {
+	Connection * cons = (Connection *)malloc(4 * side * side * sizeof(Connection));
+	unsigned int n = 0;
+	for (unsigned int y = 0; y < side; y++) {
+		for (unsigned int x = 0; x < side; x++) {
+			unsigned int id = y * side + x;
+			float right = 1.0f + 9.0f * Random();
+			float down = 1.0f + 9.0f * Random();
+			if (x + 1 < side) {
+				cons[n++] = Connection_Init(id, id + 1, right);
+				cons[n++] = Connection_Init(id + 1, id, right);
+			}
+			if (y + 1 < side) {
+				cons[n++] = Connection_Init(id, id + side, down);
+				cons[n++] = Connection_Init(id + side, id, down);
+			}
+		}
+	}
+	*out_n = n;
+	return cons;
+}
+
+// Points in the unit square joined to every point within radius, found through
+// a grid of radius-sized cells; each point is also joined to the next so that
+// every id appears
+static Connection * Graph_Geometric(const unsigned int n_nodes, unsigned int * const out_n) {
+	float radius = sqrtf(8.0f / n_nodes);
+	unsigned int side = (unsigned int)(1.0f / radius) + 1;
+	float * xs = (float *)malloc(n_nodes * sizeof(float));
+	float * ys = (float *)malloc(n_nodes * sizeof(float));
+	unsigned int * cell_start = (unsigned int *)calloc(side * side + 1, sizeof(unsigned int));
+	unsigned int * cell_nodes = (unsigned int *)malloc(n_nodes * sizeof(unsigned int));
+	for (unsigned int i = 0; i < n_nodes; i++) {
+		xs[i] = Random();
+		ys[i] = Random();
+		cell_start[(unsigned int)(ys[i] / radius) * side + (unsigned int)(xs[i] / radius) + 1]++;
+	}
+	for (unsigned int i = 0; i < side * side; i++) cell_start[i + 1] += cell_start[i];
+	unsigned int * fill = (unsigned int *)malloc(side * side * sizeof(unsigned int));
+	memcpy(fill, cell_start, side * side * sizeof(unsigned int));
+	for (unsigned int i = 0; i < n_nodes; i++) {
+		cell_nodes[fill[(unsigned int)(ys[i] / radius) * side + (unsigned int)(xs[i] / radius)]++] = i;
+	}
+
+	unsigned int capacity = 16 * n_nodes, n = 0;
+	Connection * cons = (Connection *)malloc(capacity * sizeof(Connection));
+	for (unsigned int i = 0; i < n_nodes; i++) {
+		int cx = (int)(xs[i] / radius), cy = (int)(ys[i] / radius);
+		for (int dy = -1; dy <= 1; dy++) {
+			for (int dx = -1; dx <= 1; dx++) {
+				int x = cx + dx, y = cy + dy;
+				if (x < 0 || y < 0 || x >= (int)side || y >= (int)side) continue;
+				unsigned int cell = y * side + x;
+				for (unsigned int j = cell_start[cell]; j < cell_start[cell + 1]; j++) {
+					unsigned int other = cell_nodes[j];
+					float ddx = xs[i] - xs[other], ddy = ys[i] - ys[other];
+					float distance = sqrtf(ddx * ddx + ddy * ddy);
+					if (other == i || distance > radius) continue;
+					if (n == capacity) {
+						capacity *= 2;
+						cons = (Connection *)realloc(cons, capacity * sizeof(Connection));
+					}
+					cons[n++] = Connection_Init(i, other, distance);
+				}
+			}
+		}
+	}
+	cons = (Connection *)realloc(cons, (n + 2 * n_nodes) * sizeof(Connection));
+	for (unsigned int i = 0; i + 1 < n_nodes; i++) {
+		float ddx = xs[i] - xs[i + 1], ddy = ys[i] - ys[i + 1];
+		float distance = sqrtf(ddx * ddx + ddy * ddy);
+		cons[n++] = Connection_Init(i, i + 1, distance);
+		cons[n++] = Connection_Init(i + 1, i, distance);
+	}
+
+	free(xs);
+	free(ys);
+	free(cell_start);
+	free(cell_nodes);
+	free(fill);
+	*out_n = n;
+	return cons;
+}
+
+// Runs one query from node 0 to the last node and keeps its trace
+static DijkstraTrace Capture(const Connection * const cons, const unsigned int n_cons, const unsigned int end) {
+	DijkstraTrace trace = DijkstraTrace_New();
+	DijkstraOptions options = DijkstraOptions_Init();
+	options.trace = &trace;
+	DijkstraOutput output = Dijkstra_ShortestPathWithOptions(cons, n_cons, 0, end, &options);
+	free(output.path);
+	return trace;
+}
+
+/******************************************************************************
+ * Backends under test. Each wraps one queue behind push, decrease and pop.
+ */
+typedef struct Backend {
+	const char * name;
+	void * (*New)(const DijkstraTrace * const, const int counting);
+	void (*Push)(void * const, const unsigned int id, const float priority);
+	void (*Decrease)(void * const, const unsigned int id, const float priority);
+	void (*Pop)(void * const);
+	size_t (*Allocation)(const void * const);
+	void (*Free)(void * const);
+	int compares;
+} Backend;
+
+// PriorityQueue backends
+static void * PQ_NewTree(const DijkstraTrace * const trace, const int counting) {
+	PriorityQueue * queue = (PriorityQueue *)malloc(sizeof(PriorityQueue));
+	*queue = PriorityQueue_New(counting ? CountingIntCompare : IntCompare, counting ? CountingFloatCompare : FloatCompare, NULL);
+	return queue;
+}
+
+static void * PQ_NewBalanced(const DijkstraTrace * const trace, const int counting) {
+	PriorityQueue * queue = (PriorityQueue *)malloc(sizeof(PriorityQueue));
+	*queue = PriorityQueue_NewBalanced(counting ? CountingIntCompare : IntCompare, counting ? CountingFloatCompare : FloatCompare, NULL);
+	return queue;
+}
+
+static void * PQ_NewHeap(const DijkstraTrace * const trace, const int counting) {
+	PriorityQueue * queue = (PriorityQueue *)malloc(sizeof(PriorityQueue));
+	*queue = PriorityQueue_NewHeap(counting ? CountingIntCompare : IntCompare, counting ? CountingFloatCompare : FloatCompare, NULL, PQ_DEFAULT_ARITY);
+	return queue;
+}
+
+static void * PQ_NewDense(const DijkstraTrace * const trace, const int counting) {
+	PriorityQueue * queue = (PriorityQueue *)malloc(sizeof(PriorityQueue));
+	*queue = PriorityQueue_NewDense(counting ? CountingFloatCompare : FloatCompare, NULL, trace->n_keys, PQ_DEFAULT_ARITY);
+	return queue;
+}
+
+static void * PQ_NewMinMax(const DijkstraTrace * const trace, const int counting) {
+	PriorityQueue * queue = (PriorityQueue *)malloc(sizeof(PriorityQueue));
+	*queue = PriorityQueue_NewMinMax(counting ? CountingIntCompare : IntCompare, counting ? CountingFloatCompare : FloatCompare, NULL);
+	return queue;
+}
+
+static void PQ_Push(void * const queue, const unsigned int id, const float priority) {
+	PriorityQueue_Insert((PriorityQueue *)queue, (Data_t)id, priority);
+}
+
+static void PQ_Decrease(void * const queue, const unsigned int id, const float priority) {
+	if (PriorityQueue_SetPriority((PriorityQueue *)queue, (Data_t)id, priority) != PQ_SUCCESS) {
+		PriorityQueue_Insert((PriorityQueue *)queue, (Data_t)id, priority);
+	}
+}
+
+static void PQ_Pop(void * const queue) {
+	Data_t data;
+	Priority_t priority;
+	PriorityQueue_PopMin((PriorityQueue *)queue, &data, &priority);
+}
+
+static size_t PQ_Allocation(const void * const queue) {
+	return PriorityQueue_Allocation((const PriorityQueue *)queue);
+}
+
+static void PQ_Free(void * const queue) {
+	PriorityQueue_Free((PriorityQueue *)queue);
+	free(queue);
+}
+
+// Generic int/float heap
+static void * Generic_New(const DijkstraTrace * const trace, const int counting) {
+	PQIntFloat * queue = (PQIntFloat *)malloc(sizeof(PQIntFloat));
+	*queue = PQIntFloat_New();
+	return queue;
+}
+
+static void Generic_Push(void * const queue, const unsigned int id, const float priority) {
+	PQIntFloat_Insert((PQIntFloat *)queue, (int)id, priority);
+}
+
+static void Generic_Decrease(void * const queue, const unsigned int id, const float priority) {
+	if (PQIntFloat_SetPriority((PQIntFloat *)queue, (int)id, priority) != PQ_SUCCESS) {
+		PQIntFloat_Insert((PQIntFloat *)queue, (int)id, priority);
+	}
+}
+
+static void Generic_Pop(void * const queue) {
+	int data;
+	float priority;
+	PQIntFloat_PopMin((PQIntFloat *)queue, &data, &priority);
+}
+
+static size_t Generic_Allocation(const void * const queue) {
+	const PQIntFloat * generic = (const PQIntFloat *)queue;
+	return generic->heap_capacity * (sizeof(PQIntFloat_Pair) + sizeof(unsigned int))
+		+ generic->index_capacity * (sizeof(int) + sizeof(unsigned int));
+}
+
+static void Generic_Free(void * const queue) {
+	PQIntFloat_Free((PQIntFloat *)queue);
+	free(queue);
+}
+
+// Radix heap
+static void * Radix_New(const DijkstraTrace * const trace, const int counting) {
+	RadixHeap * heap = (RadixHeap *)malloc(sizeof(RadixHeap));
+	*heap = RadixHeap_New(trace->n_keys);
+	return heap;
+}
+
+static void Radix_Push(void * const heap, const unsigned int id, const float priority) {
+	RadixHeap_Push((RadixHeap *)heap, id, priority);
+}
+
+static void Radix_Decrease(void * const heap, const unsigned int id, const float priority) {
+	if (RadixHeap_Decrease((RadixHeap *)heap, id, priority) == PQ_ERROR_KEY_DOES_NOT_EXIST) {
+		RadixHeap_Push((RadixHeap *)heap, id, priority);
+	}
+}
+
+static void Radix_Pop(void * const heap) {
+	unsigned int id;
+	float priority;
+	RadixHeap_PopMin((RadixHeap *)heap, &id, &priority);
+}
+
+static size_t Radix_Allocation(const void * const heap) {
+	return RadixHeap_Allocation((const RadixHeap *)heap);
+}
+
+static void Radix_Free(void * const heap) {
+	RadixHeap_Free((RadixHeap *)heap);
+	free(heap);
+}
+
+// Bucket queue over the priorities quantized by PQBENCH_QUANTIZATION_STEP
+static inline unsigned int Quantize(const float priority) {
+	return (unsigned int)(priority / PQBENCH_QUANTIZATION_STEP + 0.5f);
+}
+
+static void * Bucket_New(const DijkstraTrace * const trace, const int counting) {
+	// The window must cover the furthest any update reaches past the last pop
+	unsigned int last = 0, max_step = 0;
+	for (unsigned int i = 0; i < trace->n_entries; i++) {
+		unsigned int q = Quantize(trace->entries[i].priority);
+		if (trace->entries[i].op == DIJKSTRA_TRACE_POP) last = q;
+		else if (q > last && q - last > max_step) max_step = q - last;
+	}
+	BucketQueue * queue = (BucketQueue *)malloc(sizeof(BucketQueue));
+	*queue = BucketQueue_New(trace->n_keys, max_step);
+	return queue;
+}
+
+static void Bucket_Push(void * const queue, const unsigned int id, const float priority) {
+	BucketQueue_Push((BucketQueue *)queue, id, Quantize(priority));
+}
+
+static void Bucket_Decrease(void * const queue, const unsigned int id, const float priority) {
+	if (BucketQueue_Decrease((BucketQueue *)queue, id, Quantize(priority)) == PQ_ERROR_KEY_DOES_NOT_EXIST) {
+		BucketQueue_Push((BucketQueue *)queue, id, Quantize(priority));
+	}
+}
+
+static void Bucket_Pop(void * const queue) {
+	unsigned int id;
+	unsigned long long priority;
+	BucketQueue_PopMin((BucketQueue *)queue, &id, &priority);
+}
+
+static size_t Bucket_Allocation(const void * const queue) {
+	return BucketQueue_Allocation((const BucketQueue *)queue);
+}
+
+static void Bucket_Free(void * const queue) {
+	BucketQueue_Free((BucketQueue *)queue);
+	free(queue);
+}
+
+// Lazy heap, with the current priority and popped flag it needs for staleness
+typedef struct LazyBench {
+	LazyHeap heap;
+	float * current;
+	unsigned char * popped;
+} LazyBench;
+
+static int Lazy_IsStale(const void * context, const unsigned int id, const float priority) {
+	const LazyBench * bench = (const LazyBench *)context;
+	return bench->popped[id] || priority > bench->current[id];
+}
+
+static void * Lazy_New(const DijkstraTrace * const trace, const int counting) {
+	LazyBench * bench = (LazyBench *)calloc(1, sizeof(LazyBench));
+	bench->heap = LazyHeap_New(Lazy_IsStale, bench);
+	bench->current = (float *)malloc(trace->n_keys * sizeof(float));
+	bench->popped = (unsigned char *)calloc(trace->n_keys, 1);
+	return bench;
+}
+
+static void Lazy_Push(void * const queue, const unsigned int id, const float priority) {
+	LazyBench * bench = (LazyBench *)queue;
+	bench->current[id] = priority;
+	bench->popped[id] = 0;
+	LazyHeap_Push(&bench->heap, id, priority);
+}
+
+static void Lazy_Decrease(void * const queue, const unsigned int id, const float priority) {
+	LazyBench * bench = (LazyBench *)queue;
+	if (bench->popped[id]) {
+		Lazy_Push(queue, id, priority);
+		return;
+	}
+	bench->current[id] = priority;
+	LazyHeap_Decrease(&bench->heap, id, priority);
+}
+
+static void Lazy_Pop(void * const queue) {
+	LazyBench * bench = (LazyBench *)queue;
+	unsigned int id;
+	float priority;
+	if (LazyHeap_PopMin(&bench->heap, &id, &priority) == PQ_SUCCESS) bench->popped[id] = 1;
+}
+
+static size_t Lazy_Allocation(const void * const queue) {
+	return LazyHeap_Allocation(&((const LazyBench *)queue)->heap);
+}
+
+static void Lazy_Free(void * const queue) {
+	LazyBench * bench = (LazyBench *)queue;
+	LazyHeap_Free(&bench->heap);
+	free(bench->current);
+	free(bench->popped);
+	free(bench);
+}
+
+static const Backend BACKENDS[] = {
+	{"tree", PQ_NewTree, PQ_Push, PQ_Decrease, PQ_Pop, PQ_Allocation, PQ_Free, 1},
+	{"balanced", PQ_NewBalanced, PQ_Push, PQ_Decrease, PQ_Pop, PQ_Allocation, PQ_Free, 1},
+	{"heap", PQ_NewHeap, PQ_Push, PQ_Decrease, PQ_Pop, PQ_Allocation, PQ_Free, 1},
+	{"dense", PQ_NewDense, PQ_Push, PQ_Decrease, PQ_Pop, PQ_Allocation, PQ_Free, 1},
+	{"minmax", PQ_NewMinMax, PQ_Push, PQ_Decrease, PQ_Pop, PQ_Allocation, PQ_Free, 1},
+	{"generic", Generic_New, Generic_Push, Generic_Decrease, Generic_Pop, Generic_Allocation, Generic_Free, 0},
+	{"radix", Radix_New, Radix_Push, Radix_Decrease, Radix_Pop, Radix_Allocation, Radix_Free, 0},
+	{"bucket", Bucket_New, Bucket_Push, Bucket_Decrease, Bucket_Pop, Bucket_Allocation, Bucket_Free, 0},
+	{"lazy", Lazy_New, Lazy_Push, Lazy_Decrease, Lazy_Pop, Lazy_Allocation, Lazy_Free, 0}
+};
+
+/******************************************************************************
+ * Replay
+ */
+static void Replay(const Backend * const backend, void * const queue, const DijkstraTrace * const trace, size_t * const peak) {
+	for (unsigned int i = 0; i < trace->n_entries; i++) {
+		const DijkstraTraceEntry * entry = trace->entries + i;
+		switch (entry->op) {
+		case DIJKSTRA_TRACE_PUSH:
+			backend->Push(queue, entry->id, entry->priority);
+			break;
+		case DIJKSTRA_TRACE_DECREASE:
+			backend->Decrease(queue, entry->id, entry->priority);
+			break;
+		default:
+			backend->Pop(queue);
+			break;
+		}
+		if (peak) {
+			size_t allocation = backend->Allocation(queue);
+			if (allocation > *peak) *peak = allocation;
+		}
+	}
+}
+
+static void Benchmark(const char * name, const DijkstraTrace * const trace) {
+	printf("\n%s: %u keys, %u ops\n", name, trace->n_keys, trace->n_entries);
+	printf("%-10s %10s %10s %10s\n", "backend", "ns/op", "peak KiB", "cmp/op");
+	if (trace->n_entries == 0) return;
+	for (unsigned int b = 0; b < sizeof(BACKENDS) / sizeof(Backend); b++) {
+		const Backend * backend = BACKENDS + b;
+
+		double best = INFINITY;
+		for (int repeat = 0; repeat < PQBENCH_REPEATS; repeat++) {
+			void * queue = backend->New(trace, 0);
+			double start = Now();
+			Replay(backend, queue, trace, NULL);
+			double elapsed = Now() - start;
+			backend->Free(queue);
+			if (elapsed < best) best = elapsed;
+		}
+
+		// Count comparisons and memory on an untimed replay
+		size_t peak = 0;
+		n_comparisons = 0;
+		void * queue = backend->New(trace, 1);
+		Replay(backend, queue, trace, &peak);
+		backend->Free(queue);
+
+		printf("%-10s %10.1f %10.1f ", backend->name, best * 1e9 / trace->n_entries, peak / 1024.0);
+		if (backend->compares) printf("%10.2f\n", (double)n_comparisons / trace->n_entries);
+		else printf("%10s\n", "-");
+	}
+}
+
+int main(int argc, char ** argv) {
+	const char * dump = NULL;
+	int first_file = 1;
+	if (argc > 2 && strcmp(argv[1], "--dump") == 0) {
+		dump = argv[2];
+		first_file = 3;
+	}
+
+	srand(1);
+	unsigned int n_cons;
+	Connection * grid = Graph_Grid(PQBENCH_GRID_SIDE, &n_cons);
+	DijkstraTrace grid_trace = Capture(grid, n_cons, PQBENCH_GRID_SIDE * PQBENCH_GRID_SIDE - 1);
+	free(grid);
+
+	Connection * geometric = Graph_Geometric(PQBENCH_GEOMETRIC_NODES, &n_cons);
+	DijkstraTrace geometric_trace = Capture(geometric, n_cons, PQBENCH_GEOMETRIC_NODES - 1);
+	free(geometric);
+
+	if (dump) {
+		char path[4096];
+		snprintf(path, sizeof(path), "%s/grid.trace", dump);
+		if (DijkstraTrace_Write(&grid_trace, path) != 0) printf("Could not write %s\n", path);
+		snprintf(path, sizeof(path), "%s/geometric.trace", dump);
+		if (DijkstraTrace_Write(&geometric_trace, path) != 0) printf("Could not write %s\n", path);
+	}
+
+	Benchmark("grid", &grid_trace);
+	Benchmark("geometric", &geometric_trace);
+	DijkstraTrace_Free(&grid_trace);
+	DijkstraTrace_Free(&geometric_trace);
+
+	for (int i = first_file; i < argc; i++) {
+		DijkstraTrace trace;
+		if (DijkstraTrace_Read(&trace, argv[i]) != 0) {
+			printf("\nCould not read trace %s\n", argv[i]);
+			continue;
+		}
+		Benchmark(argv[i], &trace);
+		DijkstraTrace_Free(&trace);
+	}
+	return 0;
+}
@@ -0,0 +1,270 @@
+/******************************************************************************
+ * Header-only generic Priority Queue.
+ */
+
+#pragma once
+
+#include <memory.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "priorityqueue.h"
+
+/******************************************************************************
+ * PQ_GENERIC_DEFINE(NAME, KEY_T, PRIORITY_T) instantiates a d-ary min-heap
+ * with a hashed position index, like PQ_BACKEND_HEAP, for one key and
+ * priority type. Every function is static inline and compares with macros
+ * instead of calling through DataCompareFunc and PriorityCompareFunc, so
+ * comparisons and hashing inline into the sift loops. Keys must be integers.
+ *
+ * For other types, PQ_GENERIC_DEFINE_WITH(NAME, KEY_T, PRIORITY_T, HASH,
+ * EQUAL, LESS) takes the names of function-like macros: HASH(key) gives an
+ * unsigned int, EQUAL(left, right) compares keys and LESS(left, right)
+ * orders priorities. They apply to that instantiation only; for example
+ *	#define EDGE_HASH(key) PQ_GENERIC_INT_HASH((key).id)
+ *	#define EDGE_EQUAL(left, right) ((left).id == (right).id)
+ *	PQ_GENERIC_DEFINE_WITH(PQEdge, EdgeKey, float, EDGE_HASH, EDGE_EQUAL, PQ_GENERIC_LESS)
+ *
+ * An instantiation NAME provides the types NAME and NAME##_Pair and:
+ *	 -	NAME##_New, NAME##_Free, NAME##_Clear, NAME##_Reserve
+ *	 -	NAME##_Insert, NAME##_Remove, NAME##_GetPriority, NAME##_SetPriority
+ *	 -	NAME##_PopMin, NAME##_PopMax (O(n), scans the leaves)
+ * which behave as their PriorityQueue counterparts. They return the
+ * PQ_GENERIC_ codes below, which have the values of the PQError codes but
+ * are constants, so the header needs nothing from priorityqueue.c.
+ *
+ * This header instantiates PQIntFloat (int/float, the PriorityQueue
+ * defaults), PQU32Double (uint32_t/double) and PQU64U32 (uint64_t/uint32_t,
+ * for 64-bit OSM ids).
+ */
+
+#ifndef PQ_GENERIC_ARITY
+#define PQ_GENERIC_ARITY 4
+#endif
+
+#define PQ_GENERIC_LESS(left, right) ((left) < (right))
+#define PQ_GENERIC_EQUAL(left, right) ((left) == (right))
+// Fibonacci hashing of the key's 64-bit value; the index takes the low bits
+#define PQ_GENERIC_INT_HASH(key) ((unsigned int)(((uint64_t)(key) * 0x9e3779b97f4a7c15ull) >> 32))
+
+#define PQ_GENERIC_MIN_CAPACITY 16
+
+#define PQ_GENERIC_SUCCESS 0
+#define PQ_GENERIC_ERROR_KEY_DOES_NOT_EXIST (-2)
+#define PQ_GENERIC_ERROR_KEY_ALREADY_EXISTS (-3)
+#define PQ_GENERIC_ERROR_EMPTY_QUEUE (-4)
+
+#define PQ_GENERIC_DEFINE(NAME, KEY_T, PRIORITY_T) \
+	PQ_GENERIC_DEFINE_WITH(NAME, KEY_T, PRIORITY_T, PQ_GENERIC_INT_HASH, PQ_GENERIC_EQUAL, PQ_GENERIC_LESS)
+
+#define PQ_GENERIC_DEFINE_WITH(NAME, KEY_T, PRIORITY_T, HASH, EQUAL, LESS)									\
+																											\
+typedef struct NAME##_Pair {																				\
+	KEY_T data;																								\
+	PRIORITY_T priority;																					\
+} NAME##_Pair;																								\
+																											\
+typedef struct NAME {																						\
+	NAME##_Pair * heap;																						\
+	unsigned int * heap_slots;																				\
+	unsigned int heap_capacity;																				\
+	KEY_T * keys;																							\
+	unsigned int * positions;																				\
+	unsigned int index_capacity;																			\
+	unsigned int n_data;																					\
+} NAME;																										\
+																											\
+/* Returns the bucket holding data, or the empty bucket where it would go */								\
+static inline unsigned int NAME##_Find(const NAME * const queue, const KEY_T data) {						\
+	unsigned int mask = queue->index_capacity - 1;															\
+	unsigned int bucket = HASH(data) & mask;																\
+	while (queue->positions[bucket] != PQ_NO_POSITION) {													\
+		if (EQUAL(data, queue->keys[bucket])) break;														\
+		bucket = (bucket + 1) & mask;																		\
+	}																										\
+	return bucket;																							\
+}																											\
+																											\
+static inline void NAME##_Place(NAME * const queue, const unsigned int position, const NAME##_Pair pair, const unsigned int slot) { \
+	queue->heap[position] = pair;																			\
+	queue->heap_slots[position] = slot;																		\
+	queue->positions[slot] = position;																		\
+}																											\
+																											\
+static inline void NAME##_SiftUp(NAME * const queue, unsigned int position) {								\
+	NAME##_Pair pair = queue->heap[position];																\
+	unsigned int slot = queue->heap_slots[position];														\
+	while (position > 0) {																					\
+		unsigned int parent = (position - 1) / PQ_GENERIC_ARITY;											\
+		if (!LESS(pair.priority, queue->heap[parent].priority)) break;										\
+		NAME##_Place(queue, position, queue->heap[parent], queue->heap_slots[parent]);						\
+		position = parent;																					\
+	}																										\
+	NAME##_Place(queue, position, pair, slot);																\
+}																											\
+																											\
+static inline void NAME##_SiftDown(NAME * const queue, unsigned int position) {								\
+	NAME##_Pair pair = queue->heap[position];																\
+	unsigned int slot = queue->heap_slots[position];														\
+	while (1) {																								\
+		unsigned int first = position * PQ_GENERIC_ARITY + 1;												\
+		if (first >= queue->n_data) break;																	\
+		unsigned int last = first + PQ_GENERIC_ARITY;														\
+		if (last > queue->n_data) last = queue->n_data;														\
+		unsigned int best = first;																			\
+		for (unsigned int child = first + 1; child < last; child++) {										\
+			if (LESS(queue->heap[child].priority, queue->heap[best].priority)) best = child;				\
+		}																									\
+		if (!LESS(queue->heap[best].priority, pair.priority)) break;										\
+		NAME##_Place(queue, position, queue->heap[best], queue->heap_slots[best]);							\
+		position = best;																					\
+	}																										\
+	NAME##_Place(queue, position, pair, slot);																\
+}																											\
+																											\
+static inline void NAME##_Erase(NAME * const queue, unsigned int bucket) {									\
+	/* Backward-shift deletion, as in pqheap.c */															\
+	unsigned int mask = queue->index_capacity - 1;															\
+	unsigned int next = bucket;																				\
+	queue->positions[bucket] = PQ_NO_POSITION;																\
+	while (1) {																								\
+		next = (next + 1) & mask;																			\
+		if (queue->positions[next] == PQ_NO_POSITION) break;												\
+		unsigned int home = HASH(queue->keys[next]) & mask;													\
+		if (bucket <= next ? (bucket < home && home <= next) : (bucket < home || home <= next)) continue;	\
+		queue->keys[bucket] = queue->keys[next];															\
+		queue->positions[bucket] = queue->positions[next];													\
+		queue->heap_slots[queue->positions[bucket]] = bucket;												\
+		queue->positions[next] = PQ_NO_POSITION;															\
+		bucket = next;																						\
+	}																										\
+}																											\
+																											\
+static inline void NAME##_RemoveAt(NAME * const queue, const unsigned int position) {						\
+	NAME##_Erase(queue, queue->heap_slots[position]);														\
+	queue->n_data--;																						\
+	if (position == queue->n_data) return;																	\
+	PRIORITY_T removed = queue->heap[position].priority;													\
+	NAME##_Place(queue, position, queue->heap[queue->n_data], queue->heap_slots[queue->n_data]);			\
+	if (LESS(queue->heap[position].priority, removed)) NAME##_SiftUp(queue, position);						\
+	else NAME##_SiftDown(queue, position);																	\
+}																											\
+																											\
+static inline NAME NAME##_New(void) {																		\
+	NAME queue;																								\
+	memset(&queue, 0, sizeof(NAME));																		\
+	queue.index_capacity = PQ_GENERIC_MIN_CAPACITY;															\
+	queue.keys = (KEY_T *)malloc(queue.index_capacity * sizeof(KEY_T));										\
+	queue.positions = (unsigned int *)malloc(queue.index_capacity * sizeof(unsigned int));					\
+	memset(queue.positions, 0xff, queue.index_capacity * sizeof(unsigned int));								\
+	return queue;																							\
+}																											\
+																											\
+static inline void NAME##_Reserve(NAME * const queue, const unsigned int n_data) {							\
+	if (n_data > queue->heap_capacity) {																	\
+		queue->heap = (NAME##_Pair *)realloc(queue->heap, n_data * sizeof(NAME##_Pair));					\
+		queue->heap_slots = (unsigned int *)realloc(queue->heap_slots, n_data * sizeof(unsigned int));		\
+		queue->heap_capacity = n_data;																		\
+	}																										\
+	/* Keep the index at most half full, re-hashing into a larger table */									\
+	unsigned int capacity = queue->index_capacity;															\
+	while (capacity < 2 * n_data) capacity <<= 1;															\
+	if (capacity == queue->index_capacity) return;															\
+	KEY_T * old_keys = queue->keys;																			\
+	unsigned int * old_positions = queue->positions;														\
+	unsigned int old_capacity = queue->index_capacity;														\
+	queue->index_capacity = capacity;																		\
+	queue->keys = (KEY_T *)malloc(capacity * sizeof(KEY_T));												\
+	queue->positions = (unsigned int *)malloc(capacity * sizeof(unsigned int));								\
+	memset(queue->positions, 0xff, capacity * sizeof(unsigned int));										\
+	for (unsigned int i = 0; i < old_capacity; i++) {														\
+		if (old_positions[i] == PQ_NO_POSITION) continue;													\
+		unsigned int bucket = NAME##_Find(queue, old_keys[i]);												\
+		queue->keys[bucket] = old_keys[i];																	\
+		queue->positions[bucket] = old_positions[i];														\
+		queue->heap_slots[old_positions[i]] = bucket;														\
+	}																										\
+	free(old_keys);																							\
+	free(old_positions);																					\
+}																											\
+																											\
+static inline void NAME##_Clear(NAME * const queue) {														\
+	for (unsigned int i = 0; i < queue->n_data; i++) queue->positions[queue->heap_slots[i]] = PQ_NO_POSITION; \
+	queue->n_data = 0;																						\
+}																											\
+																											\
+static inline void NAME##_Free(NAME * const queue) {														\
+	free(queue->heap);																						\
+	free(queue->heap_slots);																				\
+	free(queue->keys);																						\
+	free(queue->positions);																					\
+	memset(queue, 0, sizeof(NAME));																			\
+}																											\
+																											\
+static inline int NAME##_Insert(NAME * const queue, const KEY_T data, const PRIORITY_T priority) {			\
+	/* Look for the key first, so that a duplicate does not grow the queue */								\
+	unsigned int slot = NAME##_Find(queue, data);															\
+	if (queue->positions[slot] != PQ_NO_POSITION) return PQ_GENERIC_ERROR_KEY_ALREADY_EXISTS;				\
+	if (queue->n_data == queue->heap_capacity || 2 * (queue->n_data + 1) > queue->index_capacity) {			\
+		NAME##_Reserve(queue, queue->heap_capacity ? queue->heap_capacity * 2 : PQ_GENERIC_MIN_CAPACITY);	\
+		slot = NAME##_Find(queue, data);																	\
+	}																										\
+	queue->keys[slot] = data;																				\
+	unsigned int position = queue->n_data++;																\
+	queue->heap[position].data = data;																		\
+	queue->heap[position].priority = priority;																\
+	queue->heap_slots[position] = slot;																		\
+	NAME##_SiftUp(queue, position);																			\
+	return PQ_GENERIC_SUCCESS;																				\
+}																											\
+																											\
+static inline int NAME##_Remove(NAME * const queue, const KEY_T data) {										\
+	unsigned int position = queue->positions[NAME##_Find(queue, data)];										\
+	if (position == PQ_NO_POSITION) return PQ_GENERIC_ERROR_KEY_DOES_NOT_EXIST;								\
+	NAME##_RemoveAt(queue, position);																		\
+	return PQ_GENERIC_SUCCESS;																				\
+}																											\
+																											\
+static inline int NAME##_GetPriority(const NAME * const queue, const KEY_T data, PRIORITY_T * const out_priority) { \
+	unsigned int position = queue->positions[NAME##_Find(queue, data)];										\
+	if (position == PQ_NO_POSITION) return PQ_GENERIC_ERROR_KEY_DOES_NOT_EXIST;								\
+	*out_priority = queue->heap[position].priority;															\
+	return PQ_GENERIC_SUCCESS;																				\
+}																											\
+																											\
+static inline int NAME##_SetPriority(NAME * const queue, const KEY_T data, const PRIORITY_T priority) {		\
+	unsigned int position = queue->positions[NAME##_Find(queue, data)];										\
+	if (position == PQ_NO_POSITION) return PQ_GENERIC_ERROR_KEY_DOES_NOT_EXIST;								\
+	PRIORITY_T old = queue->heap[position].priority;														\
+	queue->heap[position].priority = priority;																\
+	if (LESS(priority, old)) NAME##_SiftUp(queue, position);												\
+	else if (LESS(old, priority)) NAME##_SiftDown(queue, position);											\
+	return PQ_GENERIC_SUCCESS;																				\
+}																											\
+																											\
+static inline int NAME##_PopMin(NAME * const queue, KEY_T * const out_data, PRIORITY_T * const out_priority) { \
+	if (queue->n_data == 0) return PQ_GENERIC_ERROR_EMPTY_QUEUE;											\
+	*out_data = queue->heap[0].data;																		\
+	*out_priority = queue->heap[0].priority;																\
+	NAME##_RemoveAt(queue, 0);																				\
+	return PQ_GENERIC_SUCCESS;																				\
+}																											\
+																											\
+static inline int NAME##_PopMax(NAME * const queue, KEY_T * const out_data, PRIORITY_T * const out_priority) { \
+	if (queue->n_data == 0) return PQ_GENERIC_ERROR_EMPTY_QUEUE;											\
+	unsigned int best = (queue->n_data - 1) / PQ_GENERIC_ARITY;												\
+	for (unsigned int i = best + 1; i < queue->n_data; i++) {												\
+		if (LESS(queue->heap[best].priority, queue->heap[i].priority)) best = i;							\
+	}																										\
+	*out_data = queue->heap[best].data;																		\
+	*out_priority = queue->heap[best].priority;																\
+	NAME##_RemoveAt(queue, best);																			\
+	return PQ_GENERIC_SUCCESS;																				\
+}
+
+/******************************************************************************
+ * Instantiations
+ */
+PQ_GENERIC_DEFINE(PQIntFloat, int, float)
+PQ_GENERIC_DEFINE(PQU32Double, uint32_t, double)
+PQ_GENERIC_DEFINE(PQU64U32, uint64_t, uint32_t)
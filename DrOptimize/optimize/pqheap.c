@@ -0,0 +1,457 @@
+/******************************************************************************
+ * Heap backend of the Priority Queue: a flat d-ary min-heap of Pairs with a
+ * position index from data to heap slot. The index is a hash table, or in
+ * dense mode a direct-address array with one slot per key of the universe.
+ *
+ * NOTES:
+ *	 -	Pairs are stored inline in the heap array; free_pair sees them just
+ *		before they are overwritten.
+ *	 -	The heap array and the index grow by doubling. Use
+ *		PriorityQueue_Reserve to size them up front and avoid any allocation
+ *		during Insert.
+ *	 -	PopMax scans the leaves of the heap and is therefore O(n), except in
+ *		the min-max layout (pqminmax.c), which reorders the same array so that
+ *		both ends are O(log n). Sifting defers to it for that backend.
+ */
+
+#include <limits.h>
+#include <math.h>
+#include <memory.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pqbackend.h"
+
+#define PQ_INDEX_MIN_CAPACITY 16
+
+/******************************************************************************
+ * Position Index
+ */
+static int PQIndex_DenseCompare(Data_t left, Data_t right) {
+	return (left > right) - (left < right);
+}
+
+static inline int PQIndex_Dense(const PriorityQueue * const queue) {
+	return queue->index.keys == NULL;
+}
+
+// Dense keys must lie in [0, universe)
+static inline int PQIndex_Valid(const PriorityQueue * const queue, const Data_t data) {
+	return !PQIndex_Dense(queue) || (unsigned int)data < queue->index.capacity;
+}
+
+static unsigned int PQIndex_Hash(const Data_t data) {
+	// FNV-1a over the bytes of the key, followed by a final avalanche
+	const unsigned char * bytes = (const unsigned char *)&data;
+	unsigned int hash = 2166136261u;
+	for (unsigned int i = 0; i < sizeof(Data_t); i++) {
+		hash ^= bytes[i];
+		hash *= 16777619u;
+	}
+	hash ^= hash >> 16;
+	hash *= 0x45d9f3bu;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+// Returns the bucket holding data, or the empty bucket where it would go
+static unsigned int PQIndex_Find(const PriorityQueue * const queue, const Data_t data) {
+	if (PQIndex_Dense(queue)) return (unsigned int)data;
+	const PQIndex * index = &queue->index;
+	unsigned int mask = index->capacity - 1;
+	unsigned int bucket = PQIndex_Hash(data) & mask;
+	while (index->positions[bucket] != PQ_NO_POSITION) {
+		if (PriorityQueue_CompareData(queue, data, index->keys[bucket]) == 0) break;
+		bucket = (bucket + 1) & mask;
+	}
+	return bucket;
+}
+
+static void PQIndex_Resize(PriorityQueue * const queue, const unsigned int capacity) {
+	PQ_COUNT(queue, n_allocations);
+	PQIndex old = queue->index;
+	queue->index.capacity = capacity;
+	queue->index.keys = (Data_t *)malloc(capacity * sizeof(Data_t));
+	queue->index.positions = (unsigned int *)malloc(capacity * sizeof(unsigned int));
+	memset(queue->index.positions, 0xff, capacity * sizeof(unsigned int));
+
+	// Re-hash every key and point its heap entry at the new bucket
+	for (unsigned int i = 0; i < old.capacity; i++) {
+		if (old.positions[i] == PQ_NO_POSITION) continue;
+		unsigned int bucket = PQIndex_Find(queue, old.keys[i]);
+		queue->index.keys[bucket] = old.keys[i];
+		queue->index.positions[bucket] = old.positions[i];
+		queue->heap_slots[old.positions[i]] = bucket;
+	}
+	free(old.keys);
+	free(old.positions);
+}
+
+static inline void PQIndex_Claim(PriorityQueue * const queue, const unsigned int bucket, const Data_t data) {
+	if (!PQIndex_Dense(queue)) queue->index.keys[bucket] = data;
+	queue->index.n_keys++;
+}
+
+static void PQIndex_Erase(PriorityQueue * const queue, unsigned int bucket) {
+	PQIndex * index = &queue->index;
+	index->positions[bucket] = PQ_NO_POSITION;
+	if (PQIndex_Dense(queue)) {
+		index->n_keys--;
+		return;
+	}
+
+	// Backward-shift deletion keeps probe sequences intact without tombstones
+	unsigned int mask = index->capacity - 1;
+	unsigned int next = bucket;
+	while (1) {
+		next = (next + 1) & mask;
+		if (index->positions[next] == PQ_NO_POSITION) break;
+		unsigned int home = PQIndex_Hash(index->keys[next]) & mask;
+		// Leave the entry alone if its home lies cyclically in (bucket, next]
+		if (bucket <= next ? (bucket < home && home <= next) : (bucket < home || home <= next)) continue;
+		index->keys[bucket] = index->keys[next];
+		index->positions[bucket] = index->positions[next];
+		queue->heap_slots[index->positions[bucket]] = bucket;
+		index->positions[next] = PQ_NO_POSITION;
+		bucket = next;
+	}
+	index->n_keys--;
+}
+
+/******************************************************************************
+ * Sifting
+ */
+static void PQHeap_SiftUp(PriorityQueue * const queue, unsigned int position) {
+	if (queue->backend == PQ_BACKEND_MINMAX_HEAP) {
+		PQMinMax_BubbleUp(queue, position);
+		return;
+	}
+	Pair pair = queue->heap[position];
+	unsigned int slot = queue->heap_slots[position];
+	while (position > 0) {
+		PQ_COUNT(queue, n_node_visits);
+		unsigned int parent = (position - 1) / queue->arity;
+		if (PriorityQueue_ComparePriority(queue, pair.priority, queue->heap[parent].priority) >= 0) break;
+		PQHeap_Place(queue, position, queue->heap[parent], queue->heap_slots[parent]);
+		position = parent;
+	}
+	PQHeap_Place(queue, position, pair, slot);
+}
+
+static void PQHeap_SiftDown(PriorityQueue * const queue, unsigned int position) {
+	if (queue->backend == PQ_BACKEND_MINMAX_HEAP) {
+		PQMinMax_TrickleDown(queue, position);
+		return;
+	}
+	Pair pair = queue->heap[position];
+	unsigned int slot = queue->heap_slots[position];
+	while (1) {
+		PQ_COUNT(queue, n_node_visits);
+		// Find the smallest child
+		unsigned int first = position * queue->arity + 1;
+		if (first >= queue->n_data) break;
+		unsigned int last = first + queue->arity;
+		if (last > queue->n_data) last = queue->n_data;
+		unsigned int best = first;
+		for (unsigned int child = first + 1; child < last; child++) {
+			if (PriorityQueue_ComparePriority(queue, queue->heap[child].priority, queue->heap[best].priority) < 0) best = child;
+		}
+		if (PriorityQueue_ComparePriority(queue, queue->heap[best].priority, pair.priority) >= 0) break;
+		PQHeap_Place(queue, position, queue->heap[best], queue->heap_slots[best]);
+		position = best;
+	}
+	PQHeap_Place(queue, position, pair, slot);
+}
+
+// Removes the entry at position and restores the heap property
+static void PQHeap_RemoveAt(PriorityQueue * const queue, const unsigned int position) {
+	if (queue->free_pair) queue->free_pair(queue->heap + position);
+	PQIndex_Erase(queue, queue->heap_slots[position]);
+	queue->n_data--;
+	if (position == queue->n_data) return;
+
+	// Move the last entry into the hole
+	Priority_t removed = queue->heap[position].priority;
+	PQHeap_Place(queue, position, queue->heap[queue->n_data], queue->heap_slots[queue->n_data]);
+	if (queue->backend == PQ_BACKEND_MINMAX_HEAP) PQMinMax_Fix(queue, position);
+	else if (PriorityQueue_ComparePriority(queue, queue->heap[position].priority, removed) < 0) PQHeap_SiftUp(queue, position);
+	else PQHeap_SiftDown(queue, position);
+}
+
+/******************************************************************************
+ * Initialization
+ */
+PriorityQueue PriorityQueue_NewHeap(DataCompareFunc data_compare, PriorityCompareFunc priority_compare, FreePairFunc free_pair, const unsigned int arity) {
+	PriorityQueue queue;
+	memset(&queue, 0, sizeof(PriorityQueue));
+
+	queue.backend = PQ_BACKEND_HEAP;
+	queue.arity = arity >= 2 ? arity : PQ_DEFAULT_ARITY;
+	queue.data_compare = data_compare;
+	queue.priority_compare = priority_compare;
+	queue.free_pair = free_pair;
+
+	queue.index.capacity = PQ_INDEX_MIN_CAPACITY;
+	queue.index.keys = (Data_t *)malloc(queue.index.capacity * sizeof(Data_t));
+	queue.index.positions = (unsigned int *)malloc(queue.index.capacity * sizeof(unsigned int));
+	memset(queue.index.positions, 0xff, queue.index.capacity * sizeof(unsigned int));
+	PriorityQueue_AttachStats(&queue);
+
+	return queue;
+}
+
+/******************************************************************************
+ * A heap queue over the dense key universe [0, n_keys). The position index is
+ * a flat array, so lookups are a single load and never call a comparator.
+ * Data_t must be an integer type in this mode.
+ */
+PriorityQueue PriorityQueue_NewDense(PriorityCompareFunc priority_compare, FreePairFunc free_pair, const unsigned int n_keys, const unsigned int arity) {
+	PriorityQueue queue;
+	memset(&queue, 0, sizeof(PriorityQueue));
+
+	queue.backend = PQ_BACKEND_HEAP;
+	queue.arity = arity >= 2 ? arity : PQ_DEFAULT_ARITY;
+	queue.data_compare = PQIndex_DenseCompare;
+	queue.priority_compare = priority_compare;
+	queue.free_pair = free_pair;
+
+	queue.index.capacity = n_keys;
+	queue.index.positions = (unsigned int *)malloc(n_keys * sizeof(unsigned int));
+	memset(queue.index.positions, 0xff, n_keys * sizeof(unsigned int));
+	PriorityQueue_AttachStats(&queue);
+
+	return queue;
+}
+
+void PQHeap_Reserve(PriorityQueue * const queue, const unsigned int n_data) {
+	if (n_data > queue->heap_capacity) {
+		PQ_COUNT(queue, n_allocations);
+		queue->heap = (Pair *)realloc(queue->heap, n_data * sizeof(Pair));
+		queue->heap_slots = (unsigned int *)realloc(queue->heap_slots, n_data * sizeof(unsigned int));
+		queue->heap_capacity = n_data;
+	}
+
+	// Keep a hashed index at most half full
+	if (PQIndex_Dense(queue)) return;
+	unsigned int capacity = queue->index.capacity;
+	while (capacity < 2 * n_data) capacity <<= 1;
+	if (capacity != queue->index.capacity) PQIndex_Resize(queue, capacity);
+}
+
+void PQHeap_Clear(PriorityQueue * const queue) {
+	// Only the buckets in use need resetting
+	for (unsigned int i = 0; i < queue->n_data; i++) {
+		if (queue->free_pair) queue->free_pair(queue->heap + i);
+		queue->index.positions[queue->heap_slots[i]] = PQ_NO_POSITION;
+	}
+	queue->index.n_keys = 0;
+	queue->n_data = 0;
+}
+
+void PQHeap_Free(PriorityQueue * const queue) {
+	PQHeap_Clear(queue);
+	free(queue->heap);
+	free(queue->heap_slots);
+	free(queue->index.keys);
+	free(queue->index.positions);
+	queue->heap = NULL;
+	queue->heap_slots = NULL;
+	queue->index.keys = NULL;
+	queue->index.positions = NULL;
+	queue->heap_capacity = queue->index.capacity = queue->index.n_keys = 0;
+	queue->n_data = 0;
+}
+
+/******************************************************************************
+ * Insert and Remove
+ */
+PQError PQHeap_Insert(PriorityQueue * const queue, const Data_t data, const Priority_t priority) {
+	if (!PQIndex_Valid(queue, data)) return PQ_ERROR_KEY_OUT_OF_RANGE;
+	unsigned int slot = PQIndex_Find(queue, data);
+	if (queue->index.positions[slot] != PQ_NO_POSITION) return PQ_ERROR_KEY_ALREADY_EXISTS;
+
+	// Grow geometrically; re-find the bucket if the index was rebuilt
+	if (queue->n_data == queue->heap_capacity
+		|| (!PQIndex_Dense(queue) && 2 * (queue->index.n_keys + 1) > queue->index.capacity)) {
+		unsigned int capacity = queue->heap_capacity ? queue->heap_capacity * 2 : PQ_INDEX_MIN_CAPACITY;
+		unsigned int index_capacity = queue->index.capacity;
+		PQHeap_Reserve(queue, capacity);
+		if (queue->index.capacity != index_capacity) slot = PQIndex_Find(queue, data);
+	}
+
+	PQIndex_Claim(queue, slot, data);
+	unsigned int position = queue->n_data++;
+	queue->heap[position].data = data;
+	queue->heap[position].priority = priority;
+	queue->heap_slots[position] = slot;
+	queue->index.positions[slot] = position;
+	PQHeap_SiftUp(queue, position);
+
+	return PQ_SUCCESS;
+}
+
+PQError PQHeap_Remove(PriorityQueue * const queue, const Data_t data) {
+	if (!PQIndex_Valid(queue, data)) return PQ_ERROR_KEY_DOES_NOT_EXIST;
+	unsigned int position = queue->index.positions[PQIndex_Find(queue, data)];
+	if (position == PQ_NO_POSITION) return PQ_ERROR_KEY_DOES_NOT_EXIST;
+	PQHeap_RemoveAt(queue, position);
+	return PQ_SUCCESS;
+}
+
+/******************************************************************************
+ * Bulk Construction
+ */
+PQError PQHeap_Build(PriorityQueue * const queue, const Pair * const pairs, const unsigned int n) {
+	PQHeap_Reserve(queue, n);
+
+	// Fill the array and the index in input order
+	for (unsigned int i = 0; i < n; i++) {
+		if (!PQIndex_Valid(queue, pairs[i].data)) {
+			PQHeap_Clear(queue);
+			return PQ_ERROR_KEY_OUT_OF_RANGE;
+		}
+		unsigned int slot = PQIndex_Find(queue, pairs[i].data);
+		if (queue->index.positions[slot] != PQ_NO_POSITION) {
+			PQHeap_Clear(queue);
+			return PQ_ERROR_KEY_ALREADY_EXISTS;
+		}
+		PQIndex_Claim(queue, slot, pairs[i].data);
+		queue->heap[i] = pairs[i];
+		queue->heap_slots[i] = slot;
+		queue->index.positions[slot] = i;
+		queue->n_data++;
+	}
+
+	// Floyd's heapify, bottom-up from the last internal node
+	if (n > 1) {
+		for (unsigned int i = (n - 2) / queue->arity + 1; i-- > 0;) PQHeap_SiftDown(queue, i);
+	}
+	return PQ_SUCCESS;
+}
+
+// Appends the pairs and then restores the heap: by heapifying everything when
+// the batch outnumbers what was already queued, else by sifting each one up
+PQError PQHeap_InsertMany(PriorityQueue * const queue, const Pair * const pairs, const unsigned int n) {
+	PQHeap_Reserve(queue, queue->n_data + n);
+	unsigned int n_old = queue->n_data;
+	int err = PQ_SUCCESS;
+	for (unsigned int i = 0; i < n; i++) {
+		if (!PQIndex_Valid(queue, pairs[i].data)) {
+			err = PQ_ERROR_KEY_OUT_OF_RANGE;
+			continue;
+		}
+		unsigned int slot = PQIndex_Find(queue, pairs[i].data);
+		if (queue->index.positions[slot] != PQ_NO_POSITION) {
+			err = PQ_ERROR_KEY_ALREADY_EXISTS;
+			continue;
+		}
+		PQIndex_Claim(queue, slot, pairs[i].data);
+		PQHeap_Place(queue, queue->n_data++, pairs[i], slot);
+	}
+
+	unsigned int n_data = queue->n_data;
+	if (n_data - n_old > n_old) {
+		if (n_data > 1) {
+			for (unsigned int i = (n_data - 2) / queue->arity + 1; i-- > 0;) PQHeap_SiftDown(queue, i);
+		}
+	}
+	else {
+		for (unsigned int i = n_old; i < n_data; i++) PQHeap_SiftUp(queue, i);
+	}
+	return err;
+}
+
+/******************************************************************************
+ * Getting and Modifying Priority
+ */
+PQError PQHeap_GetPriority(const PriorityQueue * const queue, const Data_t data, Priority_t * const out_priority) {
+	if (!PQIndex_Valid(queue, data)) return PQ_ERROR_KEY_DOES_NOT_EXIST;
+	unsigned int position = queue->index.positions[PQIndex_Find(queue, data)];
+	if (position == PQ_NO_POSITION) return PQ_ERROR_KEY_DOES_NOT_EXIST;
+	*out_priority = queue->heap[position].priority;
+	return PQ_SUCCESS;
+}
+
+PQError PQHeap_SetPriority(PriorityQueue * const queue, const Data_t data, const Priority_t priority) {
+	if (!PQIndex_Valid(queue, data)) return PQ_ERROR_KEY_DOES_NOT_EXIST;
+	unsigned int position = queue->index.positions[PQIndex_Find(queue, data)];
+	if (position == PQ_NO_POSITION) return PQ_ERROR_KEY_DOES_NOT_EXIST;
+
+	// Sift in place in whichever direction the priority moved
+	int comp = PriorityQueue_ComparePriority(queue, priority, queue->heap[position].priority);
+	queue->heap[position].priority = priority;
+	if (queue->backend == PQ_BACKEND_MINMAX_HEAP) PQMinMax_Fix(queue, position);
+	else if (comp < 0) PQHeap_SiftUp(queue, position);
+	else if (comp > 0) PQHeap_SiftDown(queue, position);
+	return PQ_SUCCESS;
+}
+
+/******************************************************************************
+ * Pop Next
+ */
+PQError PQHeap_PopMin(PriorityQueue * const queue, Data_t * const out_data, Priority_t * const out_priority) {
+	if (queue->n_data == 0) return PQ_ERROR_EMPTY_QUEUE;
+	*out_data = queue->heap[0].data;
+	*out_priority = queue->heap[0].priority;
+	PQHeap_RemoveAt(queue, 0);
+	return PQ_SUCCESS;
+}
+
+PQError PQHeap_PopMax(PriorityQueue * const queue, Data_t * const out_data, Priority_t * const out_priority) {
+	if (queue->n_data == 0) return PQ_ERROR_EMPTY_QUEUE;
+
+	// The maximum is one of the leaves, or a child of the root in min-max order
+	unsigned int best;
+	if (queue->backend == PQ_BACKEND_MINMAX_HEAP) best = PQMinMax_MaxPosition(queue);
+	else {
+		best = (queue->n_data - 1) / queue->arity;
+		for (unsigned int i = best + 1; i < queue->n_data; i++) {
+			if (PriorityQueue_ComparePriority(queue, queue->heap[i].priority, queue->heap[best].priority) > 0) best = i;
+		}
+	}
+	*out_data = queue->heap[best].data;
+	*out_priority = queue->heap[best].priority;
+	PQHeap_RemoveAt(queue, best);
+	return PQ_SUCCESS;
+}
+
+/******************************************************************************
+ * Serialization
+ */
+Pair * PQHeap_Serialize(PriorityQueue * const queue, const int by_data) {
+	Pair ** order = (Pair **)malloc(sizeof(Pair *) * queue->n_data);
+	for (unsigned int i = 0; i < queue->n_data; i++) order[i] = queue->heap + i;
+	PriorityQueue_SortPairs(queue, order, queue->n_data, by_data);
+
+	Pair * output = (Pair *)malloc(sizeof(Pair) * queue->n_data);
+	for (unsigned int i = 0; i < queue->n_data; i++) output[i] = *order[i];
+	free(order);
+	return output;
+}
+
+/******************************************************************************
+ * Printing
+ */
+static void PQHeap_RecursePrint(const PriorityQueue * const queue, const unsigned int position, const char * pattern, const int depth) {
+	for (int i = 0; i < depth; i++) printf("|  ");
+	printf(pattern, queue->heap[position].data, queue->heap[position].priority);
+	for (unsigned int i = 1; i <= queue->arity; i++) {
+		unsigned int child = position * queue->arity + i;
+		if (child >= queue->n_data) break;
+		PQHeap_RecursePrint(queue, child, pattern, depth + 1);
+	}
+}
+
+void PQHeap_PrintTree(const PriorityQueue * const queue, const char * pattern) {
+	if (queue->n_data) PQHeap_RecursePrint(queue, 0, pattern, 0);
+}
+
+/******************************************************************************
+ * Memory Heap Footprint
+ */
+size_t PQHeap_Allocation(const PriorityQueue * const queue) {
+	size_t size = queue->heap_capacity * (sizeof(Pair) + sizeof(unsigned int));
+	size += queue->index.capacity * sizeof(unsigned int);
+	if (!PQIndex_Dense(queue)) size += queue->index.capacity * sizeof(Data_t);
+	return size;
+}
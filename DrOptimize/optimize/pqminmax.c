@@ -0,0 +1,107 @@
+/******************************************************************************
+ * Min-max layout of the heap backend. The array, position index and growth
+ * policy are those of pqheap.c with an arity of 2; only the ordering differs:
+ *	 -	Nodes on even levels (the root is level 0) are no greater than every
+ *		descendant.
+ *	 -	Nodes on odd levels are no less than every descendant.
+ * The minimum is therefore the root and the maximum one of its children.
+ */
+
+#include <memory.h>
+#include <stdlib.h>
+
+#include "pqbackend.h"
+
+/******************************************************************************
+ * Initialization
+ */
+PriorityQueue PriorityQueue_NewMinMax(DataCompareFunc data_compare, PriorityCompareFunc priority_compare, FreePairFunc free_pair) {
+	PriorityQueue queue = PriorityQueue_NewHeap(data_compare, priority_compare, free_pair, 2);
+	queue.backend = PQ_BACKEND_MINMAX_HEAP;
+	return queue;
+}
+
+/******************************************************************************
+ * Ordering
+ */
+static inline int PQMinMax_OnMinLevel(const unsigned int position) {
+	return !((31 - __builtin_clz(position + 1)) & 1);
+}
+
+// Compares two positions from the point of view of a level: direction is 1 on
+// min levels and -1 on max levels, so a negative result means left belongs
+// nearer the root
+static inline int PQMinMax_Compare(const PriorityQueue * const queue, const unsigned int left, const unsigned int right, const int direction) {
+	return direction * PriorityQueue_ComparePriority(queue, queue->heap[left].priority, queue->heap[right].priority);
+}
+
+static inline void PQMinMax_Swap(PriorityQueue * const queue, const unsigned int left, const unsigned int right) {
+	Pair pair = queue->heap[left];
+	unsigned int slot = queue->heap_slots[left];
+	PQHeap_Place(queue, left, queue->heap[right], queue->heap_slots[right]);
+	PQHeap_Place(queue, right, pair, slot);
+}
+
+/******************************************************************************
+ * Sifting
+ */
+
+// Moves position up through the grandparents on its own kind of level
+static void PQMinMax_BubbleUpLevel(PriorityQueue * const queue, unsigned int position, const int direction) {
+	while (position > 2) {
+		PQ_COUNT(queue, n_node_visits);
+		unsigned int grandparent = ((position - 1) / 2 - 1) / 2;
+		if (PQMinMax_Compare(queue, position, grandparent, direction) >= 0) break;
+		PQMinMax_Swap(queue, position, grandparent);
+		position = grandparent;
+	}
+}
+
+void PQMinMax_BubbleUp(PriorityQueue * const queue, const unsigned int position) {
+	if (position == 0) return;
+	unsigned int parent = (position - 1) / 2;
+	int direction = PQMinMax_OnMinLevel(position) ? 1 : -1;
+
+	// An entry on the wrong side of its parent belongs to the parent's levels
+	if (PQMinMax_Compare(queue, position, parent, direction) > 0) {
+		PQMinMax_Swap(queue, position, parent);
+		PQMinMax_BubbleUpLevel(queue, parent, -direction);
+	}
+	else PQMinMax_BubbleUpLevel(queue, position, direction);
+}
+
+void PQMinMax_TrickleDown(PriorityQueue * const queue, const unsigned int position) {
+	unsigned int current = position;
+	int direction = PQMinMax_OnMinLevel(position) ? 1 : -1;
+	while (1) {
+		PQ_COUNT(queue, n_node_visits);
+		// Find the best of the children and grandchildren
+		unsigned int first = current * 2 + 1;
+		if (first >= queue->n_data) break;
+		unsigned int best = first;
+		if (first + 1 < queue->n_data && PQMinMax_Compare(queue, first + 1, best, direction) < 0) best = first + 1;
+		for (unsigned int grandchild = first * 2 + 1; grandchild < first * 2 + 5 && grandchild < queue->n_data; grandchild++) {
+			if (PQMinMax_Compare(queue, grandchild, best, direction) < 0) best = grandchild;
+		}
+		if (PQMinMax_Compare(queue, best, current, direction) >= 0) break;
+		PQMinMax_Swap(queue, best, current);
+		if (best <= first + 1) break;
+
+		// The entry moved down two levels; keep it on the right side of the
+		// parent it now sits under
+		unsigned int parent = (best - 1) / 2;
+		if (PQMinMax_Compare(queue, best, parent, direction) > 0) PQMinMax_Swap(queue, best, parent);
+		current = best;
+	}
+}
+
+// Restores the order after the entry at position changed arbitrarily
+void PQMinMax_Fix(PriorityQueue * const queue, const unsigned int position) {
+	PQMinMax_BubbleUp(queue, position);
+	PQMinMax_TrickleDown(queue, position);
+}
+
+unsigned int PQMinMax_MaxPosition(const PriorityQueue * const queue) {
+	if (queue->n_data <= 2) return queue->n_data - 1;
+	return PriorityQueue_ComparePriority(queue, queue->heap[2].priority, queue->heap[1].priority) > 0 ? 2 : 1;
+}
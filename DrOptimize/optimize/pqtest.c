@@ -8,6 +8,9 @@
 #include <stdlib.h>
 
 #include "priorityqueue.h"
+#include "lazyheap.h"
+#include "pqgeneric.h"
+#include "radixheap.h"
 
 int IntCompare(int left, int right) {
 	return left - right;
@@ -19,25 +22,247 @@ int FloatCompare(float left, float right) {
 
 void MyFree(Pair * pair) {
 	//if (pair->data) free(pair->data);
-	free(pair);
 }
 
-int main() {
-	PriorityQueue queue = PriorityQueue_New(IntCompare, FloatCompare, MyFree);
+void Exercise(PriorityQueue * const queue) {
 	for (int i = 0; i < 97 * 36; i += 36) {
-		PriorityQueue_Insert(&queue, (i % 97), (float)(i % 5));
+		PriorityQueue_Insert(queue, (i % 97), (float)(i % 5));
 	}
 	for (int i = 0; i < 97; i += 5) {
-		PriorityQueue_Remove(&queue, i);
+		PriorityQueue_Remove(queue, i);
+	}
+	PriorityQueue_SetPriority(queue, 44, 7.0);
+	Data_t data;
+	Priority_t priority;
+	PriorityQueue_PopMax(queue, &data, &priority);
+}
+
+int SameContents(PriorityQueue * const left, PriorityQueue * const right) {
+	if (left->n_data != right->n_data) return 0;
+	Pair * lpairs = PriorityQueue_SerializeByData(left);
+	Pair * rpairs = PriorityQueue_SerializeByData(right);
+	int same = 1;
+	for (unsigned int i = 0; i < left->n_data; i++) {
+		if (lpairs[i].data != rpairs[i].data || lpairs[i].priority != rpairs[i].priority) same = 0;
+	}
+	free(lpairs);
+	free(rpairs);
+	return same;
+}
+
+// Checks batch insertion and extraction; returns 1 if they behaved
+int Batches(PriorityQueue * const queue) {
+	Pair pairs[200];
+	for (int i = 0; i < 200; i++) {
+		pairs[i].data = (i * 7) % 150;
+		pairs[i].priority = (float)((i * 13) % 50);
 	}
-	PriorityQueue_SetPriority(&queue, 44, 7.0);
+	// The last 50 repeat earlier data and are skipped
+	int ok = PriorityQueue_InsertMany(queue, pairs, 200) == PQ_ERROR_KEY_ALREADY_EXISTS && queue->n_data == 150;
+
+	Pair smallest[10];
+	ok &= PriorityQueue_PopMinK(queue, 10, smallest) == 10;
+	for (int i = 1; i < 10; i++) ok &= smallest[i - 1].priority <= smallest[i].priority;
+
+	Pair * below;
+	unsigned int n_below = PriorityQueue_PopMinBelow(queue, 20.0f, &below);
+	for (unsigned int i = 0; i < n_below; i++) ok &= below[i].priority >= smallest[9].priority && below[i].priority < 20.0f;
+	free(below);
+
+	Data_t data;
+	Priority_t priority;
+	ok &= PriorityQueue_PopMin(queue, &data, &priority) == PQ_SUCCESS && priority >= 20.0f;
+	ok &= queue->n_data == 150 - 10 - n_below - 1;
+	return ok;
+}
+
+// Entries are stale when they no longer hold their key's current priority
+int LazyStale(const void * context, const unsigned int id, const float priority) {
+	return priority != ((const float *)context)[id];
+}
+
+int main() {
 	Data_t data;
 	Priority_t priority;
-	PriorityQueue_PopMax(&queue, &data, &priority);
+	PriorityQueue queue = PriorityQueue_New(IntCompare, FloatCompare, MyFree);
+	Exercise(&queue);
 	Pair * pairs = PriorityQueue_SerializeByPriority(&queue);
 	for(int i = 0; i < queue.n_data; i++){
 		printf("%i: %.2f\n", pairs[i].data, pairs[i].priority);
 	}
+	free(pairs);
+	PriorityQueue_PrintStats(&queue);
+
+	// The heap backend should end up holding exactly the same pairs
+	PriorityQueue heap = PriorityQueue_NewHeap(IntCompare, FloatCompare, MyFree, PQ_DEFAULT_ARITY);
+	Exercise(&heap);
+	printf("Heap backend %s tree backend\n", SameContents(&queue, &heap) ? "matches" : "does NOT match");
+
+	// And the dense-key heap, whose universe covers every key used
+	PriorityQueue dense = PriorityQueue_NewDense(FloatCompare, MyFree, 97, PQ_DEFAULT_ARITY);
+	Exercise(&dense);
+	printf("Dense heap %s tree backend\n", SameContents(&queue, &dense) ? "matches" : "does NOT match");
+	printf("Dense heap rejects key 97: %s\n", PriorityQueue_Insert(&dense, 97, 0.0f) == PQ_ERROR_KEY_OUT_OF_RANGE ? "yes" : "NO");
+	PriorityQueue_Free(&dense);
+
+	// The min-max heap holds the same pairs and gives up both ends in order
+	PriorityQueue minmax = PriorityQueue_NewMinMax(IntCompare, FloatCompare, MyFree);
+	Exercise(&minmax);
+	printf("Min-max heap %s tree backend\n", SameContents(&queue, &minmax) ? "matches" : "does NOT match");
+	for (int i = 0; i < 1000; i++) {
+		PriorityQueue_Insert(&minmax, 100 + i, (float)((i * 37) % 1000));
+	}
+	Priority_t low = -INFINITY, high = INFINITY;
+	int bounded = 1;
+	while (minmax.n_data) {
+		PriorityQueue_PopMin(&minmax, &data, &priority);
+		if (priority < low || priority > high) bounded = 0;
+		low = priority;
+		if (PriorityQueue_PopMax(&minmax, &data, &priority) == PQ_SUCCESS) {
+			if (priority < low || priority > high) bounded = 0;
+			high = priority;
+		}
+	}
+	printf("Min-max heap pops both ends %s\n", bounded ? "in order" : "OUT OF ORDER");
+	PriorityQueue_Free(&minmax);
+
+	// The generic int/float queue runs the same operations with inlined
+	// comparisons
+	PQIntFloat generic = PQIntFloat_New();
+	for (int i = 0; i < 97 * 36; i += 36) PQIntFloat_Insert(&generic, (i % 97), (float)(i % 5));
+	for (int i = 0; i < 97; i += 5) PQIntFloat_Remove(&generic, i);
+	PQIntFloat_SetPriority(&generic, 44, 7.0);
+	PQIntFloat_PopMax(&generic, &data, &priority);
+	int same = generic.n_data == queue.n_data;
+	for (int i = 0; i < 97; i++) {
+		Priority_t expected, actual;
+		int expected_err = PriorityQueue_GetPriority(&queue, i, &expected);
+		int actual_err = PQIntFloat_GetPriority(&generic, i, &actual);
+		if (expected_err != actual_err || (expected_err == PQ_SUCCESS && expected != actual)) same = 0;
+	}
+	printf("Generic int/float queue %s tree backend\n", same ? "matches" : "does NOT match");
+	PQIntFloat_Free(&generic);
+
+	// 64-bit keys beyond the range of Data_t
+	PQU64U32 wide = PQU64U32_New();
+	for (uint64_t i = 0; i < 1000; i++) PQU64U32_Insert(&wide, 5000000000ull + i * 7919, (uint32_t)((i * 37) % 1000));
+	uint64_t wide_key;
+	uint32_t wide_priority, wide_last = 0;
+	int wide_ordered = 1;
+	while (PQU64U32_PopMin(&wide, &wide_key, &wide_priority) == PQ_SUCCESS) {
+		if (wide_priority < wide_last || (wide_key - 5000000000ull) / 7919 * 37 % 1000 != wide_priority) wide_ordered = 0;
+		wide_last = wide_priority;
+	}
+	printf("Generic 64-bit key queue pops %s\n", wide_ordered ? "in order" : "OUT OF ORDER");
+	PQU64U32_Free(&wide);
+
+	// Batch operations agree across backends
+	PriorityQueue batch_tree = PriorityQueue_New(IntCompare, FloatCompare, MyFree);
+	PriorityQueue batch_balanced = PriorityQueue_NewBalanced(IntCompare, FloatCompare, MyFree);
+	PriorityQueue batch_heap = PriorityQueue_NewHeap(IntCompare, FloatCompare, MyFree, PQ_DEFAULT_ARITY);
+	PriorityQueue batch_minmax = PriorityQueue_NewMinMax(IntCompare, FloatCompare, MyFree);
+	printf("Batch operations %s\n", Batches(&batch_tree) && Batches(&batch_balanced) && Batches(&batch_heap)
+		&& Batches(&batch_minmax) ? "behave" : "MISBEHAVE");
+	PriorityQueue_Free(&batch_tree);
+	PriorityQueue_Free(&batch_balanced);
+	PriorityQueue_Free(&batch_heap);
+	PriorityQueue_Free(&batch_minmax);
+
+	// So should the balanced tree, whose depth stays logarithmic
+	PriorityQueue balanced = PriorityQueue_NewBalanced(IntCompare, FloatCompare, MyFree);
+	Exercise(&balanced);
+	printf("Balanced backend %s tree backend\n", SameContents(&queue, &balanced) ? "matches" : "does NOT match");
+	for (int i = 1000; i < 1000 + (1 << 12); i++) {
+		PriorityQueue_Insert(&balanced, i, INFINITY);
+	}
+	printf("Balanced tree depth with %u pairs: %i\n", balanced.n_data, balanced.priority_tree->height);
+
+	// Clearing keeps the pools, so refilling allocates nothing new
+	size_t allocation = PriorityQueue_Allocation(&balanced);
+	PriorityQueue_Clear(&balanced);
+	for (int i = 0; i < (1 << 12); i++) {
+		PriorityQueue_Insert(&balanced, i, (float)(i % 7));
+	}
+	printf("Balanced pool %s after refill\n", PriorityQueue_Allocation(&balanced) == allocation ? "reused" : "GREW");
+	PriorityQueue_Free(&balanced);
+
+	// Bulk construction should agree with one-by-one insertion
+	Pair * bulk_pairs = PriorityQueue_SerializeByPriority(&queue);
+	PriorityQueue bulk_tree = PriorityQueue_New(IntCompare, FloatCompare, MyFree);
+	PriorityQueue bulk_balanced = PriorityQueue_NewBalanced(IntCompare, FloatCompare, MyFree);
+	PriorityQueue bulk_heap = PriorityQueue_NewHeap(IntCompare, FloatCompare, MyFree, PQ_DEFAULT_ARITY);
+	PriorityQueue_BuildFromArray(&bulk_tree, bulk_pairs, queue.n_data);
+	PriorityQueue_BuildFromArray(&bulk_balanced, bulk_pairs, queue.n_data);
+	PriorityQueue_BuildFromArray(&bulk_heap, bulk_pairs, queue.n_data);
+	printf("Bulk construction %s\n", SameContents(&queue, &bulk_tree) && SameContents(&queue, &bulk_balanced)
+		&& SameContents(&queue, &bulk_heap) ? "matches" : "does NOT match");
+	free(bulk_pairs);
+	PriorityQueue_Free(&bulk_tree);
+	PriorityQueue_Free(&bulk_balanced);
+
+	// An implicit queue materializes keys on their first update
+	Pair seed = { 3, 1.0f };
+	PriorityQueue_BuildImplicit(&bulk_heap, INFINITY, &seed, 1);
+	PriorityQueue_GetPriority(&bulk_heap, 5, &priority);
+	PriorityQueue_SetPriority(&bulk_heap, 5, 0.5f);
+	printf("Implicit queue: default %.2f, %u materialized\n", priority, bulk_heap.n_data);
+	PriorityQueue_Free(&bulk_heap);
+
+	// Drain in priority order
+	Priority_t last = -INFINITY;
+	int ordered = 1;
+	while (PriorityQueue_PopMin(&heap, &data, &priority) == PQ_SUCCESS) {
+		if (priority < last) ordered = 0;
+		last = priority;
+	}
+	printf("Heap pops %s\n", ordered ? "in order" : "OUT OF ORDER");
+
+	// The radix heap pops in order as long as pushes stay monotone
+	RadixHeap radix = RadixHeap_New(97);
+	for (unsigned int i = 0; i < 97; i++) {
+		RadixHeap_Push(&radix, i, (float)((i * 36) % 97) * 0.25f);
+	}
+	RadixHeap_Decrease(&radix, 50, 0.1f);
+	unsigned int id;
+	last = 0.0f;
+	ordered = 1;
+	PQError err = RadixHeap_PopMin(&radix, &id, &priority);
+	if (err == PQ_SUCCESS && (priority != 0.0f || id != 0)) ordered = 0;
+	while (RadixHeap_PopMin(&radix, &id, &priority) == PQ_SUCCESS) {
+		if (priority < last) ordered = 0;
+		last = priority;
+	}
+	printf("Radix heap pops %s\n", ordered ? "in order" : "OUT OF ORDER");
+	RadixHeap_Push(&radix, 3, last + 1.0f);
+	RadixHeap_PopMin(&radix, &id, &priority);
+	printf("Radix heap rejects non-monotone push: %s\n", RadixHeap_Push(&radix, 4, 0.0f) == PQ_ERROR_NOT_MONOTONE ? "yes" : "NO");
+	RadixHeap_Free(&radix);
+
+	// The lazy heap keeps duplicates until they surface or a compaction runs
+	float current[97];
+	LazyHeap lazy = LazyHeap_New(LazyStale, current);
+	for (unsigned int i = 0; i < 97; i++) {
+		current[i] = (float)((i * 36) % 97);
+		LazyHeap_Push(&lazy, i, current[i]);
+	}
+	for (int round = 0; round < 40; round++) {
+		for (unsigned int i = 0; i < 97; i++) {
+			current[i] -= 0.5f;
+			LazyHeap_Decrease(&lazy, i, current[i]);
+		}
+	}
+	last = -INFINITY;
+	ordered = 1;
+	unsigned int n_popped = 0;
+	while (LazyHeap_PopMin(&lazy, &id, &priority) == PQ_SUCCESS) {
+		if (priority < last || priority != current[id]) ordered = 0;
+		last = priority;
+		n_popped++;
+	}
+	printf("Lazy heap pops %u keys %s after %u compactions\n", n_popped, ordered ? "in order" : "OUT OF ORDER", lazy.n_compactions);
+	LazyHeap_Free(&lazy);
+
+	PriorityQueue_Free(&heap);
 	PriorityQueue_Free(&queue);
 
 	return 0;
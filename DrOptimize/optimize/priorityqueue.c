@@ -6,8 +6,9 @@
 #include <memory.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 
-#include "priorityqueue.h"
+#include "pqbackend.h"
 
 /******************************************************************************
  * Errors
@@ -17,28 +18,66 @@ PQError PQ_ERROR = -1;
 PQError PQ_ERROR_KEY_DOES_NOT_EXIST = -2;
 PQError PQ_ERROR_KEY_ALREADY_EXISTS = -3;
 PQError PQ_ERROR_EMPTY_QUEUE = -4;
+PQError PQ_ERROR_KEY_OUT_OF_RANGE = -5;
+PQError PQ_ERROR_NOT_MONOTONE = -6;
+
+/******************************************************************************
+ * Operation Timing, only compiled in with PQ_STATS
+ */
+#ifdef PQ_STATS
+static inline unsigned long long PriorityQueue_Now(void) {
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (unsigned long long)time.tv_sec * 1000000000ull + time.tv_nsec;
+}
+
+static void PriorityQueue_RecordOp(const PriorityQueue * const queue, const PQStatsOp op, const unsigned long long start) {
+	if (!queue->stats) return;
+	unsigned long long elapsed = PriorityQueue_Now() - start;
+	PQOpStats * stats = queue->stats->ops + op;
+	stats->count++;
+	stats->total_ns += elapsed;
+	if (elapsed > stats->max_ns) stats->max_ns = elapsed;
+}
+
+#define PQ_TIMER_START(start) unsigned long long start = PriorityQueue_Now()
+#define PQ_TIMER_STOP(queue, op, start) PriorityQueue_RecordOp(queue, op, start)
+#else
+#define PQ_TIMER_START(start)
+#define PQ_TIMER_STOP(queue, op, start)
+#endif
 
 /******************************************************************************
  * Initialization
  */
+static void PriorityQueue_AddSentinel(PriorityQueue * const queue) {
+	queue->data_tree = (DataNode *)Pool_Alloc(&queue->dnode_pool);
+	queue->data_tree->left = queue->data_tree->right = NULL;
+	queue->data_tree->pair = (Pair *)Pool_Alloc(&queue->pair_pool);
+	queue->data_tree->pair->data = -1;
+	queue->data_tree->pair->priority = INFINITY;
+
+	queue->priority_tree = (PriorityNode *)Pool_Alloc(&queue->pnode_pool);
+	queue->priority_tree->left = queue->priority_tree->right = NULL;
+	queue->priority_tree->pair = queue->data_tree->pair;
+}
+
 PriorityQueue PriorityQueue_New(DataCompareFunc data_compare, PriorityCompareFunc priority_compare, FreePairFunc free_pair) {
 	PriorityQueue queue;
+	memset(&queue, 0, sizeof(PriorityQueue));
+	queue.backend = PQ_BACKEND_TREE;
 
-	queue.data_tree = (DataNode *)malloc(sizeof(DataNode));
-	queue.data_tree->left = queue.data_tree->right = NULL;
-	queue.data_tree->pair = (Pair *)malloc(sizeof(Pair));
-	queue.data_tree->pair->data = -1;
-	queue.data_tree->pair->priority = INFINITY;
-
-	queue.priority_tree = (PriorityNode *)malloc(sizeof(PriorityNode));
-	queue.priority_tree->left = queue.priority_tree->right = NULL;
-	queue.priority_tree->pair = queue.data_tree->pair;
+	queue.dnode_pool = Pool_New(sizeof(DataNode));
+	queue.pnode_pool = Pool_New(sizeof(PriorityNode));
+	queue.pair_pool = Pool_New(sizeof(Pair));
+	PriorityQueue_AddSentinel(&queue);
 
 	queue.data_compare = data_compare;
 	queue.priority_compare = priority_compare;
 	queue.free_pair = free_pair;
 
 	queue.n_data = 0;
+	PriorityQueue_AttachStats(&queue);
 
 	return queue;
 }
@@ -46,30 +85,75 @@ PriorityQueue PriorityQueue_New(DataCompareFunc data_compare, PriorityCompareFun
 /******************************************************************************
  * Memory Free
  */
-static void PriorityQueue_FreeDataNode(PriorityQueue * const queue, DataNode * node) {
-	if (node->left) PriorityQueue_FreeDataNode(queue, node->left);
-	if (node->right) PriorityQueue_FreeDataNode(queue, node->right);
-	if (node->pair) queue->free_pair(node->pair);
-	free(node);
+static void PriorityQueue_ReleaseDataNode(PriorityQueue * const queue, DataNode * node) {
+	if (node->left) PriorityQueue_ReleaseDataNode(queue, node->left);
+	if (node->right) PriorityQueue_ReleaseDataNode(queue, node->right);
+	queue->free_pair(node->pair);
 }
 
-static void PriorityQueue_FreePriorityNode(PriorityQueue * const queue, PriorityNode * node) {
-	if (node->left) PriorityQueue_FreePriorityNode(queue, node->left);
-	if (node->right) PriorityQueue_FreePriorityNode(queue, node->right);
-	// Pair is already freed in FreeDataNode
-	free(node);
+// Hands every pair to free_pair; the nodes themselves belong to the pools
+static void PriorityQueue_ReleasePairs(PriorityQueue * const queue) {
+	if (!queue->free_pair || !queue->data_tree) return;
+	if (queue->backend == PQ_BACKEND_BALANCED_TREE) {
+		PriorityQueue_ReleaseDataNode(queue, queue->data_tree);
+	}
+	else {
+		// Skip the sentinel
+		if (queue->data_tree->left) PriorityQueue_ReleaseDataNode(queue, queue->data_tree->left);
+		if (queue->data_tree->right) PriorityQueue_ReleaseDataNode(queue, queue->data_tree->right);
+	}
 }
 
 void PriorityQueue_Free(PriorityQueue * const queue) {
-	if (queue->data_tree) PriorityQueue_FreeDataNode(queue, queue->data_tree);
-	if (queue->priority_tree) PriorityQueue_FreePriorityNode(queue, queue->priority_tree);
+	free(queue->stats);
+	queue->stats = NULL;
+	if (PriorityQueue_IsHeap(queue)) {
+		PQHeap_Free(queue);
+		return;
+	}
+	PriorityQueue_ReleasePairs(queue);
+	Pool_Free(&queue->dnode_pool);
+	Pool_Free(&queue->pnode_pool);
+	Pool_Free(&queue->pair_pool);
+	queue->data_tree = NULL;
+	queue->priority_tree = NULL;
 	queue->n_data = 0;
 }
 
+/******************************************************************************
+ * Empties the queue but keeps its memory, so that the next query can refill it
+ * without allocating.
+ */
+void PriorityQueue_Clear(PriorityQueue * const queue) {
+	if (PriorityQueue_IsHeap(queue)) {
+		PQHeap_Clear(queue);
+		return;
+	}
+	PriorityQueue_ReleasePairs(queue);
+	Pool_Reset(&queue->dnode_pool);
+	Pool_Reset(&queue->pnode_pool);
+	Pool_Reset(&queue->pair_pool);
+	queue->data_tree = NULL;
+	queue->priority_tree = NULL;
+	queue->n_data = 0;
+	if (queue->backend == PQ_BACKEND_TREE) PriorityQueue_AddSentinel(queue);
+}
+
+void PriorityQueue_Reserve(PriorityQueue * const queue, const unsigned int n_data) {
+	if (PriorityQueue_IsHeap(queue)) {
+		PQHeap_Reserve(queue, n_data);
+		return;
+	}
+	// One more node and pair for the sentinel of the unbalanced tree
+	Pool_Reserve(&queue->dnode_pool, n_data + 1);
+	Pool_Reserve(&queue->pnode_pool, n_data + 1);
+	Pool_Reserve(&queue->pair_pool, n_data + 1);
+}
+
 /******************************************************************************
  * Insert
  */
-PQError PriorityQueue_Insert(PriorityQueue * const queue, const Data_t data, const Priority_t priority) {
+static PQError PriorityQueue_TreeInsert(PriorityQueue * const queue, const Data_t data, const Priority_t priority) {
 	// Forward-declare new pair
 	Pair * pair;
 
@@ -79,14 +163,15 @@ PQError PriorityQueue_Insert(PriorityQueue * const queue, const Data_t data, con
 	// inserted.
 	DataNode * dnode = queue->data_tree;
 	while (1) {
-		int comp = queue->data_compare(data, dnode->pair->data);
+		PQ_COUNT(queue, n_node_visits);
+		int comp = PriorityQueue_CompareData(queue, data, dnode->pair->data);
 		// Return an error if the data is a duplicate
 		if (comp == 0) return PQ_ERROR_KEY_ALREADY_EXISTS;
 		if (comp > 0) {
 			// Data to insert is greater than current
 			if (dnode->right) dnode = dnode->right;
 			else {
-				dnode->right = (DataNode *)malloc(sizeof(DataNode));
+				dnode->right = (DataNode *)Pool_Alloc(&queue->dnode_pool);
 				dnode = dnode->right;
 				break;
 			}
@@ -95,7 +180,7 @@ PQError PriorityQueue_Insert(PriorityQueue * const queue, const Data_t data, con
 			// Data to insert is less than current
 			if (dnode->left) dnode = dnode->left;
 			else {
-				dnode->left = (DataNode *)malloc(sizeof(DataNode));
+				dnode->left = (DataNode *)Pool_Alloc(&queue->dnode_pool);
 				dnode = dnode->left;
 				break;
 			}
@@ -103,7 +188,7 @@ PQError PriorityQueue_Insert(PriorityQueue * const queue, const Data_t data, con
 	}
 
 	// Allocate the new pair
-	pair = (Pair *)malloc(sizeof(Pair));
+	pair = (Pair *)Pool_Alloc(&queue->pair_pool);
 	pair->data = data;
 	pair->priority = priority;
 
@@ -115,12 +200,13 @@ PQError PriorityQueue_Insert(PriorityQueue * const queue, const Data_t data, con
 	// Insert pair into priority tree
 	PriorityNode * pnode = queue->priority_tree;
 	while (1) {
-		int comp = queue->priority_compare(priority, pnode->pair->priority);
+		PQ_COUNT(queue, n_node_visits);
+		int comp = PriorityQueue_ComparePriority(queue, priority, pnode->pair->priority);
 		if (comp > 0) {
 			// Priority to insert is greater than current
 			if (pnode->right) pnode = pnode->right;
 			else {
-				pnode->right = (PriorityNode *)malloc(sizeof(PriorityNode));
+				pnode->right = (PriorityNode *)Pool_Alloc(&queue->pnode_pool);
 				pnode = pnode->right;
 				break;
 			}
@@ -129,7 +215,7 @@ PQError PriorityQueue_Insert(PriorityQueue * const queue, const Data_t data, con
 			// Priority to insert is less than or equal to the current
 			if (pnode->left) pnode = pnode->left;
 			else {
-				pnode->left = (PriorityNode *)malloc(sizeof(PriorityNode));
+				pnode->left = (PriorityNode *)Pool_Alloc(&queue->pnode_pool);
 				pnode = pnode->left;
 				break;
 			}
@@ -141,20 +227,32 @@ PQError PriorityQueue_Insert(PriorityQueue * const queue, const Data_t data, con
 	pnode->right = NULL;
 	pnode->pair = pair;
 
+	PQ_COUNT_N(queue, n_allocations, 3);
 	queue->n_data++;
 	return PQ_SUCCESS;
 }
 
+PQError PriorityQueue_Insert(PriorityQueue * const queue, const Data_t data, const Priority_t priority) {
+	PQ_TIMER_START(start);
+	int err;
+	if (queue->backend == PQ_BACKEND_BALANCED_TREE) err = PQBalanced_Insert(queue, data, priority);
+	else if (PriorityQueue_IsHeap(queue)) err = PQHeap_Insert(queue, data, priority);
+	else err = PriorityQueue_TreeInsert(queue, data, priority);
+	PQ_TIMER_STOP(queue, PQ_OP_INSERT, start);
+	return err;
+}
+
 /******************************************************************************
  * Remove
  */
-PQError PriorityQueue_Remove(PriorityQueue * const queue, const Data_t data) {
+static PQError PriorityQueue_TreeRemove(PriorityQueue * const queue, const Data_t data) {
 	// Check for existance in data tree.
 	// If it exists, remove from data tree.
 	DataNode * dnode = queue->data_tree;
 	DataNode * dparent = NULL;
 	while (1) {
-		int comp = queue->data_compare(data, dnode->pair->data);
+		PQ_COUNT(queue, n_node_visits);
+		int comp = PriorityQueue_CompareData(queue, data, dnode->pair->data);
 		if (comp == 0) break;
 		if (comp > 0) {
 			// Data to remove is greater than current
@@ -184,7 +282,8 @@ PQError PriorityQueue_Remove(PriorityQueue * const queue, const Data_t data) {
 			// Insert right child elsewhere in tree
 			DataNode * diter = queue->data_tree;
 			while (1) {
-				int comp = queue->data_compare(dright->pair->data, diter->pair->data);
+				PQ_COUNT(queue, n_node_visits);
+				int comp = PriorityQueue_CompareData(queue, dright->pair->data, diter->pair->data);
 				// Since keys are unique, data cannot be anywhere inside of tree
 				if (comp > 0) {
 					// Data to insert is greater than current
@@ -228,9 +327,10 @@ PQError PriorityQueue_Remove(PriorityQueue * const queue, const Data_t data) {
 	PriorityNode * pnode = queue->priority_tree;
 	PriorityNode * pparent = NULL;
 	while (1) {
-		int pcomp = queue->priority_compare(priority, pnode->pair->priority);
+		PQ_COUNT(queue, n_node_visits);
+		int pcomp = PriorityQueue_ComparePriority(queue, priority, pnode->pair->priority);
 		if (pcomp == 0) {
-			int dcomp = queue->data_compare(data, pnode->pair->data);
+			int dcomp = PriorityQueue_CompareData(queue, data, pnode->pair->data);
 			if (dcomp == 0) break;
 		}
 		if (pcomp > 0) {
@@ -261,7 +361,8 @@ PQError PriorityQueue_Remove(PriorityQueue * const queue, const Data_t data) {
 			// Insert right child elsewhere in tree
 			PriorityNode * piter = queue->priority_tree;
 			while (1) {
-				int comp = queue->priority_compare(pright->pair->priority, piter->pair->priority);
+				PQ_COUNT(queue, n_node_visits);
+				int comp = PriorityQueue_ComparePriority(queue, pright->pair->priority, piter->pair->priority);
 				if (comp > 0) {
 					// Data to insert is greater than current
 					if (piter->right) piter = piter->right;
@@ -299,22 +400,34 @@ PQError PriorityQueue_Remove(PriorityQueue * const queue, const Data_t data) {
 		}
 	}
 
-	// Free removed nodes
-	queue->free_pair(dnode->pair);
-	free(dnode);
-	free(pnode);
+	// Return removed nodes to the pools
+	if (queue->free_pair) queue->free_pair(dnode->pair);
+	Pool_Release(&queue->pair_pool, dnode->pair);
+	Pool_Release(&queue->dnode_pool, dnode);
+	Pool_Release(&queue->pnode_pool, pnode);
 	queue->n_data--;
 
 	return PQ_SUCCESS;
 }
 
+PQError PriorityQueue_Remove(PriorityQueue * const queue, const Data_t data) {
+	PQ_TIMER_START(start);
+	int err;
+	if (queue->backend == PQ_BACKEND_BALANCED_TREE) err = PQBalanced_Remove(queue, data);
+	else if (PriorityQueue_IsHeap(queue)) err = PQHeap_Remove(queue, data);
+	else err = PriorityQueue_TreeRemove(queue, data);
+	PQ_TIMER_STOP(queue, PQ_OP_REMOVE, start);
+	return err;
+}
+
 /******************************************************************************
  * Getting and Modifying Priority
  */
-PQError PriorityQueue_GetPriority(const PriorityQueue * const queue, const Data_t data, Priority_t * const out_priority) {
+static PQError PriorityQueue_TreeGetPriority(const PriorityQueue * const queue, const Data_t data, Priority_t * const out_priority) {
 	DataNode * node = queue->data_tree;
 	while (1) {
-		int comp = queue->data_compare(data, node->pair->data);
+		PQ_COUNT(queue, n_node_visits);
+		int comp = PriorityQueue_CompareData(queue, data, node->pair->data);
 		if (comp == 0) break;
 		else if (comp > 0) {
 			// Data to find is greater than current
@@ -332,22 +445,205 @@ PQError PriorityQueue_GetPriority(const PriorityQueue * const queue, const Data_
 	return PQ_SUCCESS;
 }
 
+PQError PriorityQueue_GetPriority(const PriorityQueue * const queue, const Data_t data, Priority_t * const out_priority) {
+	PQ_TIMER_START(start);
+	int err;
+	if (queue->backend == PQ_BACKEND_BALANCED_TREE) err = PQBalanced_GetPriority(queue, data, out_priority);
+	else if (PriorityQueue_IsHeap(queue)) err = PQHeap_GetPriority(queue, data, out_priority);
+	else err = PriorityQueue_TreeGetPriority(queue, data, out_priority);
+
+	// Keys that are not materialized have the implicit priority
+	if (err == PQ_ERROR_KEY_DOES_NOT_EXIST && queue->implicit) {
+		*out_priority = queue->implicit_priority;
+		err = PQ_SUCCESS;
+	}
+	PQ_TIMER_STOP(queue, PQ_OP_GET_PRIORITY, start);
+	return err;
+}
+
 PQError PriorityQueue_SetPriority(PriorityQueue * const queue, const Data_t data, const Priority_t priority) {
-	// Remove node from priority tree
-	PQError err1 = PriorityQueue_Remove(queue, data);
-	if (err1) return err1;
+	PQ_TIMER_START(start);
+	int err;
+	if (queue->backend == PQ_BACKEND_BALANCED_TREE) err = PQBalanced_SetPriority(queue, data, priority);
+	else if (PriorityQueue_IsHeap(queue)) err = PQHeap_SetPriority(queue, data, priority);
+	else {
+		// Remove node from priority tree
+		err = PriorityQueue_TreeRemove(queue, data);
 
-	// Re-insert node back into the tree
-	PQError err2 = PriorityQueue_Insert(queue, data, priority);
-	if (err2) return err2;
+		// Re-insert node back into the tree
+		if (!err) err = PriorityQueue_TreeInsert(queue, data, priority);
+	}
+
+	// Keys that are not materialized are inserted on their first update
+	if (err == PQ_ERROR_KEY_DOES_NOT_EXIST && queue->implicit) err = PriorityQueue_Insert(queue, data, priority);
+	PQ_TIMER_STOP(queue, PQ_OP_SET_PRIORITY, start);
+	return err;
+}
 
+/******************************************************************************
+ * Bulk Construction
+ */
+static int PriorityQueue_PairCompare(const PriorityQueue * const queue, const Pair * const left, const Pair * const right, const int by_data) {
+	if (by_data) return PriorityQueue_CompareData(queue, left->data, right->data);
+	int comp = PriorityQueue_ComparePriority(queue, left->priority, right->priority);
+	if (comp == 0) comp = PriorityQueue_CompareData(queue, left->data, right->data);
+	return comp;
+}
+
+// Bottom-up merge sort; qsort cannot carry the queue's comparators. Input
+// that is already in order is detected in one pass and left alone.
+void PriorityQueue_SortPairs(const PriorityQueue * const queue, Pair ** const pairs, const unsigned int n, const int by_data) {
+	unsigned int sorted = 1;
+	while (sorted < n && PriorityQueue_PairCompare(queue, pairs[sorted - 1], pairs[sorted], by_data) <= 0) sorted++;
+	if (sorted >= n) return;
+
+	Pair ** buffer = (Pair **)malloc(n * sizeof(Pair *));
+	Pair ** from = pairs;
+	Pair ** to = buffer;
+	for (unsigned int width = 1; width < n; width <<= 1) {
+		for (unsigned int lo = 0; lo < n; lo += 2 * width) {
+			unsigned int mid = lo + width < n ? lo + width : n;
+			unsigned int hi = lo + 2 * width < n ? lo + 2 * width : n;
+			unsigned int i = lo, j = mid, k = lo;
+			while (i < mid && j < hi) {
+				if (PriorityQueue_PairCompare(queue, from[j], from[i], by_data) < 0) to[k++] = from[j++];
+				else to[k++] = from[i++];
+			}
+			while (i < mid) to[k++] = from[i++];
+			while (j < hi) to[k++] = from[j++];
+		}
+		Pair ** temp = from;
+		from = to;
+		to = temp;
+	}
+	if (from != pairs) memcpy(pairs, from, n * sizeof(Pair *));
+	free(buffer);
+}
+
+// Index of the first of n pairs, sorted by data, whose data is not below data
+unsigned int PriorityQueue_SearchPairs(const PriorityQueue * const queue, Pair ** const pairs, const unsigned int n, const Data_t data) {
+	unsigned int lo = 0, hi = n;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (PriorityQueue_CompareData(queue, pairs[mid]->data, data) < 0) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo;
+}
+
+// Height of a subtree of n nodes built by splitting at n / 2
+static inline int PriorityQueue_BuiltHeight(const unsigned int n) {
+	return n ? 32 - __builtin_clz(n) : 0;
+}
+
+static DataNode * PriorityQueue_BuildDataTree(PriorityQueue * const queue, Pair ** const pairs, const unsigned int n) {
+	if (n == 0) return NULL;
+	unsigned int mid = n / 2;
+	DataNode * node = (DataNode *)Pool_Alloc(&queue->dnode_pool);
+	node->pair = pairs[mid];
+	node->left = PriorityQueue_BuildDataTree(queue, pairs, mid);
+	node->right = PriorityQueue_BuildDataTree(queue, pairs + mid + 1, n - mid - 1);
+	node->height = PriorityQueue_BuiltHeight(n);
+	return node;
+}
+
+// The unbalanced tree requires equal priorities to the left of each other, so
+// with equal_left the split point moves to the end of its run of equals. The
+// left spine is built iteratively because such runs can be long.
+static PriorityNode * PriorityQueue_BuildPriorityTree(PriorityQueue * const queue, Pair ** const pairs, unsigned int n, const int equal_left) {
+	PriorityNode * root = NULL;
+	PriorityNode ** link = &root;
+	while (n > 0) {
+		unsigned int mid = n / 2;
+		if (equal_left) {
+			while (mid + 1 < n && PriorityQueue_ComparePriority(queue, pairs[mid + 1]->priority, pairs[mid]->priority) == 0) mid++;
+		}
+		PriorityNode * node = (PriorityNode *)Pool_Alloc(&queue->pnode_pool);
+		node->pair = pairs[mid];
+		node->right = PriorityQueue_BuildPriorityTree(queue, pairs + mid + 1, n - mid - 1, equal_left);
+		node->height = PriorityQueue_BuiltHeight(n);
+		*link = node;
+		link = &node->left;
+		n = mid;
+	}
+	*link = NULL;
+	return root;
+}
+
+static PQError PriorityQueue_BuildTrees(PriorityQueue * const queue, const Pair * const pairs, const unsigned int n) {
+	// Copy the pairs into the pool and order them by data
+	Pair ** by_data = (Pair **)malloc(n * sizeof(Pair *));
+	for (unsigned int i = 0; i < n; i++) {
+		by_data[i] = (Pair *)Pool_Alloc(&queue->pair_pool);
+		*by_data[i] = pairs[i];
+	}
+	PriorityQueue_SortPairs(queue, by_data, n, 1);
+	for (unsigned int i = 1; i < n; i++) {
+		if (PriorityQueue_CompareData(queue, by_data[i - 1]->data, by_data[i]->data) == 0) {
+			free(by_data);
+			PriorityQueue_Clear(queue);
+			return PQ_ERROR_KEY_ALREADY_EXISTS;
+		}
+	}
+	Pair ** by_priority = (Pair **)malloc(n * sizeof(Pair *));
+	memcpy(by_priority, by_data, n * sizeof(Pair *));
+	PriorityQueue_SortPairs(queue, by_priority, n, 0);
+
+	if (queue->backend == PQ_BACKEND_BALANCED_TREE) {
+		// A perfectly balanced tree is a valid AVL tree
+		queue->data_tree = PriorityQueue_BuildDataTree(queue, by_data, n);
+		queue->priority_tree = PriorityQueue_BuildPriorityTree(queue, by_priority, n, 0);
+	}
+	else {
+		// Split each order around the sentinel the same way Insert would
+		const Pair * sentinel = queue->data_tree->pair;
+		unsigned int n_left = 0;
+		while (n_left < n && PriorityQueue_CompareData(queue, by_data[n_left]->data, sentinel->data) <= 0) n_left++;
+		queue->data_tree->left = PriorityQueue_BuildDataTree(queue, by_data, n_left);
+		queue->data_tree->right = PriorityQueue_BuildDataTree(queue, by_data + n_left, n - n_left);
+		n_left = 0;
+		while (n_left < n && PriorityQueue_ComparePriority(queue, by_priority[n_left]->priority, sentinel->priority) <= 0) n_left++;
+		queue->priority_tree->left = PriorityQueue_BuildPriorityTree(queue, by_priority, n_left, 1);
+		queue->priority_tree->right = PriorityQueue_BuildPriorityTree(queue, by_priority + n_left, n - n_left, 1);
+	}
+	queue->n_data = n;
+
+	free(by_data);
+	free(by_priority);
 	return PQ_SUCCESS;
 }
 
+/******************************************************************************
+ * Replaces the contents of the queue with n pairs in one pass: a heapify for
+ * the heap backend, or a balanced build from sorted orders for the trees.
+ * Returns PQ_ERROR_KEY_ALREADY_EXISTS and leaves the queue empty if the data
+ * is not unique.
+ */
+PQError PriorityQueue_BuildFromArray(PriorityQueue * const queue, const Pair * const pairs, const unsigned int n) {
+	PriorityQueue_Clear(queue);
+	queue->implicit = 0;
+	if (PriorityQueue_IsHeap(queue)) return PQHeap_Build(queue, pairs, n);
+	return PriorityQueue_BuildTrees(queue, pairs, n);
+}
+
+/******************************************************************************
+ * Like PriorityQueue_BuildFromArray, but every key that is not in pairs is
+ * implicitly at implicit_priority without being stored. GetPriority reports
+ * the implicit priority for such keys and SetPriority inserts them, so a
+ * Dijkstra search only materializes the nodes it actually reaches. Removed and
+ * popped keys become implicit again.
+ */
+PQError PriorityQueue_BuildImplicit(PriorityQueue * const queue, const Priority_t implicit_priority, const Pair * const pairs, const unsigned int n) {
+	PQError err = PriorityQueue_BuildFromArray(queue, pairs, n);
+	queue->implicit = 1;
+	queue->implicit_priority = implicit_priority;
+	return err;
+}
+
 /******************************************************************************
  * Pop Next
  */
-PQError PriorityQueue_PopMin(PriorityQueue * const queue, Data_t * const out_data, Priority_t * const out_priority) {
+static PQError PriorityQueue_TreePopMin(PriorityQueue * const queue, Data_t * const out_data, Priority_t * const out_priority) {
 	// Set up top node
 	if (queue->n_data == 0) return PQ_ERROR_EMPTY_QUEUE;
 	PriorityNode * node = queue->priority_tree;
@@ -355,6 +651,7 @@ PQError PriorityQueue_PopMin(PriorityQueue * const queue, Data_t * const out_dat
 	
 	// Go to the left-most node
 	while (node->left) {
+		PQ_COUNT(queue, n_node_visits);
 		node = node->left;
 	}
 
@@ -363,12 +660,12 @@ PQError PriorityQueue_PopMin(PriorityQueue * const queue, Data_t * const out_dat
 	*out_priority = node->pair->priority;
 
 	// Remove node from tree
-	PriorityQueue_Remove(queue, *out_data);
+	PriorityQueue_TreeRemove(queue, *out_data);
 
 	return PQ_SUCCESS;
 }
 
-PQError PriorityQueue_PopMax(PriorityQueue * const queue, Data_t * const out_data, Priority_t * const out_priority) {
+static PQError PriorityQueue_TreePopMax(PriorityQueue * const queue, Data_t * const out_data, Priority_t * const out_priority) {
 	// Set up top node
 	if (queue->n_data == 0) return PQ_ERROR_EMPTY_QUEUE;
 	PriorityNode * node = queue->priority_tree;
@@ -376,6 +673,7 @@ PQError PriorityQueue_PopMax(PriorityQueue * const queue, Data_t * const out_dat
 
 	// Go to the left-most node
 	while (node->right) {
+		PQ_COUNT(queue, n_node_visits);
 		node = node->right;
 	}
 
@@ -384,11 +682,182 @@ PQError PriorityQueue_PopMax(PriorityQueue * const queue, Data_t * const out_dat
 	*out_priority = node->pair->priority;
 
 	// Remove node from tree
-	PriorityQueue_Remove(queue, *out_data);
+	PriorityQueue_TreeRemove(queue, *out_data);
 
 	return PQ_SUCCESS;
 }
 
+PQError PriorityQueue_PopMin(PriorityQueue * const queue, Data_t * const out_data, Priority_t * const out_priority) {
+	PQ_TIMER_START(start);
+	int err;
+	if (queue->backend == PQ_BACKEND_BALANCED_TREE) err = PQBalanced_PopMin(queue, out_data, out_priority);
+	else if (PriorityQueue_IsHeap(queue)) err = PQHeap_PopMin(queue, out_data, out_priority);
+	else err = PriorityQueue_TreePopMin(queue, out_data, out_priority);
+	PQ_TIMER_STOP(queue, PQ_OP_POP_MIN, start);
+	return err;
+}
+
+PQError PriorityQueue_PopMax(PriorityQueue * const queue, Data_t * const out_data, Priority_t * const out_priority) {
+	PQ_TIMER_START(start);
+	int err;
+	if (queue->backend == PQ_BACKEND_BALANCED_TREE) err = PQBalanced_PopMax(queue, out_data, out_priority);
+	else if (PriorityQueue_IsHeap(queue)) err = PQHeap_PopMax(queue, out_data, out_priority);
+	else err = PriorityQueue_TreePopMax(queue, out_data, out_priority);
+	PQ_TIMER_STOP(queue, PQ_OP_POP_MAX, start);
+	return err;
+}
+
+/******************************************************************************
+ * Batch Operations
+ */
+
+/******************************************************************************
+ * Inserts n pairs. Pairs whose data is already queued (or out of range for a
+ * dense heap) are skipped and the error is returned once the rest are in. An
+ * empty queue is bulk-built, and the heap backends heapify the batch.
+ */
+PQError PriorityQueue_InsertMany(PriorityQueue * const queue, const Pair * const pairs, const unsigned int n) {
+	PriorityQueue_Reserve(queue, queue->n_data + n);
+	if (PriorityQueue_IsHeap(queue)) return PQHeap_InsertMany(queue, pairs, n);
+
+	if (queue->n_data == 0) {
+		int implicit = queue->implicit;
+		if (PriorityQueue_BuildFromArray(queue, pairs, n) == PQ_SUCCESS) {
+			queue->implicit = implicit;
+			return PQ_SUCCESS;
+		}
+		queue->implicit = implicit;
+	}
+	int err = PQ_SUCCESS;
+	for (unsigned int i = 0; i < n; i++) {
+		if (PriorityQueue_Insert(queue, pairs[i].data, pairs[i].priority) != PQ_SUCCESS) err = PQ_ERROR_KEY_ALREADY_EXISTS;
+	}
+	return err;
+}
+
+// Unlinks the first nodes of the priority tree in order until *n reaches
+// limit, copying their pairs to output and keeping them in popped for the data
+// tree. Returns what is left of the subtree.
+static PriorityNode * PriorityQueue_PopPrefix(PriorityQueue * const queue, PriorityNode * const node,
+	Pair * const output, Pair ** const popped, unsigned int * const n, const unsigned int limit) {
+	if (!node || *n == limit) return node;
+	node->left = PriorityQueue_PopPrefix(queue, node->left, output, popped, n, limit);
+	if (*n == limit) return node;
+	PQ_COUNT(queue, n_node_visits);
+	output[*n] = *node->pair;
+	popped[(*n)++] = node->pair;
+	PriorityNode * right = node->right;
+	Pool_Release(&queue->pnode_pool, node);
+	return PriorityQueue_PopPrefix(queue, right, output, popped, n, limit);
+}
+
+// Unlinks the nodes of n pairs, sorted by data, from the data tree in one walk
+// and releases them. Returns what is left of the subtree.
+static DataNode * PriorityQueue_RemoveSorted(PriorityQueue * const queue, DataNode * const node, Pair ** const pairs, const unsigned int n) {
+	if (!node || n == 0) return node;
+	PQ_COUNT(queue, n_node_visits);
+	unsigned int below = PriorityQueue_SearchPairs(queue, pairs, n, node->pair->data);
+	unsigned int found = below < n && PriorityQueue_CompareData(queue, pairs[below]->data, node->pair->data) == 0;
+	DataNode * left = PriorityQueue_RemoveSorted(queue, node->left, pairs, below);
+	DataNode * right = PriorityQueue_RemoveSorted(queue, node->right, pairs + below + found, n - below - found);
+	if (!found) {
+		node->left = left;
+		node->right = right;
+		return node;
+	}
+
+	if (queue->free_pair) queue->free_pair(node->pair);
+	Pool_Release(&queue->pair_pool, node->pair);
+	Pool_Release(&queue->dnode_pool, node);
+	if (!left) return right;
+	if (!right) return left;
+	// Hang the left child below the left-most node of the right
+	DataNode * iter = right;
+	while (iter->left) iter = iter->left;
+	iter->left = left;
+	return right;
+}
+
+// Pops up to limit pairs in priority order into output. The trees unlink the
+// batch from the priority tree as one walk finds it, then from the data tree
+// in a second walk, without going back to the root for each pair.
+static unsigned int PriorityQueue_PopBatch(PriorityQueue * const queue, unsigned int limit, Pair * const output) {
+	if (limit > queue->n_data) limit = queue->n_data;
+	unsigned int n = 0;
+	if (PriorityQueue_IsHeap(queue)) {
+		while (n < limit) {
+			PQHeap_PopMin(queue, &output[n].data, &output[n].priority);
+			n++;
+		}
+		return n;
+	}
+	if (limit == 0) return 0;
+	if (queue->backend == PQ_BACKEND_BALANCED_TREE) return PQBalanced_PopBatch(queue, limit, output);
+
+	Pair ** popped = (Pair **)malloc(limit * sizeof(Pair *));
+	// Skip the sentinel
+	PriorityNode * root = queue->priority_tree;
+	root->left = PriorityQueue_PopPrefix(queue, root->left, output, popped, &n, limit);
+	root->right = PriorityQueue_PopPrefix(queue, root->right, output, popped, &n, limit);
+	PriorityQueue_SortPairs(queue, popped, n, 1);
+	unsigned int below = PriorityQueue_SearchPairs(queue, popped, n, queue->data_tree->pair->data);
+	queue->data_tree->left = PriorityQueue_RemoveSorted(queue, queue->data_tree->left, popped, below);
+	queue->data_tree->right = PriorityQueue_RemoveSorted(queue, queue->data_tree->right, popped + below, n - below);
+	queue->n_data -= n;
+	free(popped);
+	return n;
+}
+
+// Pairs of the subtree with priority below bound
+static unsigned int PriorityQueue_CountBelow(const PriorityQueue * const queue, const PriorityNode * const node, const Priority_t bound) {
+	if (!node) return 0;
+	unsigned int n = PriorityQueue_CountBelow(queue, node->left, bound);
+	if (PriorityQueue_ComparePriority(queue, node->pair->priority, bound) >= 0) return n;
+	return n + 1 + PriorityQueue_CountBelow(queue, node->right, bound);
+}
+
+/******************************************************************************
+ * Pops the k smallest pairs into out_pairs, which must have room for k, in
+ * priority order. Returns how many were popped, which is less than k only if
+ * the queue ran out.
+ */
+unsigned int PriorityQueue_PopMinK(PriorityQueue * const queue, const unsigned int k, Pair * const out_pairs) {
+	return PriorityQueue_PopBatch(queue, k, out_pairs);
+}
+
+/******************************************************************************
+ * Pops every pair with priority below bound, in priority order, into a new
+ * array at *out_pairs (NULL if there are none). Returns the count.
+ */
+unsigned int PriorityQueue_PopMinBelow(PriorityQueue * const queue, const Priority_t bound, Pair ** const out_pairs) {
+	*out_pairs = NULL;
+	if (queue->n_data == 0) return 0;
+	unsigned int n = 0;
+	if (PriorityQueue_IsHeap(queue)) {
+		// The heaps pop one at a time, so the array grows as they do
+		unsigned int capacity = 0;
+		while (queue->n_data > 0 && PriorityQueue_ComparePriority(queue, queue->heap[0].priority, bound) < 0) {
+			if (n == capacity) {
+				capacity = capacity ? capacity * 2 : 16;
+				*out_pairs = (Pair *)realloc(*out_pairs, capacity * sizeof(Pair));
+			}
+			PQHeap_PopMin(queue, &(*out_pairs)[n].data, &(*out_pairs)[n].priority);
+			n++;
+		}
+		if (n) *out_pairs = (Pair *)realloc(*out_pairs, n * sizeof(Pair));
+		return n;
+	}
+
+	// The pairs below bound are a prefix of the priority tree, so counting them
+	// sizes the array
+	const PriorityNode * root = queue->priority_tree;
+	if (queue->backend == PQ_BACKEND_BALANCED_TREE) n = PriorityQueue_CountBelow(queue, root, bound);
+	else n = PriorityQueue_CountBelow(queue, root->left, bound) + PriorityQueue_CountBelow(queue, root->right, bound);
+	if (n == 0) return 0;
+	*out_pairs = (Pair *)malloc(n * sizeof(Pair));
+	return PriorityQueue_PopBatch(queue, n, *out_pairs);
+}
+
 /******************************************************************************
  * Serialization
  */
@@ -409,16 +878,24 @@ static int PriorityQueue_SerializationByPriorityWalker(const PriorityNode * cons
 }
 
 Pair * PriorityQueue_SerializeByPriority(PriorityQueue * const queue) {
+	if (PriorityQueue_IsHeap(queue)) return PQHeap_Serialize(queue, 0);
+
 	Pair * output = (Pair *)malloc(sizeof(Pair) * queue->n_data);
 	int total = 0;
-	if (queue->priority_tree->left) {
-		total = PriorityQueue_SerializationByPriorityWalker(queue->priority_tree->left, output, total);
+	if (queue->backend == PQ_BACKEND_BALANCED_TREE) {
+		// No sentinel root to skip
+		if (queue->priority_tree) {
+			total = PriorityQueue_SerializationByPriorityWalker(queue->priority_tree, output, total);
+		}
 	}
-	if (queue->priority_tree->right) {
-		total = PriorityQueue_SerializationByPriorityWalker(queue->priority_tree->right, output, total);
+	else {
+		if (queue->priority_tree->left) {
+			total = PriorityQueue_SerializationByPriorityWalker(queue->priority_tree->left, output, total);
+		}
+		if (queue->priority_tree->right) {
+			total = PriorityQueue_SerializationByPriorityWalker(queue->priority_tree->right, output, total);
+		}
 	}
-	if (total == queue->n_data) printf("We have all the data.\n");
-	else printf("We do NOT have all the data.\n");
 	return output;
 }
 
@@ -439,16 +916,23 @@ static int PriorityQueue_SerializationByDataWalker(const DataNode * const node,
 }
 
 Pair * PriorityQueue_SerializeByData(PriorityQueue * const queue) {
+	if (PriorityQueue_IsHeap(queue)) return PQHeap_Serialize(queue, 1);
+
 	Pair * output = (Pair *)malloc(sizeof(Pair) * queue->n_data);
 	int total = 0;
-	if (queue->data_tree->left) {
-		total = PriorityQueue_SerializationByDataWalker(queue->data_tree->left, output, total);
+	if (queue->backend == PQ_BACKEND_BALANCED_TREE) {
+		if (queue->data_tree) {
+			total = PriorityQueue_SerializationByDataWalker(queue->data_tree, output, total);
+		}
 	}
-	if (queue->data_tree->right) {
-		total = PriorityQueue_SerializationByDataWalker(queue->data_tree->right, output, total);
+	else {
+		if (queue->data_tree->left) {
+			total = PriorityQueue_SerializationByDataWalker(queue->data_tree->left, output, total);
+		}
+		if (queue->data_tree->right) {
+			total = PriorityQueue_SerializationByDataWalker(queue->data_tree->right, output, total);
+		}
 	}
-	if (total == queue->n_data) printf("We have all the data.\n");
-	else printf("We do NOT have all the data.\n");
 	return output;
 }
 
@@ -463,31 +947,166 @@ static void PriorityQueue_RecursePrintDataNode(const DataNode * const node, cons
 }
 
 void PriorityQueue_PrintTree(const PriorityQueue * const queue, const char * pattern) {
-	PriorityQueue_RecursePrintDataNode(queue->data_tree, pattern, 0);
+	if (PriorityQueue_IsHeap(queue)) {
+		PQHeap_PrintTree(queue, pattern);
+		return;
+	}
+	if (queue->data_tree) PriorityQueue_RecursePrintDataNode(queue->data_tree, pattern, 0);
 }
 
 /******************************************************************************
  * Memory Heap Footprint
  */
-static size_t PriorityQueue_RecurseDataNodeAllocation(const DataNode * const node) {
-	size_t output = sizeof(DataNode);
-	if (node->right) output += PriorityQueue_RecurseDataNodeAllocation(node->right);
-	if (node->left) output += PriorityQueue_RecurseDataNodeAllocation(node->left);
-	if (node->pair) output += sizeof(Pair);
-	return output;
+size_t PriorityQueue_Allocation(const PriorityQueue * const queue) {
+	size_t size = sizeof(PriorityQueue);
+	if (PriorityQueue_IsHeap(queue)) return size + PQHeap_Allocation(queue);
+	size += Pool_Allocation(&queue->dnode_pool);
+	size += Pool_Allocation(&queue->pnode_pool);
+	size += Pool_Allocation(&queue->pair_pool);
+	return size;
 }
 
-static size_t PriorityQueue_RecursePriorityNodeAllocation(const PriorityNode * const node) {
-	size_t output = sizeof(PriorityNode);
-	if (node->right) output += PriorityQueue_RecursePriorityNodeAllocation(node->right);
-	if (node->left) output += PriorityQueue_RecursePriorityNodeAllocation(node->left);
-	// Size of data taken care of in RecurseDataNodeAllocation
-	return output;
+/******************************************************************************
+ * Statistics
+ */
+void PriorityQueue_AttachStats(PriorityQueue * const queue) {
+#ifdef PQ_STATS
+	queue->stats = (PriorityQueue_Stats *)calloc(1, sizeof(PriorityQueue_Stats));
+#else
+	queue->stats = NULL;
+#endif
 }
 
-size_t PriorityQueue_Allocation(const PriorityQueue * const queue) {
-	size_t size = sizeof(PriorityQueue);
-	size += PriorityQueue_RecurseDataNodeAllocation(queue->data_tree);
-	size += PriorityQueue_RecursePriorityNodeAllocation(queue->priority_tree);
-	return size;
+static inline void PQDepthStats_Add(PQDepthStats * const depths, const unsigned int depth) {
+	depths->histogram[depth <= PQ_STATS_DEPTH_BUCKETS ? depth - 1 : PQ_STATS_DEPTH_BUCKETS - 1]++;
+	depths->n_nodes++;
+	depths->mean_depth += depth;
+	if (depth > depths->max_depth) depths->max_depth = depth;
+}
+
+// The walks keep their own stacks so that a degenerate tree, the case they
+// exist to diagnose, cannot overflow the call stack. At most capacity nodes
+// are visited in case the tree holds more than n_data.
+static void PQDepthStats_WalkPriority(PQDepthStats * const depths, const PriorityNode * const root, const unsigned int capacity) {
+	if (!root || !capacity) return;
+	const PriorityNode ** nodes = (const PriorityNode **)malloc(capacity * sizeof(PriorityNode *));
+	unsigned int * levels = (unsigned int *)malloc(capacity * sizeof(unsigned int));
+	unsigned int top = 0, n_visited = 0;
+	nodes[top] = root;
+	levels[top++] = 1;
+	while (top && n_visited++ < capacity) {
+		top--;
+		const PriorityNode * node = nodes[top];
+		unsigned int depth = levels[top];
+		PQDepthStats_Add(depths, depth);
+		if (node->left && top < capacity) {
+			nodes[top] = node->left;
+			levels[top++] = depth + 1;
+		}
+		if (node->right && top < capacity) {
+			nodes[top] = node->right;
+			levels[top++] = depth + 1;
+		}
+	}
+	free(nodes);
+	free(levels);
+}
+
+static void PQDepthStats_WalkData(PQDepthStats * const depths, const DataNode * const root, const unsigned int capacity) {
+	if (!root || !capacity) return;
+	const DataNode ** nodes = (const DataNode **)malloc(capacity * sizeof(DataNode *));
+	unsigned int * levels = (unsigned int *)malloc(capacity * sizeof(unsigned int));
+	unsigned int top = 0, n_visited = 0;
+	nodes[top] = root;
+	levels[top++] = 1;
+	while (top && n_visited++ < capacity) {
+		top--;
+		const DataNode * node = nodes[top];
+		unsigned int depth = levels[top];
+		PQDepthStats_Add(depths, depth);
+		if (node->left && top < capacity) {
+			nodes[top] = node->left;
+			levels[top++] = depth + 1;
+		}
+		if (node->right && top < capacity) {
+			nodes[top] = node->right;
+			levels[top++] = depth + 1;
+		}
+	}
+	free(nodes);
+	free(levels);
+}
+
+void PriorityQueue_GetStats(const PriorityQueue * const queue, PriorityQueue_Stats * const out_stats) {
+	if (queue->stats) *out_stats = *queue->stats;
+	else memset(out_stats, 0, sizeof(PriorityQueue_Stats));
+	memset(&out_stats->priority_depths, 0, sizeof(PQDepthStats));
+	memset(&out_stats->data_depths, 0, sizeof(PQDepthStats));
+	out_stats->allocation = PriorityQueue_Allocation(queue);
+
+	PQDepthStats * priority_depths = &out_stats->priority_depths;
+	PQDepthStats * data_depths = &out_stats->data_depths;
+	if (PriorityQueue_IsHeap(queue)) {
+		unsigned long long level_end = 1, level_size = 1;
+		unsigned int depth = 1;
+		for (unsigned int i = 0; i < queue->n_data; i++) {
+			if (i == level_end) {
+				level_size *= queue->arity;
+				level_end += level_size;
+				depth++;
+			}
+			PQDepthStats_Add(priority_depths, depth);
+		}
+	}
+	else if (queue->backend == PQ_BACKEND_BALANCED_TREE) {
+		PQDepthStats_WalkPriority(priority_depths, queue->priority_tree, queue->n_data);
+		PQDepthStats_WalkData(data_depths, queue->data_tree, queue->n_data);
+	}
+	else if (queue->priority_tree) {
+		// The sentinel's children are the roots of the real trees
+		PQDepthStats_WalkPriority(priority_depths, queue->priority_tree->left, queue->n_data);
+		PQDepthStats_WalkPriority(priority_depths, queue->priority_tree->right, queue->n_data - priority_depths->n_nodes);
+		PQDepthStats_WalkData(data_depths, queue->data_tree->left, queue->n_data);
+		PQDepthStats_WalkData(data_depths, queue->data_tree->right, queue->n_data - data_depths->n_nodes);
+	}
+	if (priority_depths->n_nodes) priority_depths->mean_depth /= priority_depths->n_nodes;
+	if (data_depths->n_nodes) data_depths->mean_depth /= data_depths->n_nodes;
+}
+
+void PriorityQueue_ResetStats(PriorityQueue * const queue) {
+	if (queue->stats) memset(queue->stats, 0, sizeof(PriorityQueue_Stats));
+}
+
+static void PQDepthStats_Print(const PQDepthStats * const depths, const char * name, const unsigned int n_data) {
+	// A balanced tree of n_data nodes is PriorityQueue_BuiltHeight(n_data) deep
+	printf("%s: max depth %u (balanced %i), mean %.2f\n", name, depths->max_depth, PriorityQueue_BuiltHeight(n_data),
+		depths->mean_depth);
+	if (depths->n_nodes != n_data) printf("  %u of %u pairs NOT reachable\n", n_data - depths->n_nodes, n_data);
+	for (unsigned int i = 0; i < PQ_STATS_DEPTH_BUCKETS; i++) {
+		if (!depths->histogram[i]) continue;
+		printf("  %s%3u %u\n", i == PQ_STATS_DEPTH_BUCKETS - 1 ? ">=" : "  ", i + 1, depths->histogram[i]);
+	}
+}
+
+void PriorityQueue_PrintStats(const PriorityQueue * const queue) {
+	static const char * BACKEND_NAMES[] = { "tree", "balanced tree", "heap", "min-max heap" };
+	static const char * OP_NAMES[PQ_N_OPS] = { "Insert", "Remove", "GetPriority", "SetPriority", "PopMin", "PopMax" };
+
+	PriorityQueue_Stats stats;
+	PriorityQueue_GetStats(queue, &stats);
+	printf("Priority queue (%s): %u pairs, %zu bytes\n", BACKEND_NAMES[queue->backend], queue->n_data, stats.allocation);
+	PQDepthStats_Print(&stats.priority_depths, PriorityQueue_IsHeap(queue) ? "Heap" : "Priority tree", queue->n_data);
+	if (!PriorityQueue_IsHeap(queue)) PQDepthStats_Print(&stats.data_depths, "Data tree", queue->n_data);
+
+	if (!queue->stats) {
+		printf("Operation counters need a PQ_STATS build\n");
+		return;
+	}
+	printf("Comparisons %llu, node visits %llu, allocations %llu\n", stats.n_comparisons, stats.n_node_visits, stats.n_allocations);
+	for (unsigned int op = 0; op < PQ_N_OPS; op++) {
+		const PQOpStats * op_stats = stats.ops + op;
+		if (!op_stats->count) continue;
+		printf("  %-12s %10llu ops %10.1f ns mean %10llu ns max\n", OP_NAMES[op], op_stats->count,
+			(double)op_stats->total_ns / op_stats->count, op_stats->max_ns);
+	}
 }
\ No newline at end of file
@@ -6,14 +6,37 @@
 
 #include <stdlib.h>
 
+#include "pool.h"
+
 /******************************************************************************
- * PriorityQueue has two trees:
+ * PriorityQueue has two backends, selected by the constructor:
+ *
+ * PQ_BACKEND_TREE (PriorityQueue_New) has two trees:
  *   1. A BST of Pairs sorted by priority. This is used for looking up the
  *		highest/lowest in the queue. This tree is composed of PriorityNode.
  *	 2. A BST of Pairs sorted by the value of the pointer to data (in other
  *		words the literal value of the pointer). This is used for looking up
  *		and changing the priority of an item. This tree is composed of
  *		DataNode.
+ *	 The nodes and Pairs of both tree backends come from Pools owned by the
+ *	 queue, so Insert and Remove recycle memory instead of calling malloc and
+ *	 free, and PriorityQueue_Clear keeps that memory for the next query.
+ *
+ * PQ_BACKEND_BALANCED_TREE (PriorityQueue_NewBalanced) keeps the same two
+ * trees as AVL trees without a sentinel root. The priority tree is ordered by
+ * priority and then by data, so duplicate priorities (such as every node of a
+ * network starting at INFINITY) no longer degenerate into a linked list.
+ *
+ * PQ_BACKEND_HEAP (PriorityQueue_NewHeap) is a flat d-ary min-heap of Pairs
+ * with a position index that maps data to its slot in the heap. Changing the
+ * priority of an item sifts it in place, and no memory is allocated per
+ * operation once the heap and index have grown to their working size.
+ * PriorityQueue_NewDense makes the same heap over the integer keys
+ * [0, n_keys), with a flat position array instead of a hashed index.
+ *
+ * PQ_BACKEND_MINMAX_HEAP (PriorityQueue_NewMinMax) lays the same array and
+ * index out as a binary min-max heap: even levels are ordered as a min-heap
+ * and odd levels as a max-heap, so PopMin and PopMax are both O(log n).
  */
 
 typedef const int PQError;
@@ -21,6 +44,19 @@ PQError PQ_SUCCESS;
 PQError PQ_ERROR_KEY_DOES_NOT_EXIST;
 PQError PQ_ERROR_KEY_ALREADY_EXISTS;
 PQError PQ_ERROR_EMPTY_QUEUE;
+PQError PQ_ERROR_KEY_OUT_OF_RANGE;
+PQError PQ_ERROR_NOT_MONOTONE;
+
+typedef enum PQBackend {
+	PQ_BACKEND_TREE,
+	PQ_BACKEND_BALANCED_TREE,
+	PQ_BACKEND_HEAP,
+	PQ_BACKEND_MINMAX_HEAP
+} PQBackend;
+
+#define PQ_DEFAULT_ARITY 4
+#define PQ_NO_POSITION 0xffffffffu
+#define PQ_STATS_DEPTH_BUCKETS 64
 
 /******************************************************************************
  * Change these typedefs to change the data type of the Priority Queue
@@ -37,42 +73,148 @@ typedef struct Pair {
 	Priority_t priority;
 } Pair;
 
+/******************************************************************************
+ * Called on a Pair as it leaves the queue, to release anything its data owns.
+ * The Pair itself belongs to the queue and must not be freed. May be NULL.
+ */
 typedef void(*FreePairFunc)(Pair * pair);
 
 typedef struct PriorityNode {
 	Pair * pair;
 	struct PriorityNode * left, * right;
+	int height; // Only maintained by the balanced tree backend
 } PriorityNode;
 
 typedef struct DataNode {
 	Pair * pair;
 	struct DataNode * left, * right;
+	int height; // Only maintained by the balanced tree backend
 } DataNode;
 
+/******************************************************************************
+ * Position index of the heap backend. An open-addressing hash table keyed on
+ * the bytes of Data_t; positions[i] is the heap slot of keys[i], or
+ * PQ_NO_POSITION if the bucket is empty. In dense mode keys is NULL and
+ * positions[data] is the heap slot of data, for capacity keys.
+ */
+typedef struct PQIndex {
+	Data_t * keys;
+	unsigned int * positions;
+	unsigned int capacity;
+	unsigned int n_keys;
+} PQIndex;
+
+/******************************************************************************
+ * Statistics, filled in by PriorityQueue_GetStats.
+ *
+ * The depth histograms are measured from the trees as they stand: a queue
+ * whose maximum depth is far beyond log2(n_data) has degenerated, while a deep
+ * but balanced one is simply large. For the heap backends priority_depths
+ * holds the heap levels and data_depths is empty.
+ *
+ * The counters are only kept when the queue is compiled with PQ_STATS defined
+ * (make STATS=1); otherwise they read as zero. They accumulate across
+ * PriorityQueue_Clear until PriorityQueue_ResetStats.
+ */
+typedef enum PQStatsOp {
+	PQ_OP_INSERT,
+	PQ_OP_REMOVE,
+	PQ_OP_GET_PRIORITY,
+	PQ_OP_SET_PRIORITY,
+	PQ_OP_POP_MIN,
+	PQ_OP_POP_MAX,
+	PQ_N_OPS
+} PQStatsOp;
+
+typedef struct PQOpStats {
+	unsigned long long count;
+	unsigned long long total_ns;
+	unsigned long long max_ns;
+} PQOpStats;
+
+typedef struct PQDepthStats {
+	// Nodes per depth, the root being depth 1; the last bucket also counts
+	// every deeper node
+	unsigned int histogram[PQ_STATS_DEPTH_BUCKETS];
+	unsigned int n_nodes;
+	unsigned int max_depth;
+	double mean_depth;
+} PQDepthStats;
+
+typedef struct PriorityQueue_Stats {
+	unsigned long long n_comparisons;
+	// Tree nodes descended through and heap slots sifted through
+	unsigned long long n_node_visits;
+	// Objects taken from the pools and growths of the heap arrays
+	unsigned long long n_allocations;
+	PQOpStats ops[PQ_N_OPS];
+
+	PQDepthStats priority_depths;
+	PQDepthStats data_depths;
+	size_t allocation;
+} PriorityQueue_Stats;
+
 typedef struct PriorityQueue {
+	PQBackend backend;
+
+	// Tree backends
 	PriorityNode * priority_tree;
 	DataNode * data_tree;
+	Pool dnode_pool;
+	Pool pnode_pool;
+	Pool pair_pool;
+
+	// Heap backend; heap_slots[i] is the index bucket of heap[i]
+	Pair * heap;
+	unsigned int * heap_slots;
+	unsigned int heap_capacity;
+	unsigned int arity;
+	PQIndex index;
+
 	PriorityCompareFunc priority_compare;
 	DataCompareFunc data_compare;
 	FreePairFunc free_pair;
+
+	// Set by PriorityQueue_BuildImplicit
+	int implicit;
+	Priority_t implicit_priority;
+
 	unsigned int n_data;
+
+	// Counters, only allocated with PQ_STATS
+	PriorityQueue_Stats * stats;
 } PriorityQueue;
 
 
 PriorityQueue PriorityQueue_New(DataCompareFunc, PriorityCompareFunc, FreePairFunc);
+PriorityQueue PriorityQueue_NewBalanced(DataCompareFunc, PriorityCompareFunc, FreePairFunc);
+PriorityQueue PriorityQueue_NewHeap(DataCompareFunc, PriorityCompareFunc, FreePairFunc, const unsigned int arity);
+PriorityQueue PriorityQueue_NewDense(PriorityCompareFunc, FreePairFunc, const unsigned int n_keys, const unsigned int arity);
+PriorityQueue PriorityQueue_NewMinMax(DataCompareFunc, PriorityCompareFunc, FreePairFunc);
+void PriorityQueue_Reserve(PriorityQueue * const, const unsigned int n_data);
 void PriorityQueue_Free(PriorityQueue * const);
+void PriorityQueue_Clear(PriorityQueue * const);
+PQError PriorityQueue_BuildFromArray(PriorityQueue * const, const Pair * const pairs, const unsigned int n);
+PQError PriorityQueue_BuildImplicit(PriorityQueue * const, const Priority_t implicit_priority, const Pair * const pairs, const unsigned int n);
 PQError PriorityQueue_Insert(PriorityQueue * const, const Data_t, const Priority_t);
 PQError PriorityQueue_Remove(PriorityQueue * const, const Data_t);
 PQError PriorityQueue_GetPriority(const PriorityQueue * const, const Data_t, Priority_t * const);
 PQError PriorityQueue_SetPriority(PriorityQueue * const, const Data_t, const Priority_t);
 PQError PriorityQueue_PopMin(PriorityQueue * const, Data_t * const, Priority_t * const);
 PQError PriorityQueue_PopMax(PriorityQueue * const, Data_t * const, Priority_t * const);
+PQError PriorityQueue_InsertMany(PriorityQueue * const, const Pair * const pairs, const unsigned int n);
+unsigned int PriorityQueue_PopMinK(PriorityQueue * const, const unsigned int k, Pair * const out_pairs);
+unsigned int PriorityQueue_PopMinBelow(PriorityQueue * const, const Priority_t bound, Pair ** const out_pairs);
 
 Pair * PriorityQueue_SerializeByPriority(PriorityQueue * const);
 Pair * PriorityQueue_SerializeByData(PriorityQueue * const);
 
 void PriorityQueue_PrintTree(const PriorityQueue * const, const char * pattern);
 
+void PriorityQueue_GetStats(const PriorityQueue * const, PriorityQueue_Stats * const out_stats);
+void PriorityQueue_ResetStats(PriorityQueue * const);
+void PriorityQueue_PrintStats(const PriorityQueue * const);
+
 inline unsigned int PriorityQueue_Length(const PriorityQueue * const queue) {
 	return queue->n_data;
 }
@@ -0,0 +1,158 @@
+/******************************************************************************
+ * Implementation of the Radix Heap.
+ */
+
+#include <math.h>
+#include <memory.h>
+#include <stdlib.h>
+
+#include "radixheap.h"
+
+#define RADIX_NO_BUCKET 0xffffffffu
+
+static inline unsigned int RadixHeap_Key(const float priority) {
+	// Non-negative floats order like their bit patterns; fold -0.0 into 0
+	unsigned int key;
+	if (priority <= 0.0f) return 0;
+	memcpy(&key, &priority, sizeof(key));
+	return key;
+}
+
+static inline unsigned int RadixHeap_BucketIndex(const RadixHeap * const heap, const unsigned int key) {
+	unsigned int diff = key ^ heap->last;
+	return diff ? 32 - __builtin_clz(diff) : 0;
+}
+
+static void RadixHeap_Place(RadixHeap * const heap, const RadixEntry entry) {
+	unsigned int index = RadixHeap_BucketIndex(heap, entry.key);
+	RadixBucket * bucket = heap->buckets + index;
+	if (bucket->n_entries == bucket->capacity) {
+		bucket->capacity = bucket->capacity ? bucket->capacity * 2 : 16;
+		bucket->entries = (RadixEntry *)realloc(bucket->entries, bucket->capacity * sizeof(RadixEntry));
+	}
+	heap->bucket_of[entry.id] = index;
+	heap->slot_of[entry.id] = bucket->n_entries;
+	bucket->entries[bucket->n_entries++] = entry;
+}
+
+// Removes an entry from its bucket by moving the bucket's last entry into it
+static void RadixHeap_Unplace(RadixHeap * const heap, const unsigned int id) {
+	RadixBucket * bucket = heap->buckets + heap->bucket_of[id];
+	unsigned int slot = heap->slot_of[id];
+	RadixEntry moved = bucket->entries[--bucket->n_entries];
+	if (slot != bucket->n_entries) {
+		bucket->entries[slot] = moved;
+		heap->slot_of[moved.id] = slot;
+	}
+	heap->bucket_of[id] = RADIX_NO_BUCKET;
+}
+
+/******************************************************************************
+ * Initialization
+ */
+RadixHeap RadixHeap_New(const unsigned int n_keys) {
+	RadixHeap heap;
+	memset(&heap, 0, sizeof(RadixHeap));
+	heap.n_keys = n_keys;
+	heap.bucket_of = (unsigned int *)malloc(n_keys * sizeof(unsigned int));
+	heap.slot_of = (unsigned int *)malloc(n_keys * sizeof(unsigned int));
+	memset(heap.bucket_of, 0xff, n_keys * sizeof(unsigned int));
+	return heap;
+}
+
+/******************************************************************************
+ * Memory Free
+ */
+void RadixHeap_Free(RadixHeap * const heap) {
+	for (unsigned int i = 0; i < RADIX_N_BUCKETS; i++) free(heap->buckets[i].entries);
+	free(heap->bucket_of);
+	free(heap->slot_of);
+	memset(heap, 0, sizeof(RadixHeap));
+}
+
+void RadixHeap_Clear(RadixHeap * const heap) {
+	// Keep the bucket arrays; only reset the ids still inside
+	for (unsigned int i = 0; i < RADIX_N_BUCKETS; i++) {
+		RadixBucket * bucket = heap->buckets + i;
+		for (unsigned int j = 0; j < bucket->n_entries; j++) {
+			heap->bucket_of[bucket->entries[j].id] = RADIX_NO_BUCKET;
+		}
+		bucket->n_entries = 0;
+	}
+	heap->last = 0;
+	heap->n_data = 0;
+}
+
+/******************************************************************************
+ * Push and Decrease
+ */
+PQError RadixHeap_Push(RadixHeap * const heap, const unsigned int id, const float priority) {
+	if (id >= heap->n_keys) return PQ_ERROR_KEY_OUT_OF_RANGE;
+	if (heap->bucket_of[id] != RADIX_NO_BUCKET) return PQ_ERROR_KEY_ALREADY_EXISTS;
+	unsigned int key = RadixHeap_Key(priority);
+	if (key < heap->last) return PQ_ERROR_NOT_MONOTONE;
+
+	RadixEntry entry = { id, key, priority };
+	RadixHeap_Place(heap, entry);
+	heap->n_data++;
+	return PQ_SUCCESS;
+}
+
+PQError RadixHeap_Decrease(RadixHeap * const heap, const unsigned int id, const float priority) {
+	if (id >= heap->n_keys || heap->bucket_of[id] == RADIX_NO_BUCKET) return PQ_ERROR_KEY_DOES_NOT_EXIST;
+	unsigned int key = RadixHeap_Key(priority);
+	if (key < heap->last) return PQ_ERROR_NOT_MONOTONE;
+
+	// The entry can only move to the same or a lower bucket
+	RadixEntry * entry = heap->buckets[heap->bucket_of[id]].entries + heap->slot_of[id];
+	if (key >= entry->key) return PQ_SUCCESS;
+	RadixEntry updated = { id, key, priority };
+	RadixHeap_Unplace(heap, id);
+	RadixHeap_Place(heap, updated);
+	return PQ_SUCCESS;
+}
+
+/******************************************************************************
+ * Pop Next
+ */
+PQError RadixHeap_PopMin(RadixHeap * const heap, unsigned int * const out_id, float * const out_priority) {
+	if (heap->n_data == 0) return PQ_ERROR_EMPTY_QUEUE;
+
+	if (heap->buckets[0].n_entries == 0) {
+		// Refill bucket 0 from the first non-empty bucket
+		unsigned int index = 1;
+		while (heap->buckets[index].n_entries == 0) index++;
+		RadixBucket * bucket = heap->buckets + index;
+		unsigned int min_key = bucket->entries[0].key;
+		for (unsigned int i = 1; i < bucket->n_entries; i++) {
+			if (bucket->entries[i].key < min_key) min_key = bucket->entries[i].key;
+		}
+
+		// Every entry shares more leading bits with the new minimum, so all
+		// of them land in lower buckets
+		heap->last = min_key;
+		unsigned int n_entries = bucket->n_entries;
+		bucket->n_entries = 0;
+		for (unsigned int i = 0; i < n_entries; i++) RadixHeap_Place(heap, bucket->entries[i]);
+	}
+
+	RadixBucket * bucket = heap->buckets;
+	RadixEntry entry = bucket->entries[--bucket->n_entries];
+	heap->bucket_of[entry.id] = RADIX_NO_BUCKET;
+	heap->n_data--;
+
+	*out_id = entry.id;
+	*out_priority = entry.priority;
+	return PQ_SUCCESS;
+}
+
+/******************************************************************************
+ * Memory Heap Footprint
+ */
+size_t RadixHeap_Allocation(const RadixHeap * const heap) {
+	size_t size = sizeof(RadixHeap) + 2 * heap->n_keys * sizeof(unsigned int);
+	for (unsigned int i = 0; i < RADIX_N_BUCKETS; i++) {
+		size += heap->buckets[i].capacity * sizeof(RadixEntry);
+	}
+	return size;
+}
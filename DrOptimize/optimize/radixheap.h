@@ -0,0 +1,51 @@
+/******************************************************************************
+ * Header file for the Radix Heap.
+ */
+
+#pragma once
+
+#include "priorityqueue.h"
+
+/******************************************************************************
+ * RadixHeap is a monotone priority queue for non-negative float priorities
+ * over the dense ids [0, n_keys). Priorities are bucketed on their IEEE bit
+ * pattern, which orders the same way as the values for non-negative floats:
+ * bucket 0 holds entries equal to the last popped minimum, and bucket i > 0
+ * holds entries whose highest bit differing from it is bit i - 1.
+ *
+ * Pushed priorities may never be below the last popped minimum, which is
+ * exactly the guarantee Dijkstra's algorithm gives. Each entry moves to a
+ * lower bucket at most 32 times, so operations are O(1) amortized plus the
+ * scan of one bucket per refill.
+ */
+
+#define RADIX_N_BUCKETS 33
+
+typedef struct RadixEntry {
+	unsigned int id;
+	unsigned int key;
+	float priority;
+} RadixEntry;
+
+typedef struct RadixBucket {
+	RadixEntry * entries;
+	unsigned int n_entries;
+	unsigned int capacity;
+} RadixBucket;
+
+typedef struct RadixHeap {
+	RadixBucket buckets[RADIX_N_BUCKETS];
+	unsigned int last;
+	unsigned int * bucket_of;
+	unsigned int * slot_of;
+	unsigned int n_keys;
+	unsigned int n_data;
+} RadixHeap;
+
+RadixHeap RadixHeap_New(const unsigned int n_keys);
+void RadixHeap_Free(RadixHeap * const);
+void RadixHeap_Clear(RadixHeap * const);
+PQError RadixHeap_Push(RadixHeap * const, const unsigned int id, const float priority);
+PQError RadixHeap_Decrease(RadixHeap * const, const unsigned int id, const float priority);
+PQError RadixHeap_PopMin(RadixHeap * const, unsigned int * const out_id, float * const out_priority);
+size_t RadixHeap_Allocation(const RadixHeap * const);
@@ -1,5 +1,14 @@
+import sys
 from distutils.core import setup, Extension
 
-ext = Extension("_dijkstra", ["_dijkstra.c", "dijkstra.c", "priorityqueue.c"])
+# The graph build and the distance tables run on several threads: pthreads
+# everywhere but Windows, where thread.h uses the C runtime instead
+if sys.platform == "win32":
+    thread_args = []
+else:
+    thread_args = ["-pthread"]
+
+ext = Extension("_dijkstra", ["_dijkstra.c", "dijkstra.c", "graph.c", "priorityqueue.c", "pqbalanced.c", "pqheap.c", "pqminmax.c", "pool.c", "radixheap.c", "bucketqueue.c", "lazyheap.c"],
+    extra_compile_args=thread_args, extra_link_args=thread_args)
 
 setup(ext_modules=[ext])
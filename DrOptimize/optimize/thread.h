@@ -0,0 +1,189 @@
+/******************************************************************************
+ * Header file for portable threads.
+ */
+
+#pragma once
+
+/******************************************************************************
+ * The few thread operations the parallel builds and searches need, over
+ * pthreads or, on Windows, the C runtime, so that the Python extension builds
+ * with either. Thread_Start runs its function on the calling thread if a
+ * thread cannot be started, so the work is still done, only serially, and
+ * joining it does nothing. Workers that meet at a ThreadBarrier cannot run
+ * one after another like that; they use Thread_TryStart, which only reports
+ * the failure.
+ */
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+
+typedef struct Thread {
+	HANDLE handle;
+	void * (*run)(void *);
+	void * argument;
+} Thread;
+
+typedef struct ThreadLock {
+	CRITICAL_SECTION section;
+	CONDITION_VARIABLE condition;
+} ThreadLock;
+
+static unsigned __stdcall Thread_Trampoline(void * argument) {
+	Thread * thread = (Thread *)argument;
+	thread->run(thread->argument);
+	return 0;
+}
+
+// The thread must stay where it is until it is joined
+static inline int Thread_TryStart(Thread * const thread, void * (*run)(void *), void * const argument) {
+	thread->run = run;
+	thread->argument = argument;
+	thread->handle = (HANDLE)_beginthreadex(NULL, 0, Thread_Trampoline, thread, 0, NULL);
+	return thread->handle != 0;
+}
+
+static inline void Thread_Join(Thread * const thread) {
+	if (!thread->handle) return;
+	WaitForSingleObject(thread->handle, INFINITE);
+	CloseHandle(thread->handle);
+}
+
+static inline unsigned int Thread_CountProcessors(void) {
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? (unsigned int)info.dwNumberOfProcessors : 1;
+}
+
+static inline void ThreadLock_Init(ThreadLock * const lock) {
+	InitializeCriticalSection(&lock->section);
+	InitializeConditionVariable(&lock->condition);
+}
+
+static inline void ThreadLock_Destroy(ThreadLock * const lock) {
+	DeleteCriticalSection(&lock->section);
+}
+
+static inline void ThreadLock_Acquire(ThreadLock * const lock) {
+	EnterCriticalSection(&lock->section);
+}
+
+static inline void ThreadLock_Release(ThreadLock * const lock) {
+	LeaveCriticalSection(&lock->section);
+}
+
+// Releases the lock until another thread calls ThreadLock_WakeAll
+static inline void ThreadLock_Wait(ThreadLock * const lock) {
+	SleepConditionVariableCS(&lock->condition, &lock->section, INFINITE);
+}
+
+static inline void ThreadLock_WakeAll(ThreadLock * const lock) {
+	WakeAllConditionVariable(&lock->condition);
+}
+#else
+#include <pthread.h>
+#include <unistd.h>
+
+typedef struct Thread {
+	pthread_t handle;
+	int started;
+} Thread;
+
+typedef struct ThreadLock {
+	pthread_mutex_t mutex;
+	pthread_cond_t condition;
+} ThreadLock;
+
+static inline int Thread_TryStart(Thread * const thread, void * (*run)(void *), void * const argument) {
+	thread->started = pthread_create(&thread->handle, NULL, run, argument) == 0;
+	return thread->started;
+}
+
+static inline void Thread_Join(Thread * const thread) {
+	if (thread->started) pthread_join(thread->handle, NULL);
+}
+
+static inline unsigned int Thread_CountProcessors(void) {
+	long n_processors = sysconf(_SC_NPROCESSORS_ONLN);
+	return n_processors > 0 ? (unsigned int)n_processors : 1;
+}
+
+static inline void ThreadLock_Init(ThreadLock * const lock) {
+	pthread_mutex_init(&lock->mutex, NULL);
+	pthread_cond_init(&lock->condition, NULL);
+}
+
+static inline void ThreadLock_Destroy(ThreadLock * const lock) {
+	pthread_mutex_destroy(&lock->mutex);
+	pthread_cond_destroy(&lock->condition);
+}
+
+static inline void ThreadLock_Acquire(ThreadLock * const lock) {
+	pthread_mutex_lock(&lock->mutex);
+}
+
+static inline void ThreadLock_Release(ThreadLock * const lock) {
+	pthread_mutex_unlock(&lock->mutex);
+}
+
+// Releases the lock until another thread calls ThreadLock_WakeAll
+static inline void ThreadLock_Wait(ThreadLock * const lock) {
+	pthread_cond_wait(&lock->condition, &lock->mutex);
+}
+
+static inline void ThreadLock_WakeAll(ThreadLock * const lock) {
+	pthread_cond_broadcast(&lock->condition);
+}
+#endif
+
+static inline void Thread_Start(Thread * const thread, void * (*run)(void *), void * const argument) {
+	if (!Thread_TryStart(thread, run, argument)) run(argument);
+}
+
+/******************************************************************************
+ * A barrier that n_threads threads wait at until all of them have arrived,
+ * after which it can be used again. ThreadBarrier_SetCount changes how many
+ * it waits for, releasing those already waiting if they are now enough, so
+ * that a barrier set up for the threads asked for can be brought down to
+ * the threads that started.
+ */
+typedef struct ThreadBarrier {
+	ThreadLock lock;
+	unsigned int n_threads;
+	unsigned int n_waiting;
+	unsigned int generation;
+} ThreadBarrier;
+
+static inline void ThreadBarrier_Init(ThreadBarrier * const barrier, const unsigned int n_threads) {
+	ThreadLock_Init(&barrier->lock);
+	barrier->n_threads = n_threads;
+	barrier->n_waiting = 0;
+	barrier->generation = 0;
+}
+
+static inline void ThreadBarrier_Destroy(ThreadBarrier * const barrier) {
+	ThreadLock_Destroy(&barrier->lock);
+}
+
+// Lets the threads waiting go; the lock must be held
+static inline void ThreadBarrier_Open(ThreadBarrier * const barrier) {
+	barrier->n_waiting = 0;
+	barrier->generation++;
+	ThreadLock_WakeAll(&barrier->lock);
+}
+
+static inline void ThreadBarrier_Wait(ThreadBarrier * const barrier) {
+	ThreadLock_Acquire(&barrier->lock);
+	unsigned int generation = barrier->generation;
+	if (++barrier->n_waiting >= barrier->n_threads) ThreadBarrier_Open(barrier);
+	else {
+		while (generation == barrier->generation) ThreadLock_Wait(&barrier->lock);
+	}
+	ThreadLock_Release(&barrier->lock);
+}
+
+static inline void ThreadBarrier_SetCount(ThreadBarrier * const barrier, const unsigned int n_threads) {
+	ThreadLock_Acquire(&barrier->lock);
+	barrier->n_threads = n_threads;
+	if (barrier->n_waiting > 0 && barrier->n_waiting >= n_threads) ThreadBarrier_Open(barrier);
+	ThreadLock_Release(&barrier->lock);
+}
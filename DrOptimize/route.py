@@ -14,8 +14,24 @@ def OptimizeDistance(paths, intersections, start, end):
         for path in paths]
     int_start = intersection_indexes[start]
     int_end = intersection_indexes[end]
+    # Path lengths are in kilometres, so the coordinates can direct the search
+    coordinates = [(float(i.node.lat), float(i.node.lon)) for i in intersections]
     
-    path, cost = dijkstra.Dijkstra(int_cons, int_start, int_end, True);
+    path, cost = dijkstra.Dijkstra(int_cons, int_start, int_end, True, coordinates);
     path_nodes = [intersections[i].node for i in path]
     
-    return path_nodes
\ No newline at end of file
+    return path_nodes
+
+def DistanceMatrix(paths, intersections, sources, targets):
+    """
+    Returns a list with a row for each of the source intersections, holding
+    the length of the shortest route from it to each of the target
+    intersections, or infinity where there is none.
+    """
+    intersection_indexes = {intersections[i]: i for i in range(len(intersections))}
+    int_cons = [(intersection_indexes[path.start_intersection], intersection_indexes[path.end_intersection], path.length)
+        for path in paths]
+    int_sources = [intersection_indexes[i] for i in sources]
+    int_targets = [intersection_indexes[i] for i in targets]
+    
+    return dijkstra.DistanceTable(int_cons, int_sources, int_targets, True)